@@ -255,8 +255,12 @@ public:
     LUT<T>& operator=(const LUT<T>& rhs)
     {
         if (this != &rhs) {
-            if (rhs.size > this->size) {
-                delete [] this->data;
+            // a shared buffer is neither freed nor written, this LUT gets its own one
+            if (!this->owner || rhs.size > this->size) {
+                if (this->owner) {
+                    delete [] this->data;
+                }
+
                 this->data = nullptr;
             }
 
@@ -524,7 +528,7 @@ public:
 
     void reset()
     {
-        if (data) {
+        if (data && owner) {
             delete[] data;
         }
 
@@ -652,5 +656,28 @@ public:
 #endif
     }
 
+    // use an external buffer of s + 3 elements (see constructor), which has to outlive the LUT
+    // and is not written through it, e.g. a read-only file mapping
+    void share(const T* source, unsigned int s, int flags = LUT_CLIP_BELOW | LUT_CLIP_ABOVE)
+    {
+        if (owner && data) {
+            delete[] data;
+        }
+
+        dirty = false;
+        clip = flags;
+        data = const_cast<T*>(source);
+        owner = 0;
+        size = s;
+        upperBound = size - 1;
+        maxs = size - 2;
+        maxsf = (float)maxs;
+#ifdef __SSE2__
+        maxsv =  F2V( size - 2);
+        sizeiv =  _mm_set1_epi32( (int)(size - 1) );
+        sizev = F2V( size - 1 );
+#endif
+    }
+
 
 };
@@ -22,6 +22,9 @@
 #include <cstdlib>
 #include <utility>
 
+#include "memoryaccounting.h"
+#include "planepool.h"
+
 inline size_t padToAlignment(size_t size, size_t align = 16) {
     return align * ((size + align - 1) / align);
 }
@@ -35,6 +38,7 @@ private:
     char alignment;
     size_t allocatedSize;
     int unitSize;
+    rtengine::MemoryTag memoryTag;
 
 public:
     T* data ;
@@ -53,9 +57,7 @@ public:
 
     ~AlignedBuffer ()
     {
-        if (real) {
-            free(real);
-        }
+        rtengine::PlanePool::release(real, allocatedSize + alignment);
     }
 
     /** @brief Return true if there's no memory allocated
@@ -75,15 +77,14 @@ public:
         if (allocatedSize != size) {
             if (!size) {
                 // The user want to free the memory
-                if (real) {
-                    free(real);
-                }
+                rtengine::PlanePool::release(real, allocatedSize + alignment);
 
                 real = nullptr;
                 data = nullptr;
                 inUse = false;
                 allocatedSize = 0;
                 unitSize = 0;
+                memoryTag.set(0);
             } else {
                 unitSize = structSize ? structSize : sizeof(T);
                 size_t oldAllocatedSize = allocatedSize;
@@ -92,8 +93,9 @@ public:
                 // realloc were used here to limit memory fragmentation, specially when the size was smaller than the previous one.
                 // But realloc copies the content to the eventually new location, which is unnecessary. To avoid this performance penalty,
                 // we're freeing the memory and allocate it again if the new size is bigger.
+                // Large blocks come from the PlanePool, which keeps the freed ones for the next plane.
 
-                if (allocatedSize < oldAllocatedSize) {
+                if (allocatedSize < oldAllocatedSize && oldAllocatedSize + alignment < rtengine::PlanePool::MIN_POOLED_SIZE) {
                     void *temp = realloc(real, allocatedSize + alignment);
                     if (temp) { // realloc succeeded
                         real = temp;
@@ -104,21 +106,20 @@ public:
                         real = malloc(allocatedSize + alignment);
                     }
                 } else {
-                    if (real) {
-                        free (real);
-                    }
-
-                    real = malloc(allocatedSize + alignment);
+                    rtengine::PlanePool::release(real, oldAllocatedSize + alignment);
+                    real = rtengine::PlanePool::acquire(allocatedSize + alignment);
                 }
 
                 if (real) {
                     data = (T*)( ( uintptr_t(real) + uintptr_t(alignment - 1)) / alignment * alignment);
                     inUse = true;
+                    memoryTag.set(allocatedSize + alignment);
                 } else {
                     allocatedSize = 0;
                     unitSize = 0;
                     data = nullptr;
                     inUse = false;
+                    memoryTag.set(0);
                     return false;
                 }
             }
@@ -134,6 +135,7 @@ public:
         std::swap(allocatedSize, other.allocatedSize);
         std::swap(data, other.data);
         std::swap(inUse, other.inUse);
+        memoryTag.swap(other.memoryTag);
     }
 
     unsigned int getSize() const
@@ -56,7 +56,9 @@
 #include <cstring>
 #include <sys/types.h>
 #include <vector>
+#include "memoryaccounting.h"
 #include "noncopyable.h"
+#include "planepool.h"
 
 // flags for use
 constexpr unsigned int ARRAY2D_CLEAR_DATA = 1;
@@ -70,11 +72,13 @@ class array2D
 private:
     ssize_t width;
     std::vector<T*> rows;
-    std::vector<T> buffer;
+    std::vector<T, rtengine::PlanePoolAllocator<T>> buffer;
+    rtengine::MemoryTag memoryTag;
 
     void initRows(ssize_t h, int offset = 0)
     {
         rows.resize(h);
+        memoryTag.set(buffer.capacity() * sizeof(T));
         T* start = buffer.data() + offset;
         for (ssize_t i = 0; i < h; ++i) {
             rows[i] = start + width * i;
@@ -117,6 +121,7 @@ public:
                     rows[i][j] = source[i][j];
                 }
             }
+            memoryTag.set(buffer.capacity() * sizeof(T));
         } else {
             for (ssize_t i = 0; i < h; ++i) {
                 rows[i] = source[i];
@@ -159,6 +164,7 @@ public:
         buffer.clear();
         rows.clear();
         width = 0;
+        memoryTag.set(buffer.capacity() * sizeof(T));
     }
 
     // use with indices
@@ -8,9 +8,11 @@
 #include <cstring>
 #include <cerrno>
 #include <cassert>
+#include <cctype>
 #include <memory>
 #include <vector>
 
+#include <glib/gstdio.h>
 #include <glibmm/fileutils.h>
 #include <glibmm/miscutils.h>
 #include <glibmm/ustring.h>
@@ -597,155 +599,425 @@ void CameraConst::update_globalGreenEquilibration(bool other)
     globalGreenEquilibration = (other ? 1 : 0);
 }
 
-bool CameraConstantsStore::parse_camera_constants_file(const Glib::ustring& filename_)
+namespace
 {
-    // read the file into a single long string
-    const char *filename = filename_.c_str();
-    FILE *stream = fopen(filename, "rt");
 
-    if (!stream) {
-        fprintf(stderr, "Could not open camera constants file \"%s\": %s\n", filename, strerror(errno));
-        return false;
+constexpr const char* INDEX_HEADER = "RTCAMCONSTINDEX 1";
+
+struct IndexEntry {
+    std::string make_model;
+    std::size_t offset;
+    std::size_t length;
+};
+
+// Finds the entries of "camera_constants" and their "make_model" without building the JSON tree.
+// Comments are skipped where cJSON_Minify() would remove them.
+class EntryScanner final
+{
+public:
+    explicit EntryScanner(const std::string& text) :
+        text(text),
+        pos(0)
+    {
     }
 
-    size_t bufsize = 262144;
-    size_t increment = bufsize;
-    size_t datasize = 0, ret;
-    char *buf = (char *)malloc(bufsize);
+    bool scan(std::vector<IndexEntry>& entries)
+    {
+        bool found = false;
 
-    while ((ret = fread(&buf[datasize], 1, bufsize - datasize - 1, stream)) != 0) {
-        datasize += ret;
+        if (!consume('{')) {
+            return false;
+        }
 
-        if (datasize == bufsize - 1) { // we need more memory
-            bufsize += increment;
-            void *temp = realloc(buf, bufsize); // try to realloc buffer with new size
-            if (!temp) { // realloc failed
-                temp = malloc(bufsize); // alloc now buffer
-                if (temp) { // alloc worked
-                    memcpy(temp, buf, bufsize - increment); // copy old buffer content to new buffer
-                    free(buf); // free old buffer
-                } else { // alloc didn't work, break
-                    break;
+        if (consume('}')) {
+            fprintf(stderr, "missing \"camera_constants\" object item\n");
+            return false;
+        }
+
+        do {
+            std::string key;
+
+            if (!readString(key) || !consume(':')) {
+                return false;
+            }
+
+            if (key == "camera_constants") {
+                if (!scanEntries(entries)) {
+                    return false;
                 }
+
+                found = true;
+            } else if (!skipValue()) {
+                return false;
             }
-            buf = (char *)temp; // assign new buffer
-            increment *= 2; // double increment
+        } while (consume(','));
+
+        if (!found) {
+            fprintf(stderr, "missing \"camera_constants\" object item\n");
         }
+
+        return consume('}') && found;
     }
 
-    if (!feof(stream)) {
-        fclose(stream);
-        free(buf);
-        fprintf(stderr, "Failed to read camera constants file \"%s\"\n", filename);
-        return false;
+private:
+    bool scanEntries(std::vector<IndexEntry>& entries)
+    {
+        if (!consume('[')) {
+            return false;
+        }
+
+        if (consume(']')) {
+            return true;
+        }
+
+        do {
+            skipSpace();
+
+            const std::size_t start = pos;
+            std::vector<std::string> names;
+
+            if (!consume('{')) {
+                return false;
+            }
+
+            if (!consume('}')) {
+                do {
+                    std::string key;
+
+                    if (!readString(key) || !consume(':')) {
+                        return false;
+                    }
+
+                    if (key == "make_model") {
+                        if (!readNames(names)) {
+                            fprintf(stderr, "\"make_model\" must be a string or an array of strings\n");
+                            return false;
+                        }
+                    } else if (!skipValue()) {
+                        return false;
+                    }
+                } while (consume(','));
+
+                if (!consume('}')) {
+                    return false;
+                }
+            }
+
+            if (names.empty()) {
+                fprintf(stderr, "missing \"make_model\" object item\n");
+                return false;
+            }
+
+            for (const auto& name : names) {
+                entries.push_back({name, start, pos - start});
+            }
+        } while (consume(','));
+
+        return consume(']');
     }
 
-    fclose(stream);
+    bool readNames(std::vector<std::string>& names)
+    {
+        skipSpace();
+
+        if (pos < text.size() && text[pos] == '"') {
+            names.emplace_back();
+            return readString(names.back());
+        }
+
+        if (!consume('[')) {
+            return false;
+        }
 
-    buf[datasize] = '\0';
+        if (consume(']')) {
+            return true;
+        }
+
+        do {
+            names.emplace_back();
+
+            if (!readString(names.back())) {
+                return false;
+            }
+        } while (consume(','));
 
-    // remove comments
-    cJSON_Minify(buf);
+        return consume(']');
+    }
 
-    // parse
-    cJSON* const jsroot = cJSON_Parse(buf);
+    void skipSpace()
+    {
+        while (pos < text.size()) {
+            if (std::isspace(static_cast<unsigned char>(text[pos]))) {
+                ++pos;
+            } else if (text.compare(pos, 2, "//") == 0) {
+                pos = std::min(text.find('\n', pos), text.size());
+            } else if (text.compare(pos, 2, "/*") == 0) {
+                const std::size_t end = text.find("*/", pos + 2);
+                pos = end == std::string::npos ? text.size() : end + 2;
+            } else {
+                break;
+            }
+        }
+    }
 
-    if (!jsroot) {
-        char str[128];
-        const char *ep = cJSON_GetErrorPtr() - 10;
+    bool consume(char c)
+    {
+        skipSpace();
 
-        if ((uintptr_t)ep < (uintptr_t)buf) {
-            ep = buf;
+        if (pos < text.size() && text[pos] == c) {
+            ++pos;
+            return true;
         }
 
-        strncpy(str, ep, sizeof(str));
-        str[sizeof(str) - 1] = '\0';
-        fprintf(stderr, "JSON parse error in file \"%s\" near '%s'\n", filename, str);
-        free(buf);
         return false;
     }
 
-    free(buf);
+    // Escaped characters are kept as is, make and model names do not contain any
+    bool readString(std::string& value)
+    {
+        if (!consume('"')) {
+            return false;
+        }
 
-    const cJSON *js = cJSON_GetObjectItem(jsroot, "camera_constants");
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size()) {
+                ++pos;
+            }
 
-    if (!js) {
-        fprintf(stderr, "missing \"camera_constants\" object item\n");
-        goto parse_error;
+            value += text[pos++];
+        }
+
+        return consume('"');
     }
 
-    for (js = js->child; js; js = js->next) {
-        const cJSON *ji = cJSON_GetObjectItem(js, "make_model");
+    bool skipValue()
+    {
+        skipSpace();
 
-        if (!ji) {
-            fprintf(stderr, "missing \"make_model\" object item\n");
-            goto parse_error;
+        if (pos >= text.size()) {
+            return false;
         }
 
-        bool is_array = false;
-
-        if (ji->type == cJSON_Array) {
-            ji = ji->child;
-            is_array = true;
+        if (text[pos] == '"') {
+            std::string value;
+            return readString(value);
         }
 
-        while (ji) {
-            if (ji->type != cJSON_String) {
-                fprintf(stderr, "\"make_model\" must be a string or an array of strings\n");
-                goto parse_error;
+        if (consume('{')) {
+            if (consume('}')) {
+                return true;
             }
 
-            CameraConst* const cc = CameraConst::parseEntry((const void *)js, ji->valuestring);
+            do {
+                std::string key;
 
-            if (!cc) {
-                goto parse_error;
-            }
+                if (!readString(key) || !consume(':') || !skipValue()) {
+                    return false;
+                }
+            } while (consume(','));
 
-            std::string make_model(ji->valuestring);
-            std::transform(make_model.begin(), make_model.end(), make_model.begin(), ::toupper);            
+            return consume('}');
+        }
 
-            const auto entry = mCameraConstants.emplace(make_model, cc);
+        if (consume('[')) {
+            if (consume(']')) {
+                return true;
+            }
 
-            if (entry.second) { // entry inserted into map
-                if (settings->verbose) {
-                    printf("Add camera constants for \"%s\"\n", make_model.c_str());
-                }
-            } else {
-                // The CameraConst already exist for this camera make/model -> we merge the values
-                CameraConst* const existingcc = entry.first->second;
-
-                // updating the dcraw matrix
-                existingcc->update_dcrawMatrix(cc->get_dcrawMatrix());
-                // deleting all the existing levels, replaced by the new ones
-                existingcc->update_Levels(cc);
-                existingcc->update_Crop(cc);
-                existingcc->update_pdafPattern(cc->get_pdafPattern());
-                existingcc->update_pdafOffset(cc->get_pdafOffset());
-                if (cc->has_globalGreenEquilibration()) {
-                    existingcc->update_globalGreenEquilibration(cc->get_globalGreenEquilibration());
+            do {
+                if (!skipValue()) {
+                    return false;
                 }
+            } while (consume(','));
 
-                if (settings->verbose) {
-                    printf("Merging camera constants for \"%s\"\n", make_model.c_str());
-                }
-            }
+            return consume(']');
+        }
 
-            if (is_array) {
-                ji = ji->next;
-            } else {
-                ji = nullptr;
-            }
+        // Number, true, false or null
+        const std::size_t start = pos;
+
+        while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) {
+            ++pos;
         }
+
+        return pos > start;
+    }
+
+    const std::string& text;
+    std::size_t pos;
+};
+
+std::string getIndexStamp(const Glib::ustring& filename, const GStatBuf& stat)
+{
+    return Glib::ustring::compose("%1\n%2\n%3 %4\n", INDEX_HEADER, filename, static_cast<gint64>(stat.st_mtime), static_cast<gint64>(stat.st_size));
+}
+
+bool loadIndex(const Glib::ustring& indexFilename, const std::string& stamp, std::vector<IndexEntry>& entries)
+{
+    std::string contents;
+
+    try {
+        contents = Glib::file_get_contents(indexFilename);
+    } catch (const Glib::Exception&) {
+        return false;
+    }
+
+    if (contents.compare(0, stamp.size(), stamp) != 0) {
+        return false;
+    }
+
+    std::size_t pos = stamp.size();
+
+    while (pos < contents.size()) {
+        const std::size_t end = contents.find('\n', pos);
+
+        if (end == std::string::npos) {
+            return false;
+        }
+
+        unsigned long long offset;
+        unsigned long long length;
+        int nameStart;
+
+        if (sscanf(contents.c_str() + pos, "%llu %llu %n", &offset, &length, &nameStart) != 2 || pos + nameStart > end) {
+            return false;
+        }
+
+        entries.push_back({contents.substr(pos + nameStart, end - pos - nameStart), static_cast<std::size_t>(offset), static_cast<std::size_t>(length)});
+        pos = end + 1;
     }
 
-    cJSON_Delete(jsroot);
     return true;
+}
+
+void saveIndex(const Glib::ustring& indexFilename, const std::string& stamp, const std::vector<IndexEntry>& entries)
+{
+    if (g_mkdir_with_parents(Glib::path_get_dirname(indexFilename).c_str(), 511) != 0) {
+        return;
+    }
+
+    std::string contents = stamp;
+
+    for (const auto& entry : entries) {
+        contents += std::to_string(entry.offset) + ' ' + std::to_string(entry.length) + ' ' + entry.make_model + '\n';
+    }
+
+    // Written to a temporary file and renamed, so concurrent starts never read a partial index
+    g_file_set_contents(indexFilename.c_str(), contents.data(), contents.size(), nullptr);
+}
+
+}
+
+void CameraConstantsStore::index_camera_constants_file(const Glib::ustring& filename, const Glib::ustring& indexFilename)
+{
+    GStatBuf stat;
+
+    if (g_stat(filename.c_str(), &stat) != 0) {
+        fprintf(stderr, "Could not open camera constants file \"%s\": %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+
+    const std::string stamp = getIndexStamp(filename, stat);
+    std::vector<IndexEntry> entries;
+
+    if (indexFilename.empty() || !loadIndex(indexFilename, stamp, entries)) {
+        entries.clear();
+
+        std::string text;
+
+        try {
+            text = Glib::file_get_contents(filename);
+        } catch (const Glib::Exception&) {
+            fprintf(stderr, "Failed to read camera constants file \"%s\"\n", filename.c_str());
+            return;
+        }
+
+        if (!EntryScanner(text).scan(entries)) {
+            fprintf(stderr, "failed to parse camera constants file \"%s\"\n", filename.c_str());
+            return;
+        }
+
+        if (!indexFilename.empty()) {
+            saveIndex(indexFilename, stamp, entries);
+        }
+    }
+
+    for (const auto& entry : entries) {
+        std::string make_model(entry.make_model);
+        std::transform(make_model.begin(), make_model.end(), make_model.begin(), ::toupper);
+        index[make_model].push_back({files.size(), entry.offset, entry.length, entry.make_model});
+    }
 
-parse_error:
-    fprintf(stderr, "failed to parse camera constants file \"%s\"\n", filename);
-    mCameraConstants.clear();
-    cJSON_Delete(jsroot);
-    return false;
+    files.push_back(filename);
+}
+
+CameraConst* CameraConstantsStore::parse_camera_constants(const std::vector<Location>& locations) const
+{
+    std::unique_ptr<CameraConst> result;
+
+    for (const auto& location : locations) {
+        const char* const filename = files[location.file].c_str();
+        std::vector<char> buf(location.length + 1, '\0');
+        FILE* const stream = g_fopen(filename, "rb");
+
+        if (!stream) {
+            fprintf(stderr, "Could not open camera constants file \"%s\": %s\n", filename, strerror(errno));
+            return nullptr;
+        }
+
+        const bool read = fseek(stream, location.offset, SEEK_SET) == 0 && fread(buf.data(), 1, location.length, stream) == location.length;
+        fclose(stream);
+
+        if (!read) {
+            fprintf(stderr, "Failed to read camera constants file \"%s\"\n", filename);
+            return nullptr;
+        }
+
+        // remove comments
+        cJSON_Minify(buf.data());
+
+        cJSON* const js = cJSON_Parse(buf.data());
+
+        if (!js) {
+            fprintf(stderr, "failed to parse camera constants of \"%s\" in file \"%s\"\n", location.make_model.c_str(), filename);
+            return nullptr;
+        }
+
+        std::unique_ptr<CameraConst> cc(CameraConst::parseEntry(js, location.make_model.c_str()));
+        cJSON_Delete(js);
+
+        if (!cc) {
+            fprintf(stderr, "failed to parse camera constants of \"%s\" in file \"%s\"\n", location.make_model.c_str(), filename);
+            return nullptr;
+        }
+
+        if (!result) {
+            result = std::move(cc);
+
+            if (settings->verbose) {
+                printf("Add camera constants for \"%s\"\n", location.make_model.c_str());
+            }
+        } else {
+            // The CameraConst already exist for this camera make/model -> we merge the values
+
+            // updating the dcraw matrix
+            result->update_dcrawMatrix(cc->get_dcrawMatrix());
+            // deleting all the existing levels, replaced by the new ones
+            result->update_Levels(cc.get());
+            result->update_Crop(cc.get());
+            result->update_pdafPattern(cc->get_pdafPattern());
+            result->update_pdafOffset(cc->get_pdafOffset());
+            if (cc->has_globalGreenEquilibration()) {
+                result->update_globalGreenEquilibration(cc->get_globalGreenEquilibration());
+            }
+
+            if (settings->verbose) {
+                printf("Merging camera constants for \"%s\"\n", location.make_model.c_str());
+            }
+        }
+    }
+
+    return result.release();
 }
 
 CameraConstantsStore::CameraConstantsStore()
@@ -760,14 +1032,16 @@ CameraConstantsStore::~CameraConstantsStore()
     }
 }
 
-void CameraConstantsStore::init(const Glib::ustring& baseDir, const Glib::ustring& userSettingsDir)
+void CameraConstantsStore::init(const Glib::ustring& baseDir, const Glib::ustring& userSettingsDir, const Glib::ustring& cacheDir)
 {
-    parse_camera_constants_file(Glib::build_filename(baseDir, "camconst.json"));
+    MyMutex::MyLock lock(mutex);
+
+    index_camera_constants_file(Glib::build_filename(baseDir, "camconst.json"), cacheDir.empty() ? Glib::ustring() : Glib::ustring(Glib::build_filename(cacheDir, "camconst.index")));
 
     const Glib::ustring userFile(Glib::build_filename(userSettingsDir, "camconst.json"));
 
     if (Glib::file_test(userFile, Glib::FILE_TEST_EXISTS)) {
-        parse_camera_constants_file(userFile);
+        index_camera_constants_file(userFile, cacheDir.empty() ? Glib::ustring() : Glib::ustring(Glib::build_filename(cacheDir, "camconst-user.index")));
     }
 }
 
@@ -783,13 +1057,25 @@ const CameraConst* CameraConstantsStore::get(const char make[], const char model
     key += " ";
     key += model;
     std::transform(key.begin(), key.end(), key.begin(), ::toupper);
+
+    MyMutex::MyLock lock(mutex);
+
     const auto it = mCameraConstants.find(key);
 
-    if (it == mCameraConstants.end()) {
+    if (it != mCameraConstants.end()) {
+        return it->second;
+    }
+
+    const auto locations = index.find(key);
+
+    if (locations == index.end()) {
         return nullptr;
     }
 
-    return it->second;
+    CameraConst* const cc = parse_camera_constants(locations->second);
+    mCameraConstants.emplace(key, cc);
+
+    return cc;
 }
 
 } // namespace rtengine
@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+#include "../rtgui/threadutils.h"
+
 namespace Glib
 {
 
@@ -62,17 +64,34 @@ public:
     void update_globalGreenEquilibration(bool other);
 };
 
+/**
+ * The camera constants files are only indexed at startup: the make and model, offset and length of
+ * each entry. The index of a file is cached in the cache directory and rebuilt when the modification
+ * time or the size of the file changes. The entries of a camera are parsed on the first get() for it.
+ */
 class CameraConstantsStore final
 {
 private:
-    std::map<std::string, CameraConst *> mCameraConstants;
+    struct Location {
+        std::size_t file; // in files
+        std::size_t offset;
+        std::size_t length;
+        std::string make_model; // as written in the file
+    };
+
+    std::vector<std::string> files;
+    std::map<std::string, std::vector<Location>> index; // upper case make and model -> entries, in the order they are merged
+    mutable std::map<std::string, CameraConst *> mCameraConstants; // parsed entries, nullptr when they could not be parsed
+    mutable MyMutex mutex;
 
     CameraConstantsStore();
-    bool parse_camera_constants_file(const Glib::ustring& filename);
+    void index_camera_constants_file(const Glib::ustring& filename, const Glib::ustring& indexFilename);
+    CameraConst *parse_camera_constants(const std::vector<Location>& locations) const;
 
 public:
     ~CameraConstantsStore();
-    void init(const Glib::ustring& baseDir, const Glib::ustring& userSettingsDir);
+    /** cacheDir keeps the indexes, when empty the files are indexed at every start. */
+    void init(const Glib::ustring& baseDir, const Glib::ustring& userSettingsDir, const Glib::ustring& cacheDir);
     static CameraConstantsStore *getInstance(void);
     const CameraConst *get(const char make[], const char model[]) const;
 };
@@ -60,7 +60,6 @@ it under the terms of the one of two licenses as you choose:
 #include <algorithm>
 #include <cstdint>
 #include <cstdlib>
-#include <exception>
 #include <iostream>
 
 #include "dcraw.h"
@@ -650,9 +649,6 @@ unsigned int sgetn(int n, unsigned char* s)
     return result;
 }
 
-// this should be divisible by 4
-constexpr std::uint64_t CRX_BUF_SIZE = 0x10000;
-
 #if !defined (_WIN32) || (defined (__GNUC__) && !defined (__INTRINSIC_SPECIAL__BitScanReverse))
 /* __INTRINSIC_SPECIAL__BitScanReverse found in MinGW32-W64 v7.30 headers, may be there is a better solution? */
 inline void _BitScanReverse(std::uint32_t* Index, unsigned long Mask)
@@ -686,17 +682,25 @@ struct LibRaw_abstract_datastream {
     {
         return fread(dst, es, count, ifp);
     }
+    // The file is held in memory, so the bitstreams can read it concurrently without seeking.
+    // Returns the data at offset and clamps size to the end of the file, or nullptr
+    const std::uint8_t* data(std::uint64_t offset, std::uint64_t& size) const
+    {
+        if (offset >= static_cast<std::uint64_t>(ifp->size)) {
+            return nullptr;
+        }
+
+        size = std::min<std::uint64_t>(size, ifp->size - offset);
+        return reinterpret_cast<const std::uint8_t*>(ifp->data) + offset;
+    }
 };
 
 struct CrxBitstream {
-    std::uint8_t mdatBuf[CRX_BUF_SIZE];
-    std::uint64_t mdatSize;
-    std::uint64_t curBufOffset;
+    const std::uint8_t* mdatBuf; // the whole subband data
     std::uint32_t curPos;
     std::uint32_t curBufSize;
     std::uint32_t bitData;
     std::int32_t bitsLeft;
-    LibRaw_abstract_datastream* input;
 };
 
 struct CrxBandParam {
@@ -824,33 +828,6 @@ const std::uint32_t J[32] = {
     0x7, 0x7, 0x8, 0x9, 0xA, 0xB, 0xC, 0xD, 0xE, 0xF
 };
 
-inline void crxFillBuffer(CrxBitstream* bitStrm)
-{
-    if (bitStrm->curPos >= bitStrm->curBufSize && bitStrm->mdatSize) {
-        bitStrm->curPos = 0;
-        bitStrm->curBufOffset += bitStrm->curBufSize;
-#ifdef _OPENMP
-        #pragma omp critical
-#endif
-        {
-#ifndef _OPENMP
-            bitStrm->input->lock();
-#endif
-            bitStrm->input->seek(bitStrm->curBufOffset, SEEK_SET);
-            bitStrm->curBufSize = bitStrm->input->read(bitStrm->mdatBuf, 1, std::min(bitStrm->mdatSize, CRX_BUF_SIZE));
-#ifndef _OPENMP
-            bitStrm->input->unlock();
-#endif
-
-            if (bitStrm->curBufSize < 1) {  // nothing read
-                throw std::exception();
-            }
-
-            bitStrm->mdatSize -= bitStrm->curBufSize;
-        }
-    }
-}
-
 inline int crxBitstreamGetZeros(CrxBitstream* bitStrm)
 {
 //  std::uint32_t bitData = bitStrm->bitData;
@@ -868,9 +845,8 @@ inline int crxBitstreamGetZeros(CrxBitstream* bitStrm)
 
         while (true) {
             while (bitStrm->curPos + 4 <= bitStrm->curBufSize) {
-                nextData = _byteswap_ulong(*reinterpret_cast<std::uint32_t*>(bitStrm->mdatBuf + bitStrm->curPos));
+                nextData = _byteswap_ulong(*reinterpret_cast<const std::uint32_t*>(bitStrm->mdatBuf + bitStrm->curPos));
                 bitStrm->curPos += 4;
-                crxFillBuffer(bitStrm);
 
                 if (nextData) {
                     _BitScanReverse(&nonZeroBit, static_cast<std::uint32_t>(nextData));
@@ -888,7 +864,6 @@ inline int crxBitstreamGetZeros(CrxBitstream* bitStrm)
             }
 
             nextData = bitStrm->mdatBuf[bitStrm->curPos++];
-            crxFillBuffer(bitStrm);
 
             if (nextData) {
                 break;
@@ -917,9 +892,8 @@ inline std::uint32_t crxBitstreamGetBits(CrxBitstream* bitStrm, int bits)
     if (bitsLeft < bits) {
         // get them from stream
         if (bitStrm->curPos + 4 <= bitStrm->curBufSize) {
-            nextWord = _byteswap_ulong(*reinterpret_cast<std::uint32_t*>(bitStrm->mdatBuf + bitStrm->curPos));
+            nextWord = _byteswap_ulong(*reinterpret_cast<const std::uint32_t*>(bitStrm->mdatBuf + bitStrm->curPos));
             bitStrm->curPos += 4;
-            crxFillBuffer(bitStrm);
             bitStrm->bitsLeft = 32 - (bits - bitsLeft);
             result = ((nextWord >> bitsLeft) | bitData) >> (32 - bits);
             bitStrm->bitData = nextWord << (bits - bitsLeft);
@@ -934,7 +908,6 @@ inline std::uint32_t crxBitstreamGetBits(CrxBitstream* bitStrm, int bits)
 
             bitsLeft += 8;
             nextByte = bitStrm->mdatBuf[bitStrm->curPos++];
-            crxFillBuffer(bitStrm);
             bitData |= nextByte << (32 - bitsLeft);
         } while (bitsLeft < bits);
     }
@@ -2425,15 +2398,11 @@ bool crxParamInit(
     (*param)->supportsPartial = supportsPartial;
     (*param)->bitStream.bitData = 0;
     (*param)->bitStream.bitsLeft = 0;
-    (*param)->bitStream.mdatSize = subbandDataSize;
     (*param)->bitStream.curPos = 0;
-    (*param)->bitStream.curBufSize = 0;
-    (*param)->bitStream.curBufOffset = subbandMdatOffset;
-    (*param)->bitStream.input = input;
+    (*param)->bitStream.mdatBuf = input->data(subbandMdatOffset, subbandDataSize);
+    (*param)->bitStream.curBufSize = subbandDataSize;
 
-    crxFillBuffer(&(*param)->bitStream);
-
-    return true;
+    return (*param)->bitStream.mdatBuf != nullptr;
 }
 
 bool crxSetupSubbandData(
@@ -2566,61 +2535,52 @@ bool crxSetupSubbandData(
 
 } // namespace
 
-bool DCraw::crxDecodePlane(void* p, std::uint32_t planeNumber)
+bool DCraw::crxDecodeTile(void* p, std::uint32_t tileNumber, std::uint32_t planeNumber)
 {
     CrxImage* const img = static_cast<CrxImage*>(p);
-    int imageRow = 0;
+    const int tRow = tileNumber / img->tileCols;
+    const int tCol = tileNumber % img->tileCols;
+    const CrxTile* const tile = img->tiles + tileNumber;
+    CrxPlaneComp* const planeComp = tile->comps + planeNumber;
+    const std::uint64_t tileMdatOffset = tile->dataOffset + planeComp->dataOffset;
 
-    for (int tRow = 0; tRow < img->tileRows; ++tRow) {
-        int imageCol = 0;
+    // all the tiles but the last ones of the rows and columns have the full tile size
+    const int imageRow = tRow * img->tiles[0].height;
+    const int imageCol = tCol * img->tiles[0].width;
 
-        for (int tCol = 0; tCol < img->tileCols; ++tCol) {
-            const CrxTile* const tile = img->tiles + tRow * img->tileRows + tCol;
-            CrxPlaneComp* const planeComp = tile->comps + planeNumber;
-            const std::uint64_t tileMdatOffset = tile->dataOffset + planeComp->dataOffset;
+    bool result = crxSetupSubbandData(img, planeComp, tile, tileMdatOffset);
 
-            // decode single tile
-            if (!crxSetupSubbandData(img, planeComp, tile, tileMdatOffset)) {
-                return false;
-            }
+    if (result && img->levels) {
+        result = crxIdwt53FilterInitialize(planeComp, img->levels - 1);
 
-            if (img->levels) {
-                if (!crxIdwt53FilterInitialize(planeComp, img->levels - 1)) {
-                    return false;
-                }
-
-                for (int i = 0; i < tile->height; ++i) {
-                    if (!crxIdwt53FilterDecode(planeComp, img->levels - 1) || !crxIdwt53FilterTransform(planeComp, img->levels - 1)) {
-                        return false;
-                    }
-
-                    const std::int32_t* const lineData = crxIdwt53FilterGetLine(planeComp, img->levels - 1);
-                    crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
-                }
-            } else {
-                // we have the only subband in this case
-                if (!planeComp->subBands->dataSize) {
-                    memset(planeComp->subBands->bandBuf, 0, planeComp->subBands->bandSize);
-                    return true;
-                }
+        for (int i = 0; result && i < tile->height; ++i) {
+            result = crxIdwt53FilterDecode(planeComp, img->levels - 1) && crxIdwt53FilterTransform(planeComp, img->levels - 1);
 
-                for (int i = 0; i < tile->height; ++i) {
-                    if (!crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf)) {
-                        return false;
-                    }
+            if (result) {
+                const std::int32_t* const lineData = crxIdwt53FilterGetLine(planeComp, img->levels - 1);
+                crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
+            }
+        }
+    } else if (result) {
+        // we have the only subband in this case
+        if (!planeComp->subBands->dataSize) {
+            memset(planeComp->subBands->bandBuf, 0, planeComp->subBands->bandSize);
+        } else {
+            for (int i = 0; result && i < tile->height; ++i) {
+                result = crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf);
 
+                if (result) {
                     const std::int32_t* const lineData = reinterpret_cast<std::int32_t*>(planeComp->subBands->bandBuf);
                     crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
                 }
             }
-
-            imageCol += tile->width;
         }
-
-        imageRow += img->tiles[tRow * img->tileRows].height;
     }
 
-    return true;
+    // the buffers of the tile are not needed anymore
+    crxFreeSubbandData(img, planeComp);
+
+    return result;
 }
 
 namespace
@@ -3068,31 +3028,24 @@ void crxFreeImageData(CrxImage* img)
 
 }   // namespace
 
-void DCraw::crxLoadDecodeLoop(void* img, int nPlanes)
+void DCraw::crxLoadDecodeLoop(void* p, int nPlanes)
 {
-#ifdef _OPENMP
-    bool results[4]; // nPlanes is always <= 4
-    #pragma omp parallel for
+    // Each plane of each tile has its own bitstreams, buffers and output pixels,
+    // so they are all decoded in parallel
+    const int nTiles = static_cast<CrxImage*>(p)->tileRows * static_cast<CrxImage*>(p)->tileCols;
+    bool ok = true;
 
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        results[plane] = crxDecodePlane(img, plane);
-    }
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+#endif
 
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        if (!results[plane]) {
-            derror();
-        }
+    for (int job = 0; job < nTiles * nPlanes; ++job) {
+        ok = crxDecodeTile(p, job / nPlanes, job % nPlanes) && ok;
     }
 
-#else
-
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        if (!crxDecodePlane(img, plane)) {
-            derror();
-        }
+    if (!ok) {
+        derror();
     }
-
-#endif
 }
 
 void DCraw::crxConvertPlaneLineDf(void* p, int imageRow)
@@ -3137,20 +3090,9 @@ void DCraw::crxLoadRaw()
 
     std::uint8_t* const hdrBuf = static_cast<std::uint8_t*>(malloc(hdr.mdatHdrSize));
 
-    // read image header
-#ifdef _OPENMP
-    #pragma omp critical
-#endif
-    {
-#ifndef _OPENMP
-        /*libraw_internal_data.internal_data.input->*/ input.lock();
-#endif
-        /*libraw_internal_data.internal_data.input->*/ input.seek(data_offset, SEEK_SET);
-        /*libraw_internal_data.internal_data.input->*/ input.read(hdrBuf, 1, hdr.mdatHdrSize);
-#ifndef _OPENMP
-        /*libraw_internal_data.internal_data.input->*/ input.unlock();
-#endif
-    }
+    // read image header, this is serial code reading this decoder's own file
+    /*libraw_internal_data.internal_data.input->*/ input.seek(data_offset, SEEK_SET);
+    /*libraw_internal_data.internal_data.input->*/ input.read(hdrBuf, 1, hdr.mdatHdrSize);
 
     // parse and setup the image data
     if (!crxSetupImageData(&hdr, &img, reinterpret_cast<std::int16_t*>(raw_image), hdr.MediaOffset /*data_offset*/, hdr.MediaSize /*RT_canon_CR3_data.data_size*/, hdrBuf)) {
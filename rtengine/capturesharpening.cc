@@ -26,6 +26,7 @@
 #include "procparams.h"
 #include "color.h"
 #include "rt_algo.h"
+#include "tracer.h"
 //#define BENCHMARK
 #include "StopWatch.h"
 #include "opthelper.h"
@@ -1000,6 +1001,7 @@ namespace rtengine
 {
 
 void RawImageSource::captureSharpening(const procparams::CaptureSharpeningParams &sharpeningParams, bool showMask, double &conrastThreshold, double &radius) {
+    TraceScope trace("RawImageSource::captureSharpening", W, H);
 
     if (!(ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1)) {
         return;
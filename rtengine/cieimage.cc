@@ -103,6 +103,8 @@ CieImage::CieImage (int w, int h) : fromImage(false), W(w), H(h)
             h_p[i] = data[c] + i * W;
         }
     }
+
+    memoryTag.set(static_cast<std::size_t>(W) * H * 6 * sizeof(float));
 }
 
 CieImage::~CieImage ()
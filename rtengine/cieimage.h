@@ -18,6 +18,7 @@
  */
 #pragma once
 
+#include "memoryaccounting.h"
 #include "noncopyable.h"
 
 namespace rtengine
@@ -28,6 +29,7 @@ class CieImage final :
 {
 private:
     bool fromImage;
+    MemoryTag memoryTag;
 
 public:
     int W, H;
@@ -16,6 +16,15 @@
 *  You should have received a copy of the GNU General Public License
 *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
 */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glibmm/miscutils.h>
 #include <glibmm/ustring.h>
 
 #include "rtengine.h"
@@ -102,7 +111,131 @@ LUTf Color::_10GY30, Color::_10GY40, Color::_10GY50, Color::_10GY60, Color::_10G
 LUTf Color::_75GY30, Color::_75GY40, Color::_75GY50, Color::_75GY60, Color::_75GY70, Color::_75GY80;
 LUTf Color::_5GY30, Color::_5GY40, Color::_5GY50, Color::_5GY60, Color::_5GY70, Color::_5GY80;
 
-void Color::init ()
+namespace
+{
+
+// Bump when the computation of the tables changes, so the files of older versions are recomputed
+constexpr std::uint32_t COLOR_TABLES_VERSION = 1;
+constexpr std::size_t COLOR_TABLES_ALIGNMENT = 64;
+
+struct ColorTablesHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::int32_t denoiseLabGamma;
+    std::uint64_t size;
+};
+
+std::vector<LUTf*> getFloatTables()
+{
+    return {
+        &Color::cachef,
+        &Color::cachefy,
+        &Color::gammatab,
+        &Color::igammatab_srgb,
+        &Color::igammatab_srgb1,
+        &Color::gammatab_srgb,
+        &Color::gammatab_srgb1,
+        &Color::gammatab_srgb327,
+        &Color::gammatab_bt709,
+        &Color::igammatab_bt709,
+        &Color::denoiseGammaTab,
+        &Color::denoiseIGammaTab,
+        &Color::igammatab_24_17,
+        &Color::gammatab_24_17a,
+        &Color::gammatab_13_2,
+        &Color::igammatab_13_2,
+        &Color::gammatab_115_2,
+        &Color::igammatab_115_2,
+        &Color::gammatab_145_3,
+        &Color::igammatab_145_3
+    };
+}
+
+// A LUT holds 3 more elements than its size, see LUT::LUT()
+template<typename T>
+std::size_t getTableBytes(const LUT<T>& table)
+{
+    const std::size_t bytes = (table.getSize() + 3) * sizeof(T);
+    return (bytes + COLOR_TABLES_ALIGNMENT - 1) / COLOR_TABLES_ALIGNMENT * COLOR_TABLES_ALIGNMENT;
+}
+
+ColorTablesHeader getTablesHeader()
+{
+    // The header is padded to COLOR_TABLES_ALIGNMENT, followed by the float tables and gammatabThumb
+    ColorTablesHeader header = {{'R', 'T', 'C', 'O', 'L', 'O', 'R', '\0'}, COLOR_TABLES_VERSION, settings->denoiselabgamma, COLOR_TABLES_ALIGNMENT};
+
+    for (const auto table : getFloatTables()) {
+        header.size += getTableBytes(*table);
+    }
+
+    header.size += getTableBytes(Color::gammatabThumb);
+
+    return header;
+}
+
+// The tables only need to be allocated. The mapping is private and read-only, so its pages are shared
+// by all processes using the same file, and it is kept for the lifetime of the process.
+bool mapTables(const Glib::ustring& fileName)
+{
+    if (fileName.empty()) {
+        return false;
+    }
+
+    GMappedFile* const file = g_mapped_file_new(fileName.c_str(), FALSE, nullptr);
+
+    if (!file) {
+        return false;
+    }
+
+    const ColorTablesHeader header = getTablesHeader();
+    const char* const contents = g_mapped_file_get_contents(file);
+
+    if (g_mapped_file_get_length(file) != header.size || std::memcmp(contents, &header, sizeof(header))) {
+        g_mapped_file_unref(file);
+        return false;
+    }
+
+    std::size_t offset = COLOR_TABLES_ALIGNMENT;
+
+    for (const auto table : getFloatTables()) {
+        const std::size_t bytes = getTableBytes(*table);
+        table->share(reinterpret_cast<const float*>(contents + offset), table->getSize(), table->getClip());
+        offset += bytes;
+    }
+
+    Color::gammatabThumb.share(reinterpret_cast<const std::uint8_t*>(contents + offset), Color::gammatabThumb.getSize(), Color::gammatabThumb.getClip());
+
+    return true;
+}
+
+void saveTables(const Glib::ustring& fileName)
+{
+    if (fileName.empty() || g_mkdir_with_parents(Glib::path_get_dirname(fileName).c_str(), 511) != 0) {
+        return;
+    }
+
+    const ColorTablesHeader header = getTablesHeader();
+    std::string contents(header.size, '\0');
+    std::memcpy(&contents[0], &header, sizeof(header));
+
+    std::size_t offset = COLOR_TABLES_ALIGNMENT;
+
+    for (const auto table : getFloatTables()) {
+        std::memcpy(&contents[offset], &(*table)[0], table->getSize() * sizeof(float));
+        offset += getTableBytes(*table);
+    }
+
+    std::memcpy(&contents[offset], &Color::gammatabThumb[0], Color::gammatabThumb.getSize());
+
+    // Written to a temporary file and renamed, so other processes never map a partial file
+    if (!g_file_set_contents(fileName.c_str(), contents.data(), contents.size(), nullptr) && settings->verbose) {
+        printf("Color tables could not be saved to %s\n", fileName.c_str());
+    }
+}
+
+}
+
+void Color::init (const Glib::ustring& tableFile)
 {
 
     /*******************************************/
@@ -134,245 +267,242 @@ void Color::init ()
     gammatab_145_3(maxindex, 0);
     igammatab_145_3(maxindex, 0);
 
+    if (!mapTables(tableFile)) {
 #ifdef _OPENMP
-    #pragma omp parallel sections
+        #pragma omp parallel sections
 #endif
-    {
+        {
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        {
-            int i = 0;
-            int epsmaxint = eps_max;
-
-            for (; i <= epsmaxint; i++)
             {
-                cachef[i] = 327.68 * ((kappa * i / MAXVALF + 16.0) / 116.0);
-            }
+                int i = 0;
+                int epsmaxint = eps_max;
 
-            for(; i < maxindex; i++)
-            {
-                cachef[i] = 327.68 * std::cbrt((double)i / MAXVALF);
+                for (; i <= epsmaxint; i++)
+                {
+                    cachef[i] = 327.68 * ((kappa * i / MAXVALF + 16.0) / 116.0);
+                }
+
+                for(; i < maxindex; i++)
+                {
+                    cachef[i] = 327.68 * std::cbrt((double)i / MAXVALF);
+                }
             }
-        }
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        {
-            int i = 0;
-            int epsmaxint = eps_max;
-
-            for (; i <= epsmaxint; i++)
             {
-                cachefy[i] = 327.68 * (kappa * i / MAXVALF);
-            }
+                int i = 0;
+                int epsmaxint = eps_max;
 
-            for(; i < maxindex; i++)
-            {
-                cachefy[i] = 327.68 * (116.0 * std::cbrt((double)i / MAXVALF) - 16.0);
+                for (; i <= epsmaxint; i++)
+                {
+                    cachefy[i] = 327.68 * (kappa * i / MAXVALF);
+                }
+
+                for(; i < maxindex; i++)
+                {
+                    cachefy[i] = 327.68 * (116.0 * std::cbrt((double)i / MAXVALF) - 16.0);
+                }
             }
-        }
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        {
-            for (int i = 0; i < maxindex; i++)
             {
-                gammatab_srgb[i] = gammatab_srgb1[i] = gamma2(i / 65535.0);
+                for (int i = 0; i < maxindex; i++)
+                {
+                    gammatab_srgb[i] = gammatab_srgb1[i] = gamma2(i / 65535.0);
+                }
+                gammatab_srgb *= 65535.f;
             }
-            gammatab_srgb *= 65535.f;
-            gamma2curve.share(gammatab_srgb, LUT_CLIP_BELOW | LUT_CLIP_ABOVE); // shares the buffer with gammatab_srgb but has different clip flags
-        }
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        {
-            for (int i = 0; i < 32768; i++)
             {
-                gammatab_srgb327[i] = gamma2(i / 32767.0);
-            }
+                for (int i = 0; i < 32768; i++)
+                {
+                    gammatab_srgb327[i] = gamma2(i / 32767.0);
+                }
 
-            gammatab_srgb327 *= 32767.f;
-            //  gamma2curve.share(gammatab_srgb, LUT_CLIP_BELOW | LUT_CLIP_ABOVE); // shares the buffer with gammatab_srgb but has different clip flags
-        }
+                gammatab_srgb327 *= 32767.f;
+                //  gamma2curve.share(gammatab_srgb, LUT_CLIP_BELOW | LUT_CLIP_ABOVE); // shares the buffer with gammatab_srgb but has different clip flags
+            }
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        {
-            for (int i = 0; i < maxindex; i++)
             {
-                igammatab_srgb[i] = igammatab_srgb1[i] = igamma2 (i / 65535.0);
-            }
+                for (int i = 0; i < maxindex; i++)
+                {
+                    igammatab_srgb[i] = igammatab_srgb1[i] = igamma2 (i / 65535.0);
+                }
 
-            igammatab_srgb *= 65535.f;
-        }
+                igammatab_srgb *= 65535.f;
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        {
-            double rsRGBGamma = 1.0 / sRGBGamma;
-
-            for (int i = 0; i < maxindex; i++)
             {
-                double val = pow (i / 65535.0, rsRGBGamma);
-                gammatab[i] = 65535.0 * val;
-                gammatabThumb[i] = (unsigned char)(255.0 * val);
+                double rsRGBGamma = 1.0 / sRGBGamma;
+
+                for (int i = 0; i < maxindex; i++)
+                {
+                    double val = pow (i / 65535.0, rsRGBGamma);
+                    gammatab[i] = 65535.0 * val;
+                    gammatabThumb[i] = (unsigned char)(255.0 * val);
+                }
             }
-        }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        // modify arbitrary data for Lab..I have test : nothing, gamma 2.6 11 - gamma 4 5 - gamma 5.5 10
-        // we can put other as gamma g=2.6 slope=11, etc.
-        // but noting to do with real gamma !!!: it's only for data Lab # data RGB
-        // finally I opted for gamma55 and with options we can change
-
-        switch(settings->denoiselabgamma) {
-            case 0:
-                for (int i = 0; i < maxindex; i++) {
-                    denoiseGammaTab[i] = 65535.0 * gamma26_11 (i / 65535.0);
-                }
+            // modify arbitrary data for Lab..I have test : nothing, gamma 2.6 11 - gamma 4 5 - gamma 5.5 10
+            // we can put other as gamma g=2.6 slope=11, etc.
+            // but noting to do with real gamma !!!: it's only for data Lab # data RGB
+            // finally I opted for gamma55 and with options we can change
+
+            switch(settings->denoiselabgamma) {
+                case 0:
+                    for (int i = 0; i < maxindex; i++) {
+                        denoiseGammaTab[i] = 65535.0 * gamma26_11 (i / 65535.0);
+                    }
 
-                break;
+                    break;
 
-            case 1:
-                for (int i = 0; i < maxindex; i++) {
-                    denoiseGammaTab[i] = 65535.0 * gamma4 (i / 65535.0);
-                }
+                case 1:
+                    for (int i = 0; i < maxindex; i++) {
+                        denoiseGammaTab[i] = 65535.0 * gamma4 (i / 65535.0);
+                    }
 
-                break;
+                    break;
 
-            default:
-                for (int i = 0; i < maxindex; i++) {
-                    denoiseGammaTab[i] = 65535.0 * gamma55 (i / 65535.0);
-                }
+                default:
+                    for (int i = 0; i < maxindex; i++) {
+                        denoiseGammaTab[i] = 65535.0 * gamma55 (i / 65535.0);
+                    }
 
-                break;
-        }
+                    break;
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
-        // modify arbitrary data for Lab..I have test : nothing, gamma 2.6 11 - gamma 4 5 - gamma 5.5 10
-        // we can put other as gamma g=2.6 slope=11, etc.
-        // but noting to do with real gamma !!!: it's only for data Lab # data RGB
-        // finally I opted for gamma55 and with options we can change
-
-        switch(settings->denoiselabgamma) {
-            case 0:
-                for (int i = 0; i < maxindex; i++) {
-                    denoiseIGammaTab[i] = 65535.0 * igamma26_11 (i / 65535.0);
-                }
+            // modify arbitrary data for Lab..I have test : nothing, gamma 2.6 11 - gamma 4 5 - gamma 5.5 10
+            // we can put other as gamma g=2.6 slope=11, etc.
+            // but noting to do with real gamma !!!: it's only for data Lab # data RGB
+            // finally I opted for gamma55 and with options we can change
+
+            switch(settings->denoiselabgamma) {
+                case 0:
+                    for (int i = 0; i < maxindex; i++) {
+                        denoiseIGammaTab[i] = 65535.0 * igamma26_11 (i / 65535.0);
+                    }
 
-                break;
+                    break;
 
-            case 1:
-                for (int i = 0; i < maxindex; i++) {
-                    denoiseIGammaTab[i] = 65535.0 * igamma4 (i / 65535.0);
-                }
+                case 1:
+                    for (int i = 0; i < maxindex; i++) {
+                        denoiseIGammaTab[i] = 65535.0 * igamma4 (i / 65535.0);
+                    }
 
-                break;
+                    break;
 
-            default:
-                for (int i = 0; i < maxindex; i++) {
-                    denoiseIGammaTab[i] = 65535.0 * igamma55 (i / 65535.0);
-                }
+                default:
+                    for (int i = 0; i < maxindex; i++) {
+                        denoiseIGammaTab[i] = 65535.0 * igamma55 (i / 65535.0);
+                    }
 
-                break;
-        }
+                    break;
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            gammatab_bt709[i] = 65535.0 * gamma709(i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                gammatab_bt709[i] = 65535.0 * gamma709(i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            igammatab_bt709[i] = 65535.0 * igamma709(i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                igammatab_bt709[i] = 65535.0 * igamma709(i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            gammatab_13_2[i] = 65535.0 * gamma13_2 (i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                gammatab_13_2[i] = 65535.0 * gamma13_2 (i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            igammatab_13_2[i] = 65535.0 * igamma13_2 (i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                igammatab_13_2[i] = 65535.0 * igamma13_2 (i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            gammatab_115_2[i] = 65535.0 * gamma115_2 (i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                gammatab_115_2[i] = 65535.0 * gamma115_2 (i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            igammatab_115_2[i] = 65535.0 * igamma115_2 (i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                igammatab_115_2[i] = 65535.0 * igamma115_2 (i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            gammatab_145_3[i] = 65535.0 * gamma145_3 (i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                gammatab_145_3[i] = 65535.0 * gamma145_3 (i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            igammatab_145_3[i] = 65535.0 * igamma145_3 (i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                igammatab_145_3[i] = 65535.0 * igamma145_3 (i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            gammatab_24_17a[i] = gamma24_17(i / 65535.0);
-        }
+            for (int i = 0; i < maxindex; i++) {
+                gammatab_24_17a[i] = gamma24_17(i / 65535.0);
+            }
 
 #ifdef _OPENMP
-        #pragma omp section
+            #pragma omp section
 #endif
 
-        for (int i = 0; i < maxindex; i++) {
-            igammatab_24_17[i] = 65535.0 * igamma24_17 (i / 65535.0);
+            for (int i = 0; i < maxindex; i++) {
+                igammatab_24_17[i] = 65535.0 * igamma24_17 (i / 65535.0);
+            }
         }
 
-#ifdef _OPENMP
-        #pragma omp section
-#endif
-        initMunsell();
-
-#ifdef _OPENMP
-        #pragma omp section
-#endif
-        linearGammaTRC = cmsBuildGamma(nullptr, 1.0);
+        saveTables(tableFile);
     }
+
+    gamma2curve.share(gammatab_srgb, LUT_CLIP_BELOW | LUT_CLIP_ABOVE); // shares the buffer with gammatab_srgb but has different clip flags
+    initMunsell();
+    linearGammaTRC = cmsBuildGamma(nullptr, 1.0);
 }
 
 void Color::cleanup ()
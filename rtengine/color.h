@@ -167,7 +167,8 @@ public:
     static LUTuc gammatabThumb; // for thumbnails
 
 
-    static void init ();
+    /** Computes the tables, or maps them read-only from tableFile when it has been written by a previous run. */
+    static void init (const Glib::ustring& tableFile);
     static void cleanup ();
 
     static inline float computeXYZ2LabY(float f)
@@ -0,0 +1,33 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// Hot kernels may have AVX2 variants. They are compiled for that instruction set with the target
+// attribute, whatever the PROC_TARGET is, and only called when cpuHasAVX2() is true, so the same
+// binary still runs on cpus without AVX2.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__SSE2__)
+    #define RT_AVX2_DISPATCH
+    #define TARGET_AVX2 __attribute__ ((target ("avx2,fma")))
+#endif
+
+namespace rtengine
+{
+
+/** Returns true if the cpu (and the OS) support AVX2 and FMA. The result is computed once. */
+bool cpuHasAVX2();
+
+}
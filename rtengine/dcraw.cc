@@ -26,6 +26,7 @@
 /*RT*/#include <omp.h>
 /*RT*/#endif
 
+#include <array>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -268,6 +269,10 @@ void CLASS merror (void *ptr, const char *where)
 
 void CLASS derror()
 {
+/*RT*/#ifdef _OPENMP
+/*RT*/#pragma omp critical(derror)
+/*RT*/#endif
+  {
   if (!data_error) {
     fprintf (stderr, "%s: ", ifname);
     if (feof(ifp))
@@ -276,6 +281,7 @@ void CLASS derror()
       fprintf (stderr,_("Corrupt data near 0x%llx\n"), (INT64) ftello(ifp));
   }
   data_error++;
+  }
 /*RT Issue 2467  longjmp (failure, 1);*/
 }
 
@@ -833,6 +839,14 @@ struct jhead {
 };
 
 int CLASS ljpeg_start (struct jhead *jh, int info_only)
+{
+  if (!ljpeg_start (jh, info_only, ifp)) return 0;
+  if (!info_only) zero_after_ff = 1;
+  return 1;
+}
+
+/*RT: reads from the given file, so that the tiles can be decoded in parallel */
+int CLASS ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp)
 {
   ushort c, tag, len;
   uchar data[0x10000];
@@ -886,7 +900,7 @@ int CLASS ljpeg_start (struct jhead *jh, int info_only)
   }
   jh->row = (ushort *) calloc (2 * jh->wide*jh->clrs, 4);
   merror (jh->row, "ljpeg_start()");
-  return zero_after_ff = 1;
+  return 1;
 }
 
 void CLASS ljpeg_end (struct jhead *jh)
@@ -897,6 +911,11 @@ void CLASS ljpeg_end (struct jhead *jh)
 }
 
 inline int CLASS ljpeg_diff (ushort *huff)
+{
+  return ljpeg_diff (huff, getbithuff);
+}
+
+inline int CLASS ljpeg_diff (ushort *huff, getbithuff_t &getbithuff)
 {
   int len, diff;
 
@@ -910,6 +929,11 @@ inline int CLASS ljpeg_diff (ushort *huff)
 }
 
 ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
+{
+  return ljpeg_row (jrow, jh, ifp, getbithuff);
+}
+
+ushort * CLASS ljpeg_row (int jrow, struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff)
 {
   int col, c, diff, pred, spred=0;
   ushort mark=0, *row[3];
@@ -926,7 +950,7 @@ ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
   FORC3 row[c] = (jh->row + ((jrow & 1) + 1) * (jh->wide*jh->clrs*((jrow+c) & 1)));
   for (col=0; col < jh->wide; col++)
     FORC(jh->clrs) {
-      diff = ljpeg_diff (jh->huff[c]);
+      diff = ljpeg_diff (jh->huff[c], getbithuff);
       if (jh->sraw && c <= jh->sraw && (col | c))
 		    pred = spred;
       else if (col) pred = row[0][-jh->clrs];
@@ -1091,20 +1115,30 @@ void CLASS adobe_copy_pixel (unsigned row, unsigned col, ushort **rp)
 }
 
 void CLASS ljpeg_idct (struct jhead *jh)
+{
+  ljpeg_idct (jh, getbithuff);
+}
+
+void CLASS ljpeg_idct (struct jhead *jh, getbithuff_t &getbithuff)
 {
   int c, i, j, len, skip, coef;
   float work[3][8][8];
-  static float cs[106] = { 0 };
+/*RT  static float cs[106] = { 0 }; */
+  static const std::array<float, 106> cs = [] {
+    std::array<float, 106> cs;
+    for (int c=0; c < 106; c++) cs[c] = cos((c & 31)*rtengine::RT_PI/16)/2;
+    return cs;
+  }();
   static const uchar zigzag[80] =
   {  0, 1, 8,16, 9, 2, 3,10,17,24,32,25,18,11, 4, 5,12,19,26,33,
     40,48,41,34,27,20,13, 6, 7,14,21,28,35,42,49,56,57,50,43,36,
     29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,
     47,55,62,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63 };
 
-  if (!cs[0])
-    FORC(106) cs[c] = cos((c & 31)*rtengine::RT_PI/16)/2;
+/*RT  if (!cs[0])
+    FORC(106) cs[c] = cos((c & 31)*rtengine::RT_PI/16)/2; */
   memset (work, 0, sizeof work);
-  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0]) * jh->quant[0];
+  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0], getbithuff) * jh->quant[0];
   for (i=1; i < 64; i++ ) {
     len = gethuff (jh->huff[16]);
     i += skip = len >> 4;
@@ -1146,10 +1180,8 @@ void CLASS lossless_dnglj92_load_raw()
         dataOffset[0] = ifp->pos;
     }
     const int data_length = ifp->size;
-    const std::unique_ptr<uint8_t[]> data(new uint8_t[data_length]);
-    fseek(ifp, 0, SEEK_SET);
-    // read whole file
-    fread(data.get(), 1, data_length, ifp);
+    // the whole file is already in memory
+    uint8_t* const data = fdata(0, ifp);
     lj92 lj;
     int newwidth, newheight, newbps;
     lj92_open(&lj, &data[dataOffset[0]], data_length, &newwidth, &newheight, &newbps);
@@ -1181,45 +1213,77 @@ void CLASS lossless_dnglj92_load_raw()
     }
 }
 
+void CLASS lossless_dng_decode_tile (struct jhead *jh, unsigned trow, unsigned tcol, IMFILE *ifp, getbithuff_t &getbithuff)
+{
+  unsigned jwide, jrow, jcol, row, col, i, j;
+  ushort *rp;
+
+  jwide = jh->wide;
+  if (filters || (colors == 1 && jh->clrs > 1)) jwide *= jh->clrs;
+  jwide /= MIN (is_raw, tiff_samples);
+  switch (jh->algo) {
+    case 0xc1:
+      jh->vpred[0] = 16384;
+      getbits(-1);
+      for (jrow=0; jrow+7 < jh->high; jrow += 8) {
+	for (jcol=0; jcol+7 < jh->wide; jcol += 8) {
+	  ljpeg_idct (jh, getbithuff);
+	  rp = jh->idct;
+	  row = trow + jcol/tile_width + jrow*2;
+	  col = tcol + jcol%tile_width;
+	  for (i=0; i < 16; i+=2)
+	    for (j=0; j < 8; j++)
+	      adobe_copy_pixel (row+i, col+j, &rp);
+	}
+      }
+      break;
+    case 0xc3:
+      for (row=col=jrow=0; jrow < jh->high; jrow++) {
+	rp = ljpeg_row (jrow, jh, ifp, getbithuff);
+	for (jcol=0; jcol < jwide; jcol++) {
+	  adobe_copy_pixel (trow+row, tcol+col, &rp);
+	  if (++col >= tile_width || col >= raw_width)
+	    row += 1 + (col = 0);
+	}
+      }
+  }
+}
+
 void CLASS lossless_dng_load_raw()
 {
-  unsigned save, trow=0, tcol=0, jwide, jrow, jcol, row, col, i, j;
+  unsigned save, trow=0, tcol=0;
   struct jhead jh;
-  ushort *rp;
+
+/*RT*/ if (tile_length < INT_MAX) {
+    // The lossless JPEG tiles are independent: each one is decoded from its own view of the
+    // file, which is held in memory, with its own bit reader
+    const unsigned tileCols = (raw_width + tile_width - 1) / tile_width;
+    const unsigned tileCount = tileCols * ((raw_height + tile_length - 1) / tile_length);
+    std::vector<unsigned> offsets (tileCount);
+    for (unsigned t=0; t < tileCount; t++)
+      offsets[t] = get4();
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (unsigned t=0; t < tileCount; t++) {
+      IMFILE tileFile = *ifp;
+      tileFile.plistener = nullptr; // the progress updates are not thread safe
+      IMFILE *tileIfp = &tileFile;
+      unsigned tileZeroAfterFF = 1;
+      getbithuff_t tileBits (this, tileIfp, tileZeroAfterFF);
+      struct jhead tileJh;
+      fseek (tileIfp, offsets[t], SEEK_SET);
+      if (!ljpeg_start (&tileJh, 0, tileIfp)) continue;
+      lossless_dng_decode_tile (&tileJh, t / tileCols * tile_length, t % tileCols * tile_width, tileIfp, tileBits);
+      ljpeg_end (&tileJh);
+    }
+    return;
+  }
 
   while (trow < raw_height) {
     save = ftell(ifp);
-    if (tile_length < INT_MAX)
-      fseek (ifp, get4(), SEEK_SET);
     if (!ljpeg_start (&jh, 0)) break;
-    jwide = jh.wide;
-    if (filters || (colors == 1 && jh.clrs > 1)) jwide *= jh.clrs;
-    jwide /= MIN (is_raw, tiff_samples);
-    switch (jh.algo) {
-      case 0xc1:
-	jh.vpred[0] = 16384;
-	getbits(-1);
-	for (jrow=0; jrow+7 < jh.high; jrow += 8) {
-	  for (jcol=0; jcol+7 < jh.wide; jcol += 8) {
-	    ljpeg_idct (&jh);
-	    rp = jh.idct;
-	    row = trow + jcol/tile_width + jrow*2;
-	    col = tcol + jcol%tile_width;
-	    for (i=0; i < 16; i+=2)
-	      for (j=0; j < 8; j++)
-		adobe_copy_pixel (row+i, col+j, &rp);
-	  }
-	}
-	break;
-      case 0xc3:
-	for (row=col=jrow=0; jrow < jh.high; jrow++) {
-	  rp = ljpeg_row (jrow, &jh);
-	  for (jcol=0; jcol < jwide; jcol++) {
-	    adobe_copy_pixel (trow+row, tcol+col, &rp);
-	    if (++col >= tile_width || col >= raw_width)
-	      row += 1 + (col = 0);
-	  }
-	}    }
+    lossless_dng_decode_tile (&jh, trow, tcol, ifp, getbithuff);
     fseek (ifp, save+4, SEEK_SET);
     if ((tcol += tile_width) >= raw_width)
       trow += tile_length + (tcol = 0);
@@ -10907,6 +10971,8 @@ void CLASS deflate_dng_load_raw() {
 {
     Bytef * cBuffer = new Bytef[maxCompressed];
     Bytef * uBuffer = new Bytef[dstLen];
+    IMFILE ifpthr = *ifp; // own cursor, the threads must not share the position of ifp
+    ifpthr.plistener = nullptr; // the progress updates are not thread safe
 
 #ifdef _OPENMP
     #pragma omp for collapse(2) schedule(dynamic) nowait
@@ -10914,13 +10980,8 @@ void CLASS deflate_dng_load_raw() {
     for (size_t y = 0; y < raw_height; y += tile_length) {
         for (size_t x = 0; x < raw_width; x += tile_width) {
             size_t t = (y / tile_length) * tilesWide + (x / tile_width);
-#ifdef _OPENMP
-            #pragma omp critical
-#endif
-            {
-                fseek(ifp, tileOffsets[t], SEEK_SET);
-                fread(cBuffer, 1, tileBytes[t], ifp);
-            }
+            fseek(&ifpthr, tileOffsets[t], SEEK_SET);
+            fread(cBuffer, 1, tileBytes[t], &ifpthr);
             int err = decompress(tileBytes[t], dstLen, cBuffer, uBuffer);
             if (err != Z_OK) {
                 fprintf(stderr, "DNG Deflate: Failed uncompressing tile %d, with error %d\n", (int)t, err);
@@ -125,7 +125,7 @@ protected:
         int         cur_buf_size;    // buffer size
         uchar       *cur_buf;        // currently read block
         int         fillbytes;          // Counter to add extra byte for block size N*16
-        IMFILE      *input;
+        IMFILE      input;           // own cursor over ifp
         struct int_pair grad_even[3][41];    // tables of gradients
         struct int_pair grad_odd[3][41];
         ushort		*linealloc;
@@ -319,15 +319,20 @@ void crw_init_tables (unsigned table, ushort *huff[2]);
 int canon_has_lowbits();
 void canon_load_raw();
 int ljpeg_start (struct jhead *jh, int info_only);
+int ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp);
 void ljpeg_end (struct jhead *jh);
 int ljpeg_diff (ushort *huff);
+int ljpeg_diff (ushort *huff, getbithuff_t &getbithuff);
 ushort * ljpeg_row (int jrow, struct jhead *jh);
+ushort * ljpeg_row (int jrow, struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff);
 void lossless_jpeg_load_raw();
 void ljpeg_idct (struct jhead *jh);
+void ljpeg_idct (struct jhead *jh, getbithuff_t &getbithuff);
 
 
 void canon_sraw_load_raw();
 void adobe_copy_pixel (unsigned row, unsigned col, ushort **rp);
+void lossless_dng_decode_tile (struct jhead *jh, unsigned trow, unsigned tcol, IMFILE *ifp, getbithuff_t &getbithuff);
 void lossless_dng_load_raw();
 void lossless_dnglj92_load_raw();
 void packed_dng_load_raw();
@@ -341,7 +346,7 @@ void fuji_zerobits(struct fuji_compressed_block* info, int *count);
 void fuji_read_code(struct fuji_compressed_block* info, int *data, int bits_to_read);
 int fuji_decode_sample_even(struct fuji_compressed_block* info, const struct fuji_compressed_params * params, ushort* line_buf, int pos, struct int_pair* grads);
 int fuji_decode_sample_odd(struct fuji_compressed_block* info, const struct fuji_compressed_params * params, ushort* line_buf, int pos, struct int_pair* grads);
-void fuji_decode_interpolation_even(int line_width, ushort* line_buf, int pos);
+void fuji_decode_interpolation_even_line(int line_width, ushort* line_buf, int start, int step);
 void fuji_extend_generic(ushort *linebuf[_ltotal], int line_width, int start, int end);
 void fuji_extend_red(ushort *linebuf[_ltotal], int line_width);
 void fuji_extend_green(ushort *linebuf[_ltotal], int line_width);
@@ -567,7 +572,7 @@ void selectCRXTrack(unsigned short maxTrack);
 int parseCR3(unsigned long long oAtomList,
              unsigned long long szAtomList, short &nesting,
              char *AtomNameStack, unsigned short &nTrack, short &TrackType);
-bool crxDecodePlane(void *p, uint32_t planeNumber);
+bool crxDecodeTile(void *p, uint32_t tileNumber, uint32_t planeNumber);
 void crxLoadDecodeLoop(void *img, int nPlanes);
 void crxConvertPlaneLineDf(void *p, int imageRow);
 void crxLoadFinalizeLoopE3(void *p, int planeHeight);
@@ -30,6 +30,7 @@
 #include "procparams.h"
 #include "refreshmap.h"
 #include "rt_math.h"
+#include "tracer.h"
 #include "color.h"
 #include "../rtgui/editcallbacks.h"
 #include "guidedfilter.h"
@@ -52,17 +53,26 @@ namespace rtengine
 {
 
 Crop::Crop(ImProcCoordinator* parent, EditDataProvider *editDataProvider, bool isDetailWindow)
+    : Crop(parent, editDataProvider, isDetailWindow, false)
+{
+}
+
+Crop::Crop(ImProcCoordinator* parent, EditDataProvider *editDataProvider, bool isDetailWindow, bool coarse)
     : PipetteBuffer(editDataProvider), origCrop(nullptr), laboCrop(nullptr), labnCrop(nullptr),
-      cropImg(nullptr), shbuf_real(nullptr), transCrop(nullptr), cieCrop(nullptr), shbuffer(nullptr),
-      updating(false), newUpdatePending(false), skip(10),
+      shbuf_real(nullptr), transCrop(nullptr), cieCrop(nullptr), shbuffer(nullptr),
+      updating(false), newUpdatePending(false), skip(10), coarse(coarse),
       cropx(0), cropy(0), cropw(-1), croph(-1),
       trafx(0), trafy(0), trafw(-1), trafh(-1),
       rqcropx(0), rqcropy(0), rqcropw(-1), rqcroph(-1),
       borderRequested(32), upperBorder(0), leftBorder(0),
       cropAllocated(false),
-      cropImageListener(nullptr), parent(parent), isDetailWindow(isDetailWindow)
+      cropImageListener(nullptr), parent(parent), isDetailWindow(isDetailWindow),
+      labAdjustmentsCache(sameCropLabAdjustmentsParams),
+      coarseCropTodo(0)
 {
-    parent->crops.push_back(this);
+    if (!coarse) {
+        parent->crops.push_back(this);
+    }
 }
 
 Crop::~Crop()
@@ -83,6 +93,7 @@ Crop::~Crop()
 void Crop::destroy()
 {
     MyMutex::MyLock lock(cropMutex);
+    coarseCrop.reset();
     MyMutex::MyLock processingLock(parent->mProcessing);
     freeAll();
 }
@@ -138,10 +149,31 @@ bool Crop::hasListener()
     return cropImageListener;
 }
 
-void Crop::update(int todo)
+int Crop::update(int todo, bool coarse)
 {
     MyMutex::MyLock cropLock(cropMutex);
 
+    if (coarse) {
+        // The coarse crop has its own buffers, so that the refined pass finds the state of this one unchanged.
+        // The edit tools read the pipette buffers at the scale of the window, they only get the refined pass
+        if (!cropImageListener || getCurrEditID() != EUID_None) {
+            return 0;
+        }
+
+        if (!coarseCrop) {
+            coarseCrop.reset(new Crop(parent, nullptr, isDetailWindow, true));
+        }
+
+        coarseCrop->cropImageListener = cropImageListener;
+        todo = coarseCrop->update(todo | coarseCropTodo);
+        coarseCropTodo = 0;
+        return todo;
+    }
+
+    coarseCropTodo |= todo;
+
+    TraceScope trace("Crop::update", cropw, croph);
+
     ProcParams& params = *parent->params;
 //       CropGUIListener* cropgl;
 
@@ -154,6 +186,10 @@ void Crop::update(int todo)
 
     if (overrideWindow) {
         cropImageListener->getWindow(wx, wy, ww, wh, ws);
+
+        if (this->coarse) {
+            ws *= 2;
+        }
     }
 
     // re-allocate sub-images and arrays if their dimensions changed
@@ -170,6 +206,11 @@ void Crop::update(int todo)
         todo = ALL;
     }
 
+    // The input of the L*a*b* adjustments changes with any earlier stage
+    if (todo & ~(M_LUMACURVE | M_LUMINANCE | M_COLOR | M_MONITOR)) {
+        labAdjustmentsCache.invalidate();
+    }
+
     // Tells to the ImProcFunctions' tool what is the preview scale, which may lead to some simplifications
     parent->ipf.setScale(skip);
 
@@ -1177,48 +1218,55 @@ void Crop::update(int todo)
 
     // apply luminance operations
     if (todo & (M_LUMINANCE + M_COLOR)) { //
-        //I made a little change here. Rather than have luminanceCurve (and others) use in/out lab images, we can do more if we copy right here.
-        labnCrop->CopyFrom(laboCrop);
-
-        bool utili = parent->utili;
-        bool autili = parent->autili;
-        bool butili = parent->butili;
-        bool ccutili = parent->ccutili;
-        bool clcutili = parent->clcutili;
-        bool cclutili = parent->cclutili;
-
         LUTu dummy;
-        parent->ipf.chromiLuminanceCurve(this, 1, labnCrop, labnCrop, parent->chroma_acurve, parent->chroma_bcurve, parent->satcurve, parent->lhskcurve,  parent->clcurve, parent->lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
-        parent->ipf.vibrance(labnCrop, params.vibrance, params.toneCurve.hrenabled, params.icm.workingProfile);
-        parent->ipf.labColorCorrectionRegions(labnCrop);
 
-        if ((params.colorappearance.enabled && !params.colorappearance.tonecie) || (!params.colorappearance.enabled)) {
-            parent->ipf.EPDToneMap(labnCrop, 0, skip);
-        }
-
-        //parent->ipf.EPDToneMap(labnCrop, 5, 1);    //Go with much fewer than normal iterates for fast redisplay.
-        // for all treatments Defringe, Sharpening, Contrast detail , Microcontrast they are activated if "CIECAM" function are disabled
-        if (skip == 1) {
-            if ((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled)) {
-                parent->ipf.impulsedenoise(labnCrop);
-                parent->ipf.defringe(labnCrop);
+        // Only the tools after the wavelets run again if the parameters of the ones before are unchanged,
+        // the edit tools need the pipette buffer filled by chromiLuminanceCurve()
+        if (getCurrEditID() != EUID_None || !labAdjustmentsCache.restore(params, parent->sharpMask, *labnCrop)) {
+            //I made a little change here. Rather than have luminanceCurve (and others) use in/out lab images, we can do more if we copy right here.
+            labnCrop->CopyFrom(laboCrop);
+
+            bool utili = parent->utili;
+            bool autili = parent->autili;
+            bool butili = parent->butili;
+            bool ccutili = parent->ccutili;
+            bool clcutili = parent->clcutili;
+            bool cclutili = parent->cclutili;
+
+            parent->ipf.chromiLuminanceCurve(this, 1, labnCrop, labnCrop, parent->chroma_acurve, parent->chroma_bcurve, parent->satcurve, parent->lhskcurve,  parent->clcurve, parent->lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+            parent->ipf.vibrance(labnCrop, params.vibrance, params.toneCurve.hrenabled, params.icm.workingProfile);
+            parent->ipf.labColorCorrectionRegions(labnCrop);
+
+            if ((params.colorappearance.enabled && !params.colorappearance.tonecie) || (!params.colorappearance.enabled)) {
+                parent->ipf.EPDToneMap(labnCrop, 0, skip);
             }
 
-            parent->ipf.MLsharpen(labnCrop);
+            //parent->ipf.EPDToneMap(labnCrop, 5, 1);    //Go with much fewer than normal iterates for fast redisplay.
+            // for all treatments Defringe, Sharpening, Contrast detail , Microcontrast they are activated if "CIECAM" function are disabled
+            if (skip == 1) {
+                if ((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled)) {
+                    parent->ipf.impulsedenoise(labnCrop);
+                    parent->ipf.defringe(labnCrop);
+                }
 
-            if ((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled)) {
-                parent->ipf.MLmicrocontrast(labnCrop);
-                parent->ipf.sharpening(labnCrop, params.sharpening, parent->sharpMask);
+                parent->ipf.MLsharpen(labnCrop);
+
+                if ((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled)) {
+                    parent->ipf.MLmicrocontrast(labnCrop);
+                    parent->ipf.sharpening(labnCrop, params.sharpening, parent->sharpMask);
+                }
             }
-        }
 
-        //   if (skip==1) {
+            //   if (skip==1) {
 
-        if (params.dirpyrequalizer.cbdlMethod == "aft") {
-            if (((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled))) {
-                parent->ipf.dirpyrequalizer(labnCrop, skip);
-                //  parent->ipf.Lanczoslab (labnCrop,labnCrop , 1.f/skip);
+            if (params.dirpyrequalizer.cbdlMethod == "aft") {
+                if (((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled))) {
+                    parent->ipf.dirpyrequalizer(labnCrop, skip);
+                    //  parent->ipf.Lanczoslab (labnCrop,labnCrop , 1.f/skip);
+                }
             }
+
+            labAdjustmentsCache.store(params, parent->sharpMask, *labnCrop);
         }
 
         if ((params.wavelet.enabled)) {
@@ -1518,40 +1566,33 @@ void Crop::update(int todo)
     // all pipette buffer processing should be finished now
     PipetteBuffer::setReady();
 
-    // Computing the preview image, i.e. converting from lab->Monitor color space (soft-proofing disabled) or lab->Output profile->Monitor color space (soft-proofing enabled)
-    parent->ipf.lab2monitorRgb(labnCrop, cropImg);
-
     if (cropImageListener) {
-        // Computing the internal image for analysis, i.e. conversion from lab->Output profile (rtSettings.HistogramWorking disabled) or lab->WCS (rtSettings.HistogramWorking enabled)
-
-        // internal image in output color space for analysis
-        Image8 *cropImgtrue = parent->ipf.lab2rgb(labnCrop, 0, 0, cropw, croph, params.icm);
-
+        // Only the requested part is converted, without the border, straight into the images given to the listener
         int finalW = rqcropw;
 
-        if (cropImg->getWidth() - leftBorder < finalW) {
-            finalW = cropImg->getWidth() - leftBorder;
+        if (cropw - leftBorder < finalW) {
+            finalW = cropw - leftBorder;
         }
 
         int finalH = rqcroph;
 
-        if (cropImg->getHeight() - upperBorder < finalH) {
-            finalH = cropImg->getHeight() - upperBorder;
+        if (croph - upperBorder < finalH) {
+            finalH = croph - upperBorder;
         }
 
+        // Computing the preview image, i.e. converting from lab->Monitor color space (soft-proofing disabled) or lab->Output profile->Monitor color space (soft-proofing enabled)
         Image8* final = new Image8(finalW, finalH);
-        Image8* finaltrue = new Image8(finalW, finalH);
+        parent->ipf.lab2monitorRgb(labnCrop, final, leftBorder, upperBorder);
 
-        for (int i = 0; i < finalH; i++) {
-            memcpy(final->data + 3 * i * finalW, cropImg->data + 3 * (i + upperBorder)*cropw + 3 * leftBorder, 3 * finalW);
-            memcpy(finaltrue->data + 3 * i * finalW, cropImgtrue->data + 3 * (i + upperBorder)*cropw + 3 * leftBorder, 3 * finalW);
-        }
+        // Computing the internal image for analysis, i.e. conversion from lab->Output profile (rtSettings.HistogramWorking disabled) or lab->WCS (rtSettings.HistogramWorking enabled)
+        Image8* finaltrue = parent->ipf.lab2rgb(labnCrop, leftBorder, upperBorder, finalW, finalH, params.icm);
 
         cropImageListener->setDetailedCrop(final, finaltrue, params.icm, params.crop, rqcropx, rqcropy, rqcropw, rqcroph, skip);
         delete final;
         delete finaltrue;
-        delete cropImgtrue;
     }
+
+    return todo;
 }
 
 void Crop::freeAll()
@@ -1579,11 +1620,6 @@ void Crop::freeAll()
             labnCrop = nullptr;
         }
 
-        if (cropImg) {
-            delete    cropImg;
-            cropImg = nullptr;
-        }
-
         if (cieCrop) {
             delete    cieCrop;
             cieCrop = nullptr;
@@ -1757,12 +1793,6 @@ bool Crop::setCropSizes(int rcx, int rcy, int rcw, int rch, int skip, bool inter
 
         labnCrop = new LabImage(cropw, croph);
 
-        if (!cropImg) {
-            cropImg = new Image8;
-        }
-
-        cropImg->allocate(cropw, croph);  // Resizing the buffer (optimization)
-
         //cieCrop is only used in Crop::update, it is destroyed now but will be allocated on first use
         if (cieCrop) {
             delete cieCrop;
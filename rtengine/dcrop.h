@@ -18,6 +18,9 @@
  */
 #pragma once
 
+#include <memory>
+
+#include "labstagecache.h"
 #include "rtengine.h"
 #include "pipettebuffer.h"
 #include "../rtgui/threadutils.h"
@@ -40,7 +43,6 @@ protected:
     Imagefloat*  origCrop;   // "one chunk" allocation
     LabImage*    laboCrop;   // "one chunk" allocation
     LabImage*    labnCrop;   // "one chunk" allocation
-    Image8*      cropImg;    // "one chunk" allocation ; displayed image in monitor color space, showing the output profile as well (soft-proofing enabled, which then correspond to workimg) or not
     float *      shbuf_real;  // "one chunk" allocation
 
     // --- automatically allocated and deleted when necessary, and only renewed on size changes
@@ -52,6 +54,7 @@ protected:
     bool updating;         /// Flag telling if an updater thread is currently processing
     bool newUpdatePending; /// Flag telling the updater thread that a new update is pending
     int skip;
+    const bool coarse;     /// the crop is computed at twice the skip of the window of its listener
     int cropx, cropy, cropw, croph;         /// size of the detail crop image ('skip' taken into account), with border
     int trafx, trafy, trafw, trafh;         /// the size and position to get from the imagesource that is transformed to the requested crop area
     int rqcropx, rqcropy, rqcropw, rqcroph; /// size of the requested detail crop image (the image might be smaller) (without border)
@@ -64,17 +67,28 @@ protected:
     MyMutex cropMutex;
     ImProcCoordinator* const parent;
     const bool isDetailWindow;
+    LabStageCache labAdjustmentsCache;      /// output of the L*a*b* adjustments preceding the wavelets
+    std::unique_ptr<Crop> coarseCrop;       /// quick first result of the progressive updates, with its own buffers
+    int coarseCropTodo;                     /// changes processed since the last update of coarseCrop
     EditUniqueID getCurrEditID();
     bool setCropSizes(int cropX, int cropY, int cropW, int cropH, int skip, bool internal);
     void freeAll();
 
+private:
+    /// A coarse crop isn't registered in the crops of parent, it is only updated by the crop owning it
+    Crop(ImProcCoordinator* parent, EditDataProvider *editDataProvider, bool isDetailWindow, bool coarse);
+
 public:
     Crop(ImProcCoordinator* parent, EditDataProvider *editDataProvider, bool isDetailWindow);
     ~Crop    () override;
 //   MyMutex* locMutex;
     void setEditSubscriber(EditSubscriber* newSubscriber);
     bool hasListener();
-    void update(int todo);
+    /** @brief Processes the crop
+     * @param coarse computes it at twice the skip of its window in separate buffers, as a quick first result
+     * @return the changes processed, which may be more than todo
+     */
+    int update(int todo, bool coarse = false);
     void setWindow   (int cropX, int cropY, int cropW, int cropH, int skip) override
     {
         setCropSizes(cropX, cropY, cropW, cropH, skip, false);
@@ -0,0 +1,336 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <giomm.h>
+#include <glibmm/checksum.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include "demosaiccache.h"
+#include "settings.h"
+#include "../rtgui/options.h"
+
+namespace
+{
+
+constexpr char CACHE_MAGIC[4] = {'R', 'T', 'D', 'C'};
+constexpr std::uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+    double contrastThreshold;
+};
+
+bool readBlock(FILE* f, std::vector<Bytef>& block, uLong maxSize)
+{
+    std::uint64_t size;
+
+    if (fread(&size, sizeof(size), 1, f) != 1 || size > maxSize) {
+        return false;
+    }
+
+    block.resize(size);
+    return fread(block.data(), 1, size, f) == size;
+}
+
+bool writeBlock(FILE* f, const std::vector<Bytef>& block)
+{
+    const std::uint64_t size = block.size();
+    return fwrite(&size, sizeof(size), 1, f) == 1 && fwrite(block.data(), 1, size, f) == size;
+}
+
+// array2D keeps its rows in one contiguous buffer, so a plane is compressed in one go
+uLong getPlaneSize(const array2D<float>& plane)
+{
+    return static_cast<uLong>(plane.getWidth()) * plane.getHeight() * sizeof(float);
+}
+
+bool compressPlane(const array2D<float>& plane, std::vector<Bytef>& block)
+{
+    uLongf size = compressBound(getPlaneSize(plane));
+    block.resize(size);
+
+    if (compress2(block.data(), &size, reinterpret_cast<const Bytef*>(plane[0]), getPlaneSize(plane), Z_BEST_SPEED) != Z_OK) {
+        return false;
+    }
+
+    block.resize(size);
+    return true;
+}
+
+bool uncompressPlane(const std::vector<Bytef>& block, array2D<float>& plane)
+{
+    uLongf size = getPlaneSize(plane);
+    return uncompress(reinterpret_cast<Bytef*>(plane[0]), &size, block.data(), block.size()) == Z_OK && size == getPlaneSize(plane);
+}
+
+}
+
+rtengine::DemosaicCache& rtengine::DemosaicCache::getInstance()
+{
+    static DemosaicCache instance;
+    return instance;
+}
+
+bool rtengine::DemosaicCache::isEnabled() const
+{
+    return options.demosaicCacheSize > 0 && !dir.empty();
+}
+
+std::string rtengine::DemosaicCache::getFileHash(const Glib::ustring& fname)
+{
+    try {
+        const auto info = Gio::File::create_for_path(fname)->query_info("standard::size,time::modified");
+
+        if (info) {
+            const Glib::ustring identifier = Glib::ustring::compose("%1-%2-%3", fname, info->get_size(), info->modification_time().as_iso8601());
+            return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, identifier);
+        }
+    } catch (Glib::Exception&) {}
+
+    return {};
+}
+
+bool rtengine::DemosaicCache::get(const std::string& key, array2D<float>& red, array2D<float>& green, array2D<float>& blue, double& contrastThreshold) const
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    const Glib::ustring fname = getCacheFileName(key);
+    FILE* const f = g_fopen(fname.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    CacheHeader header;
+    std::vector<Bytef> blocks[3];
+    const uLong maxBlockSize = compressBound(getPlaneSize(red));
+
+    bool ok =
+        fread(&header, sizeof(header), 1, f) == 1
+        && !std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+        && header.version == CACHE_VERSION
+        && header.width == red.getWidth()
+        && header.height == red.getHeight()
+        && readBlock(f, blocks[0], maxBlockSize)
+        && readBlock(f, blocks[1], maxBlockSize)
+        && readBlock(f, blocks[2], maxBlockSize);
+
+    fclose(f);
+
+    if (ok) {
+        array2D<float>* const planes[3] = {&red, &green, &blue};
+        bool planeOk[3];
+
+#ifdef _OPENMP
+        #pragma omp parallel for num_threads(3)
+#endif
+        for (int i = 0; i < 3; ++i) {
+            planeOk[i] = uncompressPlane(blocks[i], *planes[i]);
+        }
+
+        ok = planeOk[0] && planeOk[1] && planeOk[2];
+    }
+
+    const std::string name = Glib::path_get_basename(fname);
+
+    if (!ok) {
+        g_remove(fname.c_str());
+
+        MyMutex::MyLock lock(mutex);
+        const auto entry = entries.find(name);
+
+        if (entry != entries.end()) {
+            totalSize -= entry->second.size;
+            entries.erase(entry);
+        }
+
+        return false;
+    }
+
+    contrastThreshold = header.contrastThreshold;
+
+    // Touch the entry, the size limitation removes the least recently used ones first.
+    // The modification time only matters for the next session, see scanEntries()
+    g_utime(fname.c_str(), nullptr);
+
+    {
+        MyMutex::MyLock lock(mutex);
+        const auto entry = entries.find(name);
+
+        if (entry != entries.end()) {
+            entry->second.lastUse = g_get_real_time();
+        }
+    }
+
+    if (settings->verbose) {
+        printf("Demosaiced data read from cache: %s\n", fname.c_str());
+    }
+
+    return true;
+}
+
+void rtengine::DemosaicCache::put(const std::string& key, const array2D<float>& red, const array2D<float>& green, const array2D<float>& blue, double contrastThreshold) const
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    if (g_mkdir_with_parents(dir.c_str(), 511) != 0) {
+        return;
+    }
+
+    const array2D<float>* const planes[3] = {&red, &green, &blue};
+    std::vector<Bytef> blocks[3];
+    bool planeOk[3];
+
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(3)
+#endif
+    for (int i = 0; i < 3; ++i) {
+        planeOk[i] = compressPlane(*planes[i], blocks[i]);
+    }
+
+    if (!planeOk[0] || !planeOk[1] || !planeOk[2]) {
+        return;
+    }
+
+    // Write to a temporary file first, so that concurrent readers never see a partial entry
+    const Glib::ustring fname = getCacheFileName(key);
+    const Glib::ustring tmpName = Glib::ustring::compose("%1.%2.tmp", fname, std::hash<std::thread::id>()(std::this_thread::get_id()));
+    FILE* const f = g_fopen(tmpName.c_str(), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.width = red.getWidth();
+    header.height = red.getHeight();
+    header.contrastThreshold = contrastThreshold;
+
+    const bool ok =
+        fwrite(&header, sizeof(header), 1, f) == 1
+        && writeBlock(f, blocks[0])
+        && writeBlock(f, blocks[1])
+        && writeBlock(f, blocks[2]);
+    const goffset size = ftell(f);
+
+    if (fclose(f) != 0 || !ok || g_rename(tmpName.c_str(), fname.c_str()) != 0) {
+        g_remove(tmpName.c_str());
+        return;
+    }
+
+    MyMutex::MyLock lock(mutex);
+
+    // The entry may replace one written meanwhile by another thread
+    Entry& entry = entries[Glib::path_get_basename(fname)];
+    totalSize += size - entry.size;
+    entry = {size, g_get_real_time()};
+
+    applyCacheSizeLimitation();
+}
+
+rtengine::DemosaicCache::DemosaicCache() :
+    dir(options.cacheBaseDir.empty() ? Glib::ustring() : Glib::ustring(Glib::build_filename(options.cacheBaseDir, "demosaic"))),
+    totalSize(0)
+{
+    if (isEnabled()) {
+        scanEntries();
+    }
+}
+
+Glib::ustring rtengine::DemosaicCache::getCacheFileName(const std::string& key) const
+{
+    return Glib::build_filename(dir, Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, key) + ".rtdc");
+}
+
+void rtengine::DemosaicCache::scanEntries()
+{
+    try {
+        const auto enumerator = Gio::File::create_for_path(dir)->enumerate_children("standard::name,standard::size,time::modified");
+
+        while (const auto file = enumerator->next_file()) {
+            const std::string name = file->get_name();
+
+            if (name.size() > 5 && name.compare(name.size() - 5, 5, ".rtdc") == 0) {
+                const Glib::TimeVal time = file->modification_time();
+                entries[name] = {file->get_size(), static_cast<gint64>(time.tv_sec) * G_USEC_PER_SEC + time.tv_usec};
+                totalSize += file->get_size();
+            }
+        }
+    } catch (Glib::Exception&) {
+        // The folder doesn't exist yet
+    }
+
+    MyMutex::MyLock lock(mutex);
+    applyCacheSizeLimitation();
+}
+
+// Must be called with mutex locked
+void rtengine::DemosaicCache::applyCacheSizeLimitation() const
+{
+    const goffset maxSize = static_cast<goffset>(options.demosaicCacheSize) * 1024 * 1024;
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::vector<std::map<std::string, Entry>::iterator> lru;
+    lru.reserve(entries.size());
+
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        lru.push_back(entry);
+    }
+
+    std::sort(
+        lru.begin(),
+        lru.end(),
+        [](const std::map<std::string, Entry>::iterator& lhs, const std::map<std::string, Entry>::iterator& rhs) -> bool
+        {
+            return lhs->second.lastUse < rhs->second.lastUse;
+        }
+    );
+
+    const goffset targetSize = maxSize - maxSize * 5 / 100; // reserve 5% free cache space
+
+    for (const auto& entry : lru) {
+        if (totalSize <= targetSize) {
+            break;
+        }
+
+        // Forget the entry even if it can't be removed, so that the next puts don't retry it
+        g_remove(Glib::build_filename(dir, entry->first).c_str());
+        totalSize -= entry->second.size;
+        entries.erase(entry);
+    }
+}
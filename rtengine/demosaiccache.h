@@ -0,0 +1,80 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <glibmm/ustring.h>
+
+#include "array2D.h"
+#include "noncopyable.h"
+
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/**
+ * Persistent on-disk cache of demosaiced raw data.
+ *
+ * An entry holds the red, green and blue planes produced by RawImageSource::demosaic() as
+ * deflate compressed floats, so reopening or re-exporting a raw file whose preprocessing and
+ * demosaicing parameters did not change can skip those stages. Entries are looked up by a key
+ * that must identify both the raw file and every parameter having an influence on the planes.
+ *
+ * The cache lives in the "demosaic" folder of the cache directory and is disabled when
+ * options.demosaicCacheSize (in MiB) is 0. When it grows above that size, the least recently
+ * used entries are removed. The folder is only scanned once, the entries are then tracked in memory.
+ */
+class DemosaicCache final :
+    public NonCopyable
+{
+public:
+    static DemosaicCache& getInstance();
+
+    bool isEnabled() const;
+
+    /** Returns an MD5 hash identifying the file, based on its name, size and modification time,
+      * or an empty string if the file can't be queried. */
+    static std::string getFileHash(const Glib::ustring& fname);
+
+    /** Fills red, green and blue (which must already have the right size) from the entry
+      * stored under key. Returns false if there is no valid entry. */
+    bool get(const std::string& key, array2D<float>& red, array2D<float>& green, array2D<float>& blue, double& contrastThreshold) const;
+    void put(const std::string& key, const array2D<float>& red, const array2D<float>& green, const array2D<float>& blue, double contrastThreshold) const;
+
+private:
+    struct Entry {
+        goffset size;
+        gint64 lastUse; // microseconds, see g_get_real_time()
+    };
+
+    DemosaicCache();
+
+    Glib::ustring getCacheFileName(const std::string& key) const;
+    void scanEntries();
+    void applyCacheSizeLimitation() const;
+
+    const Glib::ustring dir;
+
+    mutable MyMutex mutex;
+    mutable std::map<std::string, Entry> entries; // by file name
+    mutable goffset totalSize;
+};
+
+}
@@ -24,6 +24,7 @@
 #include <glibmm/miscutils.h>
 #include <glibmm/keyfile.h>
 
+#include "metadataprobe.h"
 #include "rtengine.h"
 #include "../rtgui/options.h"
 
@@ -89,6 +90,21 @@ bool DynamicProfileRule::matches (const rtengine::FramesMetaData *im) const
             && imagetype(im->getImageType(0)));
 }
 
+bool DynamicProfileRule::matches (const rtengine::ProbedMetaData &data) const
+{
+    return (iso (data.isoSpeed)
+            && fnumber (data.fNumber)
+            && focallen (data.focalLen)
+            && shutterspeed (data.shutterSpeed)
+            && expcomp (data.expComp)
+            && camera (data.getCamera()));
+}
+
+bool DynamicProfileRule::needsFullMetaData () const
+{
+    return lens.enabled || imagetype.enabled;
+}
+
 namespace
 {
 
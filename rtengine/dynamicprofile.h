@@ -24,6 +24,7 @@
 namespace rtengine
 {
     class FramesMetaData;
+    struct ProbedMetaData;
 }
 
 class DynamicProfileRule
@@ -52,6 +53,10 @@ public:
 
     DynamicProfileRule();
     bool matches (const rtengine::FramesMetaData *im) const;
+    /** Matches the data of probeMetaData(), only valid if !needsFullMetaData() */
+    bool matches (const rtengine::ProbedMetaData &data) const;
+    /** True if the rule depends on the lens or the image type, which are found in the maker notes */
+    bool needsFullMetaData () const;
     bool operator< (const DynamicProfileRule &other) const;
 
     int serial_number;
@@ -0,0 +1,148 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <tuple>
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "fftwplancache.h"
+#include "settings.h"
+
+namespace
+{
+
+// Number of plans kept, the least recently used ones are destroyed first
+constexpr unsigned long PLAN_CACHE_SIZE = 64;
+
+// Padding of the planning arrays, large enough to reproduce any SIMD alignment offset
+constexpr int ALIGNMENT_PADDING = 64 / sizeof(float);
+
+}
+
+rtengine::FFTWPlanCache& rtengine::FFTWPlanCache::getInstance()
+{
+    static FFTWPlanCache instance;
+    return instance;
+}
+
+void rtengine::FFTWPlanCache::init(const Glib::ustring& wisdomFile)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+#ifdef RT_FFTW3F_OMP
+    fftwf_init_threads();
+#endif
+
+    this->wisdomFile = wisdomFile;
+
+    if (!wisdomFile.empty() && Glib::file_test(wisdomFile, Glib::FILE_TEST_EXISTS)) {
+        const bool imported = fftwf_import_wisdom_from_filename(wisdomFile.c_str());
+
+        if (settings->verbose) {
+            printf("FFTW wisdom %s from %s\n", imported ? "loaded" : "could not be loaded", wisdomFile.c_str());
+        }
+    }
+}
+
+void rtengine::FFTWPlanCache::cleanup()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    cache.clear();
+
+    if (!wisdomFile.empty() && g_mkdir_with_parents(Glib::path_get_dirname(wisdomFile).c_str(), 511) == 0) {
+        fftwf_export_wisdom_to_filename(wisdomFile.c_str());
+    }
+}
+
+rtengine::FFTWPlanCache::Plan rtengine::FFTWPlanCache::getR2R2D(int n0, int n1, float* in, float* out, fftw_r2r_kind kind0, fftw_r2r_kind kind1, unsigned flags, int nthreads)
+{
+#ifndef RT_FFTW3F_OMP
+    nthreads = 1;
+#endif
+
+    return getPlan({n0, n1, 1, kind0, kind1, flags, nthreads, fftwf_alignment_of(in), fftwf_alignment_of(out), in == out});
+}
+
+rtengine::FFTWPlanCache::Plan rtengine::FFTWPlanCache::getManyR2R2D(int n0, int n1, int howmany, fftw_r2r_kind kind, unsigned flags)
+{
+    return getPlan({n0, n1, howmany, kind, kind, flags, 1, 0, 0, false});
+}
+
+bool rtengine::FFTWPlanCache::Key::operator <(const Key& other) const
+{
+    return
+        std::tie(n0, n1, howmany, kind0, kind1, flags, nthreads, inAlignment, outAlignment, inPlace)
+        < std::tie(other.n0, other.n1, other.howmany, other.kind0, other.kind1, other.flags, other.nthreads, other.inAlignment, other.outAlignment, other.inPlace);
+}
+
+rtengine::FFTWPlanCache::FFTWPlanCache() :
+    cache(PLAN_CACHE_SIZE)
+{
+}
+
+rtengine::FFTWPlanCache::Plan rtengine::FFTWPlanCache::getPlan(const Key& key)
+{
+    // The FFTW planner is not thread safe, this also serializes fftwf_destroy_plan() in the deleter below
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    Plan plan;
+
+    if (cache.get(key, plan)) {
+        return plan;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(key.n0) * key.n1 * key.howmany;
+    float* const inBuffer = fftwf_alloc_real(size + ALIGNMENT_PADDING);
+    float* const outBuffer = key.inPlace ? inBuffer : fftwf_alloc_real(size + ALIGNMENT_PADDING);
+
+    if (inBuffer && outBuffer) {
+        const int n[2] = {key.n0, key.n1};
+        const fftw_r2r_kind kinds[2] = {key.kind0, key.kind1};
+        const int dist = key.n0 * key.n1;
+        float* const in = inBuffer + key.inAlignment / sizeof(float);
+        float* const out = key.inPlace ? in : outBuffer + key.outAlignment / sizeof(float);
+
+#ifdef RT_FFTW3F_OMP
+        fftwf_plan_with_nthreads(key.nthreads);
+#endif
+
+        const fftwf_plan p = fftwf_plan_many_r2r(2, n, key.howmany, in, nullptr, 1, dist, out, nullptr, 1, dist, kinds, key.flags);
+
+        if (p) {
+            plan.reset(
+                p,
+                [this](fftwf_plan p)
+                {
+                    std::lock_guard<std::recursive_mutex> lock(mutex);
+                    fftwf_destroy_plan(p);
+                }
+            );
+            cache.set(key, plan);
+        }
+    }
+
+    if (outBuffer != inBuffer) {
+        fftwf_free(outBuffer);
+    }
+
+    fftwf_free(inBuffer);
+
+    return plan;
+}
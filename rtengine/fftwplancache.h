@@ -0,0 +1,88 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include <fftw3.h>
+#include <glibmm/ustring.h>
+
+#include "cache.h"
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/**
+ * Process-wide cache of FFTW plans.
+ *
+ * Planning with FFTW_MEASURE takes a lot longer than the transforms themselves, and even
+ * FFTW_ESTIMATE planning is not free for the large transforms of the local adjustments. Plans
+ * are therefore kept by transform shape and reused. FFTW's wisdom is imported at startup and
+ * exported at shutdown, so measured plans are only measured once per machine.
+ *
+ * Plans are created on scratch arrays having the same SIMD alignment as the arrays passed in,
+ * so planning never overwrites the caller's data and the plans must be executed with the
+ * new-array execute functions (fftwf_execute_r2r()) on the caller's arrays. All FFTW planning
+ * in rtengine goes through this class, which serializes it.
+ */
+class FFTWPlanCache final :
+    public NonCopyable
+{
+public:
+    using Plan = std::shared_ptr<fftwf_plan_s>;
+
+    static FFTWPlanCache& getInstance();
+
+    /** Loads the wisdom from wisdomFile. */
+    void init(const Glib::ustring& wisdomFile);
+    /** Destroys all cached plans and saves the wisdom to the file given to init(). */
+    void cleanup();
+
+    /** Same plan as fftwf_plan_r2r_2d(n0, n1, in, out, kind0, kind1, flags) using nthreads threads. */
+    Plan getR2R2D(int n0, int n1, float* in, float* out, fftw_r2r_kind kind0, fftw_r2r_kind kind1, unsigned flags, int nthreads = 1);
+    /** Same plan as fftwf_plan_many_r2r() for howmany contiguous n0 x n1 blocks, with the same kind in both dimensions,
+      * for out-of-place transforms between arrays allocated with fftwf_malloc(). */
+    Plan getManyR2R2D(int n0, int n1, int howmany, fftw_r2r_kind kind, unsigned flags);
+
+private:
+    struct Key {
+        int n0;
+        int n1;
+        int howmany;
+        fftw_r2r_kind kind0;
+        fftw_r2r_kind kind1;
+        unsigned flags;
+        int nthreads;
+        int inAlignment;
+        int outAlignment;
+        bool inPlace;
+
+        bool operator <(const Key& other) const;
+    };
+
+    FFTWPlanCache();
+
+    Plan getPlan(const Key& key);
+
+    std::recursive_mutex mutex;
+    Cache<Key, Plan> cache;
+    Glib::ustring wisdomFile;
+};
+
+}
@@ -31,6 +31,18 @@ int bitDiff (int value1, int value2)
     return decBits;
 }
 
+// Big endian 32 bit word at data, which doesn't need to be aligned
+inline unsigned getBigEndian32 (const uchar* data)
+{
+    unsigned word;
+    memcpy (&word, data, sizeof (word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return word;
+#else
+    return __builtin_bswap32 (word);
+#endif
+}
+
 }
 
 void CLASS init_fuji_compr (struct fuji_compressed_params* info)
@@ -107,15 +119,10 @@ void CLASS fuji_fill_buffer (struct fuji_compressed_block *info)
         info->cur_buf_offset += info->cur_buf_size;
 #ifdef MYFILE_MMAP
         info->cur_buf_size = info->max_read_size;
-        info->cur_buf = fdata(info->cur_buf_offset, info->input);
+        info->cur_buf = fdata(info->cur_buf_offset, &info->input);
 #else
-#ifdef _OPENMP
-        #pragma omp critical
-#endif
-        {
-            fseek (info->input, info->cur_buf_offset, SEEK_SET);
-            info->cur_buf_size = fread (info->cur_buf, 1, std::min (info->max_read_size, FUJI_BUF_SIZE), info->input);
-        }
+        fseek (&info->input, info->cur_buf_offset, SEEK_SET);
+        info->cur_buf_size = fread (info->cur_buf, 1, std::min (info->max_read_size, FUJI_BUF_SIZE), &info->input);
 #endif
         if (info->cur_buf_size < 1) { // nothing read
             if (info->fillbytes > 0) {
@@ -134,8 +141,10 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
     info->linealloc = (ushort*)calloc (sizeof (ushort), _ltotal * (params->line_width + 2));
     merror (info->linealloc, "init_fuji_block()");
 
-    info->input = ifp;
-    INT64 fsize = info->input->size;
+    // Each block reads the file through its own cursor, so the blocks can be decoded concurrently
+    info->input = *ifp;
+    info->input.plistener = nullptr; // the progress updates are not thread safe
+    INT64 fsize = info->input.size;
     info->max_read_size = std::min (unsigned (fsize - raw_offset), dsize + 16); // Data size may be incorrect?
     info->fillbytes = 1;
 
@@ -278,9 +287,34 @@ void CLASS copy_line_to_bayer (struct fuji_compressed_block *info, int cur_line,
 
 inline void CLASS fuji_zerobits (struct fuji_compressed_block* info, int *count)
 {
-    uchar zero = 0;
     *count = 0;
 
+    // Whole words are scanned while they are in the buffer, the last bytes are read bit by bit
+    while (info->cur_pos + 4 <= info->cur_buf_size) {
+        const unsigned word = getBigEndian32 (info->cur_buf + info->cur_pos) << info->cur_bit;
+
+        if (word) {
+            const int zeros = __builtin_clz (word);
+            const int bits = info->cur_bit + zeros + 1;
+            *count += zeros;
+            info->cur_pos += bits >> 3;
+            info->cur_bit = bits & 7;
+#ifndef MYFILE_MMAP
+            fuji_fill_buffer (info);
+#endif
+            return;
+        }
+
+        *count += 32 - info->cur_bit;
+        info->cur_pos += 4;
+        info->cur_bit = 0;
+#ifndef MYFILE_MMAP
+        fuji_fill_buffer (info);
+#endif
+    }
+
+    uchar zero = 0;
+
     while (zero == 0) {
         zero = (info->cur_buf[info->cur_pos] >> (7 - info->cur_bit)) & 1;
         info->cur_bit++;
@@ -309,6 +343,18 @@ inline void CLASS fuji_read_code (struct fuji_compressed_block* info, int *data,
         return;
     }
 
+    // at most 7 + 14 bits, which fit in a word
+    if (info->cur_pos + 4 <= info->cur_buf_size) {
+        const int bits = info->cur_bit + bits_to_read;
+        *data = (getBigEndian32 (info->cur_buf + info->cur_pos) << info->cur_bit) >> (32 - bits_to_read);
+        info->cur_pos += bits >> 3;
+        info->cur_bit = bits & 7;
+#ifndef MYFILE_MMAP
+        fuji_fill_buffer (info);
+#endif
+        return;
+    }
+
     uchar bits_left = bits_to_read;
     uchar bits_left_in_byte = 8 - (info->cur_bit & 7);
 
@@ -491,23 +537,28 @@ int CLASS fuji_decode_sample_odd (struct fuji_compressed_block* info, const stru
     return errcnt;
 }
 
-void CLASS fuji_decode_interpolation_even (int line_width, ushort* line_buf, int pos)
+// Interpolates the even samples which are not coded, at the positions start, start + step... of the line.
+// They only depend on the previous lines, so they are computed for the whole line before its coded
+// samples, in a loop the compiler can vectorise.
+void CLASS fuji_decode_interpolation_even_line (int line_width, ushort* line_buf, int start, int step)
 {
-    ushort* line_buf_cur = line_buf + pos;
-    int Rb = line_buf_cur[-2 - line_width];
-    int Rc = line_buf_cur[-3 - line_width];
-    int Rd = line_buf_cur[-1 - line_width];
-    int Rf = line_buf_cur[-4 - 2 * line_width];
-    int diffRcRb = std::abs (Rc - Rb);
-    int diffRfRb = std::abs (Rf - Rb);
-    int diffRdRb = std::abs (Rd - Rb);
-
-    if ( diffRcRb > diffRfRb && diffRcRb > diffRdRb ) {
-        *line_buf_cur = (Rf + Rd + 2 * Rb) >> 2;
-    } else if ( diffRdRb > diffRcRb && diffRdRb > diffRfRb ) {
-        *line_buf_cur = (Rf + Rc + 2 * Rb) >> 2;
-    } else {
-        *line_buf_cur = (Rd + Rc + 2 * Rb) >> 2;
+    const ushort* const prev = line_buf - 2 - line_width;
+    const ushort* const prev2 = line_buf - 4 - 2 * line_width;
+
+    for (int pos = start; pos < line_width; pos += step) {
+        const int Rb = prev[pos];
+        const int Rc = prev[pos - 1];
+        const int Rd = prev[pos + 1];
+        const int Rf = prev2[pos];
+        const int diffRcRb = std::abs (Rc - Rb);
+        const int diffRfRb = std::abs (Rf - Rb);
+        const int diffRdRb = std::abs (Rd - Rb);
+        const int sum =
+            diffRcRb > diffRfRb && diffRcRb > diffRdRb ? Rf + Rd
+            : diffRdRb > diffRcRb && diffRdRb > diffRfRb ? Rf + Rc
+            : Rd + Rc;
+
+        line_buf[pos] = (sum + 2 * Rb) >> 2;
     }
 }
 
@@ -544,10 +595,10 @@ void CLASS xtrans_decode_block (struct fuji_compressed_block* info, const struct
 
     const int line_width = params->line_width;
 
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_R2] + 1, 0, 2);
+
     while (g_even_pos < line_width || g_odd_pos < line_width) {
         if (g_even_pos < line_width) {
-            fuji_decode_interpolation_even (line_width, info->linebuf[_R2] + 1, r_even_pos);
-            r_even_pos += 2;
             errcnt += fuji_decode_sample_even (info, params, info->linebuf[_G2] + 1, g_even_pos, info->grad_even[0]);
             g_even_pos += 2;
         }
@@ -565,12 +616,12 @@ void CLASS xtrans_decode_block (struct fuji_compressed_block* info, const struct
 
     g_even_pos = 0, g_odd_pos = 1;
 
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_B2] + 1, 0, 2);
+
     while (g_even_pos < line_width || g_odd_pos < line_width) {
         if (g_even_pos < line_width) {
             errcnt += fuji_decode_sample_even (info, params, info->linebuf[_G3] + 1, g_even_pos, info->grad_even[1]);
             g_even_pos += 2;
-            fuji_decode_interpolation_even (line_width, info->linebuf[_B2] + 1, b_even_pos);
-            b_even_pos += 2;
         }
 
         if (g_even_pos > 8) {
@@ -587,16 +638,16 @@ void CLASS xtrans_decode_block (struct fuji_compressed_block* info, const struct
     r_even_pos = 0, r_odd_pos = 1;
     g_even_pos = 0, g_odd_pos = 1;
 
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_R3] + 1, 0, 4);
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_G4] + 1, 0, 2);
+
     while (g_even_pos < line_width || g_odd_pos < line_width) {
         if (g_even_pos < line_width) {
             if (r_even_pos & 3) {
                 errcnt += fuji_decode_sample_even (info, params, info->linebuf[_R3] + 1, r_even_pos, info->grad_even[2]);
-            } else {
-                fuji_decode_interpolation_even (line_width, info->linebuf[_R3] + 1, r_even_pos);
             }
 
             r_even_pos += 2;
-            fuji_decode_interpolation_even (line_width, info->linebuf[_G4] + 1, g_even_pos);
             g_even_pos += 2;
         }
 
@@ -614,14 +665,14 @@ void CLASS xtrans_decode_block (struct fuji_compressed_block* info, const struct
     g_even_pos = 0, g_odd_pos = 1;
     b_even_pos = 0, b_odd_pos = 1;
 
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_B3] + 1, 2, 4);
+
     while (g_even_pos < line_width || g_odd_pos < line_width) {
         if (g_even_pos < line_width) {
             errcnt += fuji_decode_sample_even (info, params, info->linebuf[_G5] + 1, g_even_pos, info->grad_even[0]);
             g_even_pos += 2;
 
-            if ((b_even_pos & 3) == 2) {
-                fuji_decode_interpolation_even (line_width, info->linebuf[_B3] + 1, b_even_pos);
-            } else {
+            if ((b_even_pos & 3) != 2) {
                 errcnt += fuji_decode_sample_even (info, params, info->linebuf[_B3] + 1, b_even_pos, info->grad_even[0]);
             }
 
@@ -642,11 +693,11 @@ void CLASS xtrans_decode_block (struct fuji_compressed_block* info, const struct
     r_even_pos = 0, r_odd_pos = 1;
     g_even_pos = 0, g_odd_pos = 1;
 
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_R4] + 1, 2, 4);
+
     while (g_even_pos < line_width || g_odd_pos < line_width) {
         if (g_even_pos < line_width) {
-            if ((r_even_pos & 3) == 2) {
-                fuji_decode_interpolation_even (line_width, info->linebuf[_R4] + 1, r_even_pos);
-            } else {
+            if ((r_even_pos & 3) != 2) {
                 errcnt += fuji_decode_sample_even (info, params, info->linebuf[_R4] + 1, r_even_pos, info->grad_even[1]);
             }
 
@@ -669,15 +720,15 @@ void CLASS xtrans_decode_block (struct fuji_compressed_block* info, const struct
     g_even_pos = 0, g_odd_pos = 1;
     b_even_pos = 0, b_odd_pos = 1;
 
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_G7] + 1, 0, 2);
+    fuji_decode_interpolation_even_line (line_width, info->linebuf[_B4] + 1, 0, 4);
+
     while (g_even_pos < line_width || g_odd_pos < line_width) {
         if (g_even_pos < line_width) {
-            fuji_decode_interpolation_even (line_width, info->linebuf[_G7] + 1, g_even_pos);
             g_even_pos += 2;
 
             if (b_even_pos & 3) {
                 errcnt += fuji_decode_sample_even (info, params, info->linebuf[_B4] + 1, b_even_pos, info->grad_even[2]);
-            } else {
-                fuji_decode_interpolation_even (line_width, info->linebuf[_B4] + 1, b_even_pos);
             }
 
             b_even_pos += 2;
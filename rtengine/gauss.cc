@@ -22,10 +22,16 @@
 
 #include "gauss.h"
 
+#include "alignedbuffer.h"
 #include "boxblur.h"
+#include "cpufeatures.h"
 #include "opthelper.h"
 #include "rt_math.h"
 
+#ifdef RT_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
 namespace
 {
 
@@ -830,6 +836,279 @@ template<class T> void gaussVerticalSse (T** src, T** dst, const int W, const in
 }
 #endif
 
+#ifdef RT_AVX2_DISPATCH
+template<class T> TARGET_AVX2 inline __m256 gatherColumnAvx2 (T** src, const int i, const int j)
+{
+    return _mm256_set_ps(src[i][j], src[i + 1][j], src[i + 2][j], src[i + 3][j], src[i + 4][j], src[i + 5][j], src[i + 6][j], src[i + 7][j]);
+}
+
+// AVX2 variant of gaussHorizontalSse, processes 8 rows per iteration
+template<class T> TARGET_AVX2 void gaussHorizontalAvx2 (T** src, T** dst, const int W, const int H, const float sigma)
+{
+    double b1, b2, b3, B, M[3][3];
+    calculateYvVFactors<double>(sigma, b1, b2, b3, B, M);
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            M[i][j] *= (1.0 + b2 + (b1 - b3) * b3);
+            M[i][j] /= (1.0 + b1 - b2 + b3) * (1.0 - b1 - b2 - b3);
+        }
+
+    __m256 Rv;
+    __m256 Tv, Tm2v, Tm3v;
+    __m256 temp2W, temp2Wp1;
+    // twice the size of the SSE buffer, too large for the stacks of the worker threads
+    AlignedBuffer<float> tmpBuffer(W * 8, 64);
+    float (*tmp)[8] = reinterpret_cast<float (*)[8]>(tmpBuffer.data);
+    const __m256 Bv = _mm256_set1_ps(B);
+    const __m256 b1v = _mm256_set1_ps(b1);
+    const __m256 b2v = _mm256_set1_ps(b2);
+    const __m256 b3v = _mm256_set1_ps(b3);
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int i = 0; i < H - 7; i += 8) {
+        Tv = gatherColumnAvx2(src, i, 0);
+        Tm3v = Tv * (Bv + b1v + b2v + b3v);
+        _mm256_store_ps(&tmp[0][0], Tm3v);
+
+        Tm2v = gatherColumnAvx2(src, i, 1) * Bv + Tm3v * b1v + Tv * (b2v + b3v);
+        _mm256_store_ps(&tmp[1][0], Tm2v);
+
+        Rv = gatherColumnAvx2(src, i, 2) * Bv + Tm2v * b1v + Tm3v * b2v + Tv * b3v;
+        _mm256_store_ps(&tmp[2][0], Rv);
+
+        for (int j = 3; j < W; j++) {
+            Tv = Rv;
+            Rv = gatherColumnAvx2(src, i, j) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            _mm256_store_ps(&tmp[j][0], Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+
+        Tv = gatherColumnAvx2(src, i, W - 1);
+
+        temp2Wp1 = Tv + _mm256_set1_ps(M[2][0]) * (Rv - Tv) + _mm256_set1_ps(M[2][1]) * (Tm2v - Tv) + _mm256_set1_ps(M[2][2]) * (Tm3v - Tv);
+        temp2W = Tv + _mm256_set1_ps(M[1][0]) * (Rv - Tv) + _mm256_set1_ps(M[1][1]) * (Tm2v - Tv) + _mm256_set1_ps(M[1][2]) * (Tm3v - Tv);
+
+        Rv = Tv + _mm256_set1_ps(M[0][0]) * (Rv - Tv) + _mm256_set1_ps(M[0][1]) * (Tm2v - Tv) + _mm256_set1_ps(M[0][2]) * (Tm3v - Tv);
+        _mm256_store_ps(&tmp[W - 1][0], Rv);
+
+        Tm2v = Bv * Tm2v + b1v * Rv + b2v * temp2W + b3v * temp2Wp1;
+        _mm256_store_ps(&tmp[W - 2][0], Tm2v);
+
+        Tm3v = Bv * Tm3v + b1v * Tm2v + b2v * Rv + b3v * temp2W;
+        _mm256_store_ps(&tmp[W - 3][0], Tm3v);
+
+        Tv = Rv;
+        Rv = Tm3v;
+        Tm3v = Tv;
+
+        for (int j = W - 4; j >= 0; j--) {
+            Tv = Rv;
+            Rv = _mm256_load_ps(&tmp[j][0]) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            _mm256_store_ps(&tmp[j][0], Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+
+        for (int j = 0; j < W; j++) {
+            dst[i + 7][j] = tmp[j][0];
+            dst[i + 6][j] = tmp[j][1];
+            dst[i + 5][j] = tmp[j][2];
+            dst[i + 4][j] = tmp[j][3];
+            dst[i + 3][j] = tmp[j][4];
+            dst[i + 2][j] = tmp[j][5];
+            dst[i + 1][j] = tmp[j][6];
+            dst[i + 0][j] = tmp[j][7];
+        }
+    }
+
+// Borders are done without SIMD
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+
+    for (int i = H - (H % 8); i < H; i++) {
+        tmp[0][0] = src[i][0] * (B + b1 + b2 + b3);
+        tmp[1][0] = B * src[i][1] + b1 * tmp[0][0]  + src[i][0] * (b2 + b3);
+        tmp[2][0] = B * src[i][2] + b1 * tmp[1][0]  + b2 * tmp[0][0]  + b3 * src[i][0];
+
+        for (int j = 3; j < W; j++) {
+            tmp[j][0] = B * src[i][j] + b1 * tmp[j - 1][0] + b2 * tmp[j - 2][0] + b3 * tmp[j - 3][0];
+        }
+
+        float temp2Wm1 = src[i][W - 1] + M[0][0] * (tmp[W - 1][0] - src[i][W - 1]) + M[0][1] * (tmp[W - 2][0] - src[i][W - 1]) + M[0][2] * (tmp[W - 3][0] - src[i][W - 1]);
+        float temp2W   = src[i][W - 1] + M[1][0] * (tmp[W - 1][0] - src[i][W - 1]) + M[1][1] * (tmp[W - 2][0] - src[i][W - 1]) + M[1][2] * (tmp[W - 3][0] - src[i][W - 1]);
+        float temp2Wp1 = src[i][W - 1] + M[2][0] * (tmp[W - 1][0] - src[i][W - 1]) + M[2][1] * (tmp[W - 2][0] - src[i][W - 1]) + M[2][2] * (tmp[W - 3][0] - src[i][W - 1]);
+
+        tmp[W - 1][0] = temp2Wm1;
+        tmp[W - 2][0] = B * tmp[W - 2][0] + b1 * tmp[W - 1][0] + b2 * temp2W + b3 * temp2Wp1;
+        tmp[W - 3][0] = B * tmp[W - 3][0] + b1 * tmp[W - 2][0] + b2 * tmp[W - 1][0] + b3 * temp2W;
+
+        for (int j = W - 4; j >= 0; j--) {
+            tmp[j][0] = B * tmp[j][0] + b1 * tmp[j + 1][0] + b2 * tmp[j + 2][0] + b3 * tmp[j + 3][0];
+        }
+
+        for (int j = 0; j < W; j++) {
+            dst[i][j] = tmp[j][0];
+        }
+    }
+}
+
+// AVX2 variant of gaussVerticalSse, processes 16 columns per iteration
+template<class T> TARGET_AVX2 void gaussVerticalAvx2 (T** src, T** dst, const int W, const int H, const float sigma)
+{
+    double b1, b2, b3, B, M[3][3];
+    calculateYvVFactors<double>(sigma, b1, b2, b3, B, M);
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            M[i][j] *= (1.0 + b2 + (b1 - b3) * b3);
+            M[i][j] /= (1.0 + b1 - b2 + b3) * (1.0 - b1 - b2 - b3);
+        }
+
+    // too large for the stacks of the worker threads
+    AlignedBuffer<float> tmpBuffer(H * 16, 64);
+    float (*tmp)[16] = reinterpret_cast<float (*)[16]>(tmpBuffer.data);
+    __m256 Rv;
+    __m256 Tv, Tm2v, Tm3v;
+    __m256 Rv1;
+    __m256 Tv1, Tm2v1, Tm3v1;
+    __m256 temp2W, temp2Wp1;
+    __m256 temp2W1, temp2Wp11;
+    const __m256 Bv = _mm256_set1_ps(B);
+    const __m256 b1v = _mm256_set1_ps(b1);
+    const __m256 b2v = _mm256_set1_ps(b2);
+    const __m256 b3v = _mm256_set1_ps(b3);
+    const __m256 M00v = _mm256_set1_ps(M[0][0]);
+    const __m256 M01v = _mm256_set1_ps(M[0][1]);
+    const __m256 M02v = _mm256_set1_ps(M[0][2]);
+    const __m256 M10v = _mm256_set1_ps(M[1][0]);
+    const __m256 M11v = _mm256_set1_ps(M[1][1]);
+    const __m256 M12v = _mm256_set1_ps(M[1][2]);
+    const __m256 M20v = _mm256_set1_ps(M[2][0]);
+    const __m256 M21v = _mm256_set1_ps(M[2][1]);
+    const __m256 M22v = _mm256_set1_ps(M[2][2]);
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int i = 0; i < W - 15; i += 16) {
+        Tv = _mm256_loadu_ps(&src[0][i]);
+        Tv1 = _mm256_loadu_ps(&src[0][i + 8]);
+        Rv = Tv * (Bv + b1v + b2v + b3v);
+        Rv1 = Tv1 * (Bv + b1v + b2v + b3v);
+        Tm3v = Rv;
+        Tm3v1 = Rv1;
+        _mm256_store_ps(&tmp[0][0], Rv);
+        _mm256_store_ps(&tmp[0][8], Rv1);
+
+        Rv = _mm256_loadu_ps(&src[1][i]) * Bv + Rv * b1v + Tv * (b2v + b3v);
+        Rv1 = _mm256_loadu_ps(&src[1][i + 8]) * Bv + Rv1 * b1v + Tv1 * (b2v + b3v);
+        Tm2v = Rv;
+        Tm2v1 = Rv1;
+        _mm256_store_ps(&tmp[1][0], Rv);
+        _mm256_store_ps(&tmp[1][8], Rv1);
+
+        Rv = _mm256_loadu_ps(&src[2][i]) * Bv + Rv * b1v + Tm3v * b2v + Tv * b3v;
+        Rv1 = _mm256_loadu_ps(&src[2][i + 8]) * Bv + Rv1 * b1v + Tm3v1 * b2v + Tv1 * b3v;
+        _mm256_store_ps(&tmp[2][0], Rv);
+        _mm256_store_ps(&tmp[2][8], Rv1);
+
+        for (int j = 3; j < H; j++) {
+            Tv = Rv;
+            Tv1 = Rv1;
+            Rv = _mm256_loadu_ps(&src[j][i]) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            Rv1 = _mm256_loadu_ps(&src[j][i + 8]) * Bv + Tv1 * b1v + Tm2v1 * b2v + Tm3v1 * b3v;
+            _mm256_store_ps(&tmp[j][0], Rv);
+            _mm256_store_ps(&tmp[j][8], Rv1);
+            Tm3v = Tm2v;
+            Tm3v1 = Tm2v1;
+            Tm2v = Tv;
+            Tm2v1 = Tv1;
+        }
+
+        Tv = _mm256_loadu_ps(&src[H - 1][i]);
+        Tv1 = _mm256_loadu_ps(&src[H - 1][i + 8]);
+
+        temp2Wp1 = Tv + M20v * (Rv - Tv) + M21v * (Tm2v - Tv) + M22v * (Tm3v - Tv);
+        temp2Wp11 = Tv1 + M20v * (Rv1 - Tv1) + M21v * (Tm2v1 - Tv1) + M22v * (Tm3v1 - Tv1);
+        temp2W = Tv + M10v * (Rv - Tv) + M11v * (Tm2v - Tv) + M12v * (Tm3v - Tv);
+        temp2W1 = Tv1 + M10v * (Rv1 - Tv1) + M11v * (Tm2v1 - Tv1) + M12v * (Tm3v1 - Tv1);
+
+        Rv = Tv + M00v * (Rv - Tv) + M01v * (Tm2v - Tv) + M02v * (Tm3v - Tv);
+        Rv1 = Tv1 + M00v * (Rv1 - Tv1) + M01v * (Tm2v1 - Tv1) + M02v * (Tm3v1 - Tv1);
+        _mm256_storeu_ps(&dst[H - 1][i], Rv);
+        _mm256_storeu_ps(&dst[H - 1][i + 8], Rv1);
+
+        Tm2v = Bv * Tm2v + b1v * Rv + b2v * temp2W + b3v * temp2Wp1;
+        Tm2v1 = Bv * Tm2v1 + b1v * Rv1 + b2v * temp2W1 + b3v * temp2Wp11;
+        _mm256_storeu_ps(&dst[H - 2][i], Tm2v);
+        _mm256_storeu_ps(&dst[H - 2][i + 8], Tm2v1);
+
+        Tm3v = Bv * Tm3v + b1v * Tm2v + b2v * Rv + b3v * temp2W;
+        Tm3v1 = Bv * Tm3v1 + b1v * Tm2v1 + b2v * Rv1 + b3v * temp2W1;
+        _mm256_storeu_ps(&dst[H - 3][i], Tm3v);
+        _mm256_storeu_ps(&dst[H - 3][i + 8], Tm3v1);
+
+        Tv = Rv;
+        Tv1 = Rv1;
+        Rv = Tm3v;
+        Rv1 = Tm3v1;
+        Tm3v = Tv;
+        Tm3v1 = Tv1;
+
+        for (int j = H - 4; j >= 0; j--) {
+            Tv = Rv;
+            Tv1 = Rv1;
+            Rv = _mm256_load_ps(&tmp[j][0]) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            Rv1 = _mm256_load_ps(&tmp[j][8]) * Bv + Tv1 * b1v + Tm2v1 * b2v + Tm3v1 * b3v;
+            _mm256_storeu_ps(&dst[j][i], Rv);
+            _mm256_storeu_ps(&dst[j][i + 8], Rv1);
+            Tm3v = Tm2v;
+            Tm3v1 = Tm2v1;
+            Tm2v = Tv;
+            Tm2v1 = Tv1;
+        }
+    }
+
+// Borders are done without SIMD
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+
+    for (int i = W - (W % 16); i < W; i++) {
+        tmp[0][0] = src[0][i] * (B + b1 + b2 + b3);
+        tmp[1][0] = B * src[1][i] + b1 * tmp[0][0] + src[0][i] * (b2 + b3);
+        tmp[2][0] = B * src[2][i] + b1 * tmp[1][0] + b2 * tmp[0][0] + b3 * src[0][i];
+
+        for (int j = 3; j < H; j++) {
+            tmp[j][0] = B * src[j][i] + b1 * tmp[j - 1][0] + b2 * tmp[j - 2][0] + b3 * tmp[j - 3][0];
+        }
+
+        float temp2Hm1 = src[H - 1][i] + M[0][0] * (tmp[H - 1][0] - src[H - 1][i]) + M[0][1] * (tmp[H - 2][0] - src[H - 1][i]) + M[0][2] * (tmp[H - 3][0] - src[H - 1][i]);
+        float temp2H   = src[H - 1][i] + M[1][0] * (tmp[H - 1][0] - src[H - 1][i]) + M[1][1] * (tmp[H - 2][0] - src[H - 1][i]) + M[1][2] * (tmp[H - 3][0] - src[H - 1][i]);
+        float temp2Hp1 = src[H - 1][i] + M[2][0] * (tmp[H - 1][0] - src[H - 1][i]) + M[2][1] * (tmp[H - 2][0] - src[H - 1][i]) + M[2][2] * (tmp[H - 3][0] - src[H - 1][i]);
+
+        tmp[H - 1][0] = temp2Hm1;
+        tmp[H - 2][0] = B * tmp[H - 2][0] + b1 * tmp[H - 1][0] + b2 * temp2H + b3 * temp2Hp1;
+        tmp[H - 3][0] = B * tmp[H - 3][0] + b1 * tmp[H - 2][0] + b2 * tmp[H - 1][0] + b3 * temp2H;
+
+        for (int j = H - 4; j >= 0; j--) {
+            tmp[j][0] = B * tmp[j][0] + b1 * tmp[j + 1][0] + b2 * tmp[j + 2][0] + b3 * tmp[j + 3][0];
+        }
+
+        for (int j = 0; j < H; j++) {
+            dst[j][i] = tmp[j][0];
+        }
+    }
+}
+#endif
+
 #ifdef __SSE2__
 template<class T> void gaussVerticalSsemult (T** RESTRICT src, T** RESTRICT dst, const int W, const int H, const float sigma)
 {
@@ -1455,6 +1734,9 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
             }
         } else {
 #ifdef __SSE2__
+#ifdef RT_AVX2_DISPATCH
+            const bool useAvx2 = rtengine::cpuHasAVX2();
+#endif
 
             if (sigma < GAUSS_DOUBLE) {
                 switch (gausstype) {
@@ -1464,7 +1746,14 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
                     } else if (sigma <= GAUSS_7X7_LIMIT && src != dst) {
                         gauss7x7mult(src, dst, W, H, sigma);
                     } else {
-                        gaussHorizontalSse<T> (src, src, W, H, sigma);
+#ifdef RT_AVX2_DISPATCH
+                        if (useAvx2) {
+                            gaussHorizontalAvx2<T> (src, src, W, H, sigma);
+                        } else
+#endif
+                        {
+                            gaussHorizontalSse<T> (src, src, W, H, sigma);
+                        }
                         gaussVerticalSsemult<T> (src, dst, W, H, sigma);
                     }
                     break;
@@ -1476,13 +1765,27 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
                     } else if (sigma <= GAUSS_7X7_LIMIT && src != dst) {
                         gauss7x7div (src, dst, buffer2, W, H, sigma);
                     } else {
-                        gaussHorizontalSse<T> (src, dst, W, H, sigma);
+#ifdef RT_AVX2_DISPATCH
+                        if (useAvx2) {
+                            gaussHorizontalAvx2<T> (src, dst, W, H, sigma);
+                        } else
+#endif
+                        {
+                            gaussHorizontalSse<T> (src, dst, W, H, sigma);
+                        }
                         gaussVerticalSsediv<T> (dst, dst, buffer2, W, H, sigma);
                     }
                     break;
                 }
 
                 case GAUSS_STANDARD : {
+#ifdef RT_AVX2_DISPATCH
+                    if (useAvx2) {
+                        gaussHorizontalAvx2<T> (src, dst, W, H, sigma);
+                        gaussVerticalAvx2<T> (dst, dst, W, H, sigma);
+                        break;
+                    }
+#endif
                     gaussHorizontalSse<T> (src, dst, W, H, sigma);
                     gaussVerticalSse<T> (dst, dst, W, H, sigma);
                     break;
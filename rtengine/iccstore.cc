@@ -17,6 +17,7 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <cstring>
+#include <tuple>
 
 #include <glibmm/ustring.h>
 #include <glibmm/fileutils.h>
@@ -40,7 +41,9 @@
 #include "../rtgui/threadutils.h"
 #include "lcms2_plugin.h"
 
+#include "cache.h"
 #include "color.h"
+#include "rtengine.h"
 
 #include "cJSON.h"
 
@@ -288,6 +291,84 @@ Glib::ustring get_profile_description(cmsHPROFILE profile)
     return std::string(&buf[0]);
 }
 
+// Number of transforms kept by the store, the least recently used ones are deleted first
+constexpr unsigned long TRANSFORM_CACHE_SIZE = 32;
+
+// The tone curves are tabulated on [TONE_CURVE_TABLE_MIN, 1]. The steep start of the inverse gamma
+// curves, where linear interpolation would be too coarse, and the out of range values are left to lcms.
+constexpr int TONE_CURVE_TABLE_SIZE = 65536;
+constexpr float TONE_CURVE_TABLE_MIN = 1.f / 1024.f;
+
+class ToneCurveTable final :
+    public rtengine::NonCopyable
+{
+public:
+    // Takes ownership of curve
+    explicit ToneCurveTable(cmsToneCurve* curve) :
+        curve(curve),
+        table(TONE_CURVE_TABLE_SIZE)
+    {
+        for (int i = 0; i < TONE_CURVE_TABLE_SIZE; ++i) {
+            table[i] = cmsEvalToneCurveFloat(curve, static_cast<float>(i) / (TONE_CURVE_TABLE_SIZE - 1));
+        }
+    }
+
+    ~ToneCurveTable()
+    {
+        cmsFreeToneCurve(curve);
+    }
+
+    float operator ()(float x) const
+    {
+        if (x >= TONE_CURVE_TABLE_MIN && x <= 1.f) {
+            const float position = x * (TONE_CURVE_TABLE_SIZE - 1);
+            const int index = std::min(static_cast<int>(position), TONE_CURVE_TABLE_SIZE - 2);
+            const float weight = position - index;
+            return table[index] + weight * (table[index + 1] - table[index]);
+        }
+
+        return cmsEvalToneCurveFloat(curve, x);
+    }
+
+private:
+    cmsToneCurve* const curve;
+    std::vector<float> table;
+};
+
+struct TransformKey {
+    cmsHPROFILE input;
+    cmsUInt32Number inputFormat;
+    cmsHPROFILE output;
+    cmsUInt32Number outputFormat;
+    cmsHPROFILE proofing;
+    cmsUInt32Number intent;
+    cmsUInt32Number proofingIntent;
+    cmsUInt32Number flags;
+
+    bool operator <(const TransformKey& other) const
+    {
+        return
+            std::tie(input, inputFormat, output, outputFormat, proofing, intent, proofingIntent, flags)
+            < std::tie(other.input, other.inputFormat, other.output, other.outputFormat, other.proofing, other.intent, other.proofingIntent, other.flags);
+    }
+};
+
+// Replaces the tone curve of the tag by a 16 bit table, so soft-proofing clips to the gamut of the profile
+void makeGammaTable(cmsHPROFILE profile, cmsTagSignature tag)
+{
+    cmsToneCurve* const tc = static_cast<cmsToneCurve*>(cmsReadTag(profile, tag));
+
+    if (tc) {
+        const cmsUInt16Number* const table = cmsGetToneCurveEstimatedTable(tc);
+        cmsToneCurve* const tc16 = cmsBuildTabulatedToneCurve16(nullptr, cmsGetToneCurveEstimatedTableEntries(tc), table);
+
+        if (tc16) {
+            cmsWriteTag(profile, tag, tc16);
+            cmsFreeToneCurve(tc16);
+        }
+    }
+}
+
 } // namespace
 
 
@@ -389,13 +470,223 @@ const std::string& rtengine::ProfileContent::getData() const
     return data;
 }
 
+// Conversion from L*a*b* D50 to a matrix-shaper RGB profile with relative colorimetric intent, done
+// like lcms does it: L*a*b* to XYZ, 3x3 matrix to linear RGB and the inverted tone curves of the profile
+class rtengine::ColorTransform::MatrixShaper final :
+    public NonCopyable
+{
+public:
+    static std::unique_ptr<const MatrixShaper> create(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsHPROFILE output, cmsUInt32Number outputFormat, cmsUInt32Number intent, cmsUInt32Number flags)
+    {
+        // Black point compensation is implied by lcms for the other intents of the L*a*b* v4 profile
+        if (
+            input
+            || (inputFormat != TYPE_Lab_FLT && inputFormat != TYPE_Lab_DBL)
+            || outputFormat != TYPE_RGB_FLT
+            || intent != INTENT_RELATIVE_COLORIMETRIC
+            || (flags & (cmsFLAGS_BLACKPOINTCOMPENSATION | cmsFLAGS_GAMUTCHECK | cmsFLAGS_SOFTPROOFING | cmsFLAGS_NULLTRANSFORM))
+            || cmsGetColorSpace(output) != cmsSigRgbData
+            || !cmsIsMatrixShaper(output)
+            || cmsIsCLUT(output, intent, LCMS_USED_AS_OUTPUT)
+        ) {
+            return nullptr;
+        }
+
+        const cmsCIEXYZ* const red = static_cast<const cmsCIEXYZ*>(cmsReadTag(output, cmsSigRedColorantTag));
+        const cmsCIEXYZ* const green = static_cast<const cmsCIEXYZ*>(cmsReadTag(output, cmsSigGreenColorantTag));
+        const cmsCIEXYZ* const blue = static_cast<const cmsCIEXYZ*>(cmsReadTag(output, cmsSigBlueColorantTag));
+
+        if (!red || !green || !blue) {
+            return nullptr;
+        }
+
+        const std::array<std::array<double, 3>, 3> rgbToXyz = {{
+            {red->X, green->X, blue->X},
+            {red->Y, green->Y, blue->Y},
+            {red->Z, green->Z, blue->Z}
+        }};
+        std::array<std::array<double, 3>, 3> xyzToRgb;
+
+        if (!invertMatrix(rgbToXyz, xyzToRgb)) {
+            return nullptr;
+        }
+
+        const cmsTagSignature trcTags[3] = {cmsSigRedTRCTag, cmsSigGreenTRCTag, cmsSigBlueTRCTag};
+        std::unique_ptr<MatrixShaper> result(new MatrixShaper(inputFormat));
+
+        for (int c = 0; c < 3; ++c) {
+            const cmsToneCurve* const trc = static_cast<const cmsToneCurve*>(cmsReadTag(output, trcTags[c]));
+            cmsToneCurve* const inverse = trc ? cmsReverseToneCurve(trc) : nullptr;
+
+            if (!inverse) {
+                return nullptr;
+            }
+
+            result->curves[c].reset(new ToneCurveTable(inverse));
+        }
+
+        // The D50 white of the L*a*b* to XYZ conversion is folded into the matrix
+        const cmsCIEXYZ* const d50 = cmsD50_XYZ();
+        const double white[3] = {d50->X, d50->Y, d50->Z};
+
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                result->matrix[i][j] = xyzToRgb[i][j] * white[j];
+            }
+        }
+
+        return std::unique_ptr<const MatrixShaper>(result.release());
+    }
+
+    void transform(const void* in, void* out, cmsUInt32Number count) const
+    {
+        float* const rgb = static_cast<float*>(out);
+
+        if (inputFormat == TYPE_Lab_DBL) {
+            toLinear(static_cast<const double*>(in), rgb, count);
+        } else {
+            toLinear(static_cast<const float*>(in), rgb, count);
+        }
+
+        for (cmsUInt32Number i = 0; i < 3 * count; i += 3) {
+            rgb[i] = (*curves[0])(rgb[i]);
+            rgb[i + 1] = (*curves[1])(rgb[i + 1]);
+            rgb[i + 2] = (*curves[2])(rgb[i + 2]);
+        }
+    }
+
+private:
+    explicit MatrixShaper(cmsUInt32Number inputFormat) :
+        inputFormat(inputFormat)
+    {
+    }
+
+    // Inverse of the cube root of the L*a*b* definition
+    static float fInverse(float t)
+    {
+        return t > 24.f / 116.f ? t * t * t : 108.f / 841.f * (t - 16.f / 116.f);
+    }
+
+    // Linear RGB from L*a*b*, in and out may overlap when T is float
+    template<typename T>
+    void toLinear(const T* in, float* out, cmsUInt32Number count) const
+    {
+        cmsUInt32Number i = 0;
+
+#ifdef __SSE2__
+        const vfloat c116v = F2V(1.f / 116.f);
+        const vfloat c16v = F2V(16.f);
+        const vfloat c500v = F2V(1.f / 500.f);
+        const vfloat c200v = F2V(1.f / 200.f);
+        const vfloat limitv = F2V(24.f / 116.f);
+        const vfloat slopev = F2V(108.f / 841.f);
+        const vfloat offsetv = F2V(16.f / 116.f);
+        vfloat matrixv[3][3];
+
+        for (int k = 0; k < 3; ++k) {
+            for (int l = 0; l < 3; ++l) {
+                matrixv[k][l] = F2V(matrix[k][l]);
+            }
+        }
+
+        for (; i + 3 < count; i += 4) {
+            const T* const p = in + 3 * i;
+            const vfloat Lv = _mm_setr_ps(p[0], p[3], p[6], p[9]);
+            const vfloat av = _mm_setr_ps(p[1], p[4], p[7], p[10]);
+            const vfloat bv = _mm_setr_ps(p[2], p[5], p[8], p[11]);
+
+            vfloat fy = (Lv + c16v) * c116v;
+            vfloat fx = fy + av * c500v;
+            vfloat fz = fy - bv * c200v;
+            fx = vself(vmaskf_gt(fx, limitv), fx * fx * fx, slopev * (fx - offsetv));
+            fy = vself(vmaskf_gt(fy, limitv), fy * fy * fy, slopev * (fy - offsetv));
+            fz = vself(vmaskf_gt(fz, limitv), fz * fz * fz, slopev * (fz - offsetv));
+
+            float rgb[3][4] ALIGNED16;
+
+            for (int k = 0; k < 3; ++k) {
+                STVF(rgb[k][0], matrixv[k][0] * fx + matrixv[k][1] * fy + matrixv[k][2] * fz);
+            }
+
+            float* const q = out + 3 * i;
+
+            for (int l = 0; l < 4; ++l) {
+                q[3 * l] = rgb[0][l];
+                q[3 * l + 1] = rgb[1][l];
+                q[3 * l + 2] = rgb[2][l];
+            }
+        }
+
+#endif
+
+        for (; i < count; ++i) {
+            const float fy = (static_cast<float>(in[3 * i]) + 16.f) / 116.f;
+            const float fx = fInverse(fy + static_cast<float>(in[3 * i + 1]) / 500.f);
+            const float fz = fInverse(fy - static_cast<float>(in[3 * i + 2]) / 200.f);
+            const float y = fInverse(fy);
+
+            for (int k = 0; k < 3; ++k) {
+                out[3 * i + k] = matrix[k][0] * fx + matrix[k][1] * y + matrix[k][2] * fz;
+            }
+        }
+    }
+
+    const cmsUInt32Number inputFormat;
+    float matrix[3][3];
+    std::unique_ptr<const ToneCurveTable> curves[3];
+};
+
+rtengine::ColorTransform::ColorTransform(cmsHTRANSFORM transform) :
+    lcmsTransform(transform)
+{
+}
+
+rtengine::ColorTransform::ColorTransform(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsHPROFILE output, cmsUInt32Number outputFormat, cmsUInt32Number intent, cmsUInt32Number flags) :
+    lcmsTransform(nullptr),
+    matrixShaper(MatrixShaper::create(input, inputFormat, output, outputFormat, intent, flags))
+{
+    if (matrixShaper) {
+        return;
+    }
+
+    if (input) {
+        lcmsTransform = cmsCreateTransform(input, inputFormat, output, outputFormat, intent, flags);
+    } else {
+        const cmsHPROFILE lab = cmsCreateLab4Profile(nullptr);
+        lcmsTransform = cmsCreateTransform(lab, inputFormat, output, outputFormat, intent, flags);
+        cmsCloseProfile(lab);
+    }
+}
+
+rtengine::ColorTransform::~ColorTransform()
+{
+    if (lcmsTransform) {
+        cmsDeleteTransform(lcmsTransform);
+    }
+}
+
+bool rtengine::ColorTransform::isValid() const
+{
+    return lcmsTransform || matrixShaper;
+}
+
+void rtengine::ColorTransform::transform(const void* in, void* out, cmsUInt32Number count) const
+{
+    if (matrixShaper) {
+        matrixShaper->transform(in, out, count);
+    } else {
+        cmsDoTransform(lcmsTransform, in, out, count);
+    }
+}
+
 class rtengine::ICCStore::Implementation
 {
 public:
     Implementation() :
         loadAll(true),
         xyz(createXYZProfile()),
-        srgb(cmsCreate_sRGBProfile())
+        srgb(cmsCreate_sRGBProfile()),
+        transforms(TRANSFORM_CACHE_SIZE)
     {
         //cmsErrorAction(LCMS_ERROR_SHOW);
 
@@ -451,6 +742,11 @@ public:
         fileProfiles.clear();
         fileProfileContents.clear();
 
+        {
+            MyMutex::MyLock transformLock(transformMutex);
+            transforms.clear();
+        }
+
         if (loadAll) {
             loadProfiles(profilesDir, &fileProfiles, &fileProfileContents, nullptr, false);
             loadProfiles(userICCDir, &fileProfiles, &fileProfileContents, nullptr, false);
@@ -739,6 +1035,59 @@ public:
         return res;
     }
 
+    std::shared_ptr<const ColorTransform> getTransform(const TransformKey& key)
+    {
+        MyMutex::MyLock lock(transformMutex);
+
+        std::shared_ptr<const ColorTransform> transform;
+
+        if (transforms.get(key, transform)) {
+            return transform;
+        }
+
+        {
+            MyMutex::MyLock lcmsLock(*lcmsMutex);
+
+            if (key.proofing) {
+                cmsHPROFILE softproof = ProfileContent(key.proofing).toProfile();
+
+                if (softproof) {
+                    makeGammaTable(softproof, cmsSigRedTRCTag);
+                    makeGammaTable(softproof, cmsSigGreenTRCTag);
+                    makeGammaTable(softproof, cmsSigBlueTRCTag);
+                }
+
+                const cmsHPROFILE lab = cmsCreateLab4Profile(nullptr);
+                const cmsHTRANSFORM proofingTransform = cmsCreateProofingTransform(
+                    lab, key.inputFormat,
+                    key.output, key.outputFormat,
+                    softproof,
+                    key.intent, key.proofingIntent,
+                    key.flags
+                );
+                cmsCloseProfile(lab);
+
+                if (softproof) {
+                    cmsCloseProfile(softproof);
+                }
+
+                if (proofingTransform) {
+                    transform = std::make_shared<const ColorTransform>(proofingTransform);
+                }
+            } else {
+                transform = std::make_shared<const ColorTransform>(key.input, key.inputFormat, key.output, key.outputFormat, key.intent, key.flags);
+            }
+        }
+
+        if (!transform || !transform->isValid()) {
+            return nullptr;
+        }
+
+        transforms.set(key, transform);
+
+        return transform;
+    }
+
 private:
     using CVector = std::array<double, 3>;
     using CMatrix = std::array<CVector, 3>;
@@ -1024,6 +1373,10 @@ parse_error:
     const cmsHPROFILE srgb;
 
     mutable MyMutex mutex;
+
+    // Keys hold the profile handles of the store, so the transforms are dropped when init() drops the profiles
+    MyMutex transformMutex;
+    rtengine::Cache<TransformKey, std::shared_ptr<const ColorTransform>> transforms;
 };
 
 rtengine::ICCStore* rtengine::ICCStore::getInstance()
@@ -1151,6 +1504,16 @@ std::vector<Glib::ustring> rtengine::ICCStore::getWorkingProfiles()
     return implementation->getWorkingProfiles();
 }
 
+std::shared_ptr<const rtengine::ColorTransform> rtengine::ICCStore::getTransform(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsHPROFILE output, cmsUInt32Number outputFormat, cmsUInt32Number intent, cmsUInt32Number flags)
+{
+    return implementation->getTransform({input, inputFormat, output, outputFormat, nullptr, intent, 0, flags});
+}
+
+std::shared_ptr<const rtengine::ColorTransform> rtengine::ICCStore::getProofingTransform(cmsHPROFILE output, cmsHPROFILE proofing, cmsUInt32Number intent, cmsUInt32Number proofingIntent, cmsUInt32Number flags)
+{
+    return implementation->getTransform({nullptr, TYPE_Lab_FLT, output, TYPE_RGB_FLT, proofing, intent, proofingIntent, flags});
+}
+
 cmsHPROFILE rtengine::ICCStore::createFromMatrix(const double matrix[3][3], bool gamma, const Glib::ustring& name)
 {
 
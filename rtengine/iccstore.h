@@ -27,6 +27,8 @@
 
 #include <lcms2.h>
 
+#include "noncopyable.h"
+
 namespace rtengine
 {
 
@@ -54,6 +56,35 @@ private:
     std::string data;
 };
 
+/**
+ * A color transform, either a wrapped lcms transform or, between matrix-shaper profiles, a 3x3
+ * matrix and tone curve tables giving the same result as lcms without going through its pipeline.
+ *
+ * The lcms transforms are created with cmsFLAGS_NOCACHE, so transform() can be called from several
+ * threads at once.
+ */
+class ColorTransform final :
+    public NonCopyable
+{
+public:
+    /** Takes ownership of transform. */
+    explicit ColorTransform(cmsHTRANSFORM transform);
+    /** Same as cmsCreateTransform(), except that a nullptr input stands for L*a*b* D50. Check with isValid(). */
+    ColorTransform(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsHPROFILE output, cmsUInt32Number outputFormat, cmsUInt32Number intent, cmsUInt32Number flags);
+    ~ColorTransform();
+
+    bool isValid() const;
+
+    /** Same as cmsDoTransform(). in and out may be the same buffer. */
+    void transform(const void* in, void* out, cmsUInt32Number count) const;
+
+private:
+    class MatrixShaper;
+
+    cmsHTRANSFORM lcmsTransform;
+    std::unique_ptr<const MatrixShaper> matrixShaper;
+};
+
 class ICCStore final
 {
 public:
@@ -98,6 +129,15 @@ public:
 
     static cmsHPROFILE createFromMatrix(const double matrix[3][3], bool gamma = false, const Glib::ustring& name = Glib::ustring());
 
+    /**
+     * Returns a transform between profiles of the store, a nullptr input standing for L*a*b* D50, or nullptr
+     * on failure. The transforms are kept by profiles, formats, intent and flags, so flags must contain
+     * cmsFLAGS_NOCACHE for them to be shared between threads.
+     */
+    std::shared_ptr<const ColorTransform> getTransform(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsHPROFILE output, cmsUInt32Number outputFormat, cmsUInt32Number intent, cmsUInt32Number flags);
+    /** Returns a soft-proofing transform from L*a*b* D50 (TYPE_Lab_FLT) to output (TYPE_RGB_FLT) through proofing, or nullptr on failure. */
+    std::shared_ptr<const ColorTransform> getProofingTransform(cmsHPROFILE output, cmsHPROFILE proofing, cmsUInt32Number intent, cmsUInt32Number proofingIntent, cmsUInt32Number flags);
+
 private:
     class Implementation;
 
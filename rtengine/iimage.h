@@ -98,8 +98,8 @@ public:
 
     // Read the raw dump of the data
     void readData  (FILE *fh) {}
-    // Write a raw dump of the data
-    void writeData (FILE *fh) const {}
+    // Write a raw dump of the data, returns false if it couldn't be written entirely
+    bool writeData (FILE *fh) const { return true; }
 
     virtual void normalizeInt (int srcMinVal, int srcMaxVal) {};
     virtual void normalizeFloat (float srcMinVal, float srcMaxVal) {};
@@ -586,11 +586,15 @@ public:
         }
     }
 
-    void writeData (FILE *f) const
+    bool writeData (FILE *f) const
     {
         for (int i = 0; i < height; i++) {
-            fwrite (v(i), sizeof(T), width, f);
+            if (fwrite (v(i), sizeof(T), width, f) != static_cast<size_t>(width)) {
+                return false;
+            }
         }
+
+        return true;
     }
 
     void fill (T value) {
@@ -1195,19 +1199,27 @@ public:
         }
     }
 
-    void writeData (FILE *f) const
+    bool writeData (FILE *f) const
     {
         for (int i = 0; i < height; i++) {
-            fwrite (r(i), sizeof(T), width, f);
+            if (fwrite (r(i), sizeof(T), width, f) != static_cast<size_t>(width)) {
+                return false;
+            }
         }
 
         for (int i = 0; i < height; i++) {
-            fwrite (g(i), sizeof(T), width, f);
+            if (fwrite (g(i), sizeof(T), width, f) != static_cast<size_t>(width)) {
+                return false;
+            }
         }
 
         for (int i = 0; i < height; i++) {
-            fwrite (b(i), sizeof(T), width, f);
+            if (fwrite (b(i), sizeof(T), width, f) != static_cast<size_t>(width)) {
+                return false;
+            }
         }
+
+        return true;
     }
 
 };
@@ -1787,11 +1799,15 @@ public:
         }
     }
 
-    void writeData (FILE *f) const
+    bool writeData (FILE *f) const
     {
         for (int i = 0; i < height; i++) {
-            fwrite (r(i), sizeof(T), 3 * width, f);
+            if (fwrite (r(i), sizeof(T), 3 * width, f) != static_cast<size_t>(3 * width)) {
+                return false;
+            }
         }
+
+        return true;
     }
 
 };
@@ -29,6 +29,7 @@
 #include "imagedata.h"
 #include "imagesource.h"
 #include "iptcpairs.h"
+#include "metadataprobe.h"
 #include "procparams.h"
 #include "rt_math.h"
 #include "utils.h"
@@ -131,37 +132,7 @@ FrameData::FrameData(rtexif::TagDirectory* frameRootDir_, rtexif::TagDirectory*
     }
 
     if (tag) {
-        make = validateUft8(tag->valueToString());
-
-        // Same dcraw treatment
-        for (const auto& corp : {
-        "Canon",
-        "NIKON",
-        "EPSON",
-        "KODAK",
-        "Kodak",
-        "OLYMPUS",
-        "PENTAX",
-        "RICOH",
-        "MINOLTA",
-        "Minolta",
-        "Konica",
-        "CASIO",
-        "Sinar",
-        "Phase One",
-        "SAMSUNG",
-        "Mamiya",
-        "MOTOROLA",
-        "Leaf",
-        "Panasonic"
-    }) {
-            if (make.find(corp) != std::string::npos) { // Simplify company names
-                make = corp;
-                break;
-            }
-        }
-
-        make.erase(make.find_last_not_of(' ') + 1);
+        make = simplifyMake(validateUft8(tag->valueToString()));
     }
 
     tag = newFrameRootDir->findTagUpward("Model");
@@ -170,32 +141,9 @@ FrameData::FrameData(rtexif::TagDirectory* frameRootDir_, rtexif::TagDirectory*
         model = validateUft8(tag->valueToString());
     }
 
-    if (!model.empty()) {
-        std::string::size_type i = 0;
-
-        if (
-            make.find("KODAK") != std::string::npos
-            && (
-                (i = model.find(" DIGITAL CAMERA")) != std::string::npos
-                || (i = model.find(" Digital Camera")) !=  std::string::npos
-                || (i = model.find("FILE VERSION")) !=  std::string::npos
-            )
-        ) {
-            model.resize(i);
-        }
-
-        model.erase(model.find_last_not_of(' ') + 1);
+    model = simplifyModel(make, model);
 
-        if (!strncasecmp(model.c_str(), make.c_str(), make.size())) {
-            if (model.size() >= make.size() && model[make.size()] == ' ') {
-                model.erase(0, make.size() + 1);
-            }
-        }
-
-        if (model.find("Digital Camera ") != std::string::npos) {
-            model.erase(0, 15);
-        }
-    } else {
+    if (model.empty()) {
         model = "Unknown";
     }
 
@@ -430,7 +430,7 @@ void Imagefloat::ExecCMSTransform(cmsHTRANSFORM hTransform)
 }
 
 // Parallelized transformation; create transform with cmsFLAGS_NOCACHE!
-void Imagefloat::ExecCMSTransform(cmsHTRANSFORM hTransform, const LabImage &labImage, int cx, int cy)
+void Imagefloat::ExecCMSTransform(const ColorTransform& transform, const LabImage &labImage, int cx, int cy)
 {
     // LittleCMS cannot parallelize planar Lab float images
     // so build temporary buffers to allow multi processor execution
@@ -461,7 +461,7 @@ void Imagefloat::ExecCMSTransform(cmsHTRANSFORM hTransform, const LabImage &labI
                 *(pLab++) = *(pb++)  / 327.68f;
             }
 
-            cmsDoTransform (hTransform, bufferLab.data, bufferRGB.data, width);
+            transform.transform(bufferLab.data, bufferRGB.data, width);
 
             pRGB = bufferRGB.data;
             pR = r(y - cy);
@@ -27,6 +27,7 @@ namespace rtengine
 {
 using namespace procparams;
 
+class ColorTransform;
 class Image8;
 class Image16;
 class LabImage;
@@ -210,7 +211,7 @@ public:
     void                 normalizeFloatTo1();
     void                 normalizeFloatTo65535();
     void                 ExecCMSTransform(cmsHTRANSFORM hTransform);
-    void                 ExecCMSTransform(cmsHTRANSFORM hTransform, const LabImage &labImage, int cx, int cy);
+    void                 ExecCMSTransform(const ColorTransform& transform, const LabImage &labImage, int cx, int cy);
 };
 
 }
@@ -45,6 +45,7 @@
 #include "color.h"
 
 #include "jpeg.h"
+#include "tracer.h"
 
 using namespace std;
 using namespace rtengine;
@@ -475,7 +476,7 @@ void my_error_exit (j_common_ptr cinfo)
 }
 
 
-int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
+int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize, int minWidth, int minHeight, int* fullWidth, int* fullHeight)
 {
     jpeg_decompress_struct cinfo;
     jpeg_create_decompress(&cinfo);
@@ -526,6 +527,24 @@ int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
         embProfile = nullptr;
     }
 
+    if (fullWidth) {
+        *fullWidth = cinfo.image_width;
+    }
+
+    if (fullHeight) {
+        *fullHeight = cinfo.image_height;
+    }
+
+    if (minWidth > 0 || minHeight > 0) {
+        // Skipping most of the inverse DCT is much faster than decoding the full image and downscaling it
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = 1;
+
+        while (cinfo.scale_denom < 8 && cinfo.image_width / (cinfo.scale_denom * 2) >= static_cast<unsigned int>(minWidth) && cinfo.image_height / (cinfo.scale_denom * 2) >= static_cast<unsigned int>(minHeight)) {
+            cinfo.scale_denom *= 2;
+        }
+    }
+
     jpeg_start_decompress(&cinfo);
 
     unsigned int width = cinfo.output_width;
@@ -1002,6 +1021,8 @@ void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, const char *profi
 
 int ImageIO::savePNG  (const Glib::ustring &fname, int bps) const
 {
+    TraceScope trace("ImageIO::savePNG", getWidth(), getHeight());
+
     if (getWidth() < 1 || getHeight() < 1) {
         return IMIO_HEADERERROR;
     }
@@ -1141,6 +1162,8 @@ int ImageIO::savePNG  (const Glib::ustring &fname, int bps) const
 // Quality 0..100, subsampling: 1=low quality, 2=medium, 3=high
 int ImageIO::saveJPEG (const Glib::ustring &fname, int quality, int subSamp) const
 {
+    TraceScope trace("ImageIO::saveJPEG", getWidth(), getHeight());
+
     if (getWidth() < 1 || getHeight() < 1) {
         return IMIO_HEADERERROR;
     }
@@ -1335,14 +1358,34 @@ int ImageIO::saveTIFF (const Glib::ustring &fname, int bps, bool isFloat, bool u
         return IMIO_HEADERERROR;
     }
 
-    bool writeOk = true;
-    int width = getWidth ();
-    int height = getHeight ();
-
     if (bps < 0) {
         bps = getBPS ();
     }
 
+    return writeTIFF (fname, getWidth(), getHeight(), getHeight(), bps, isFloat, uncompressed,
+        [this, bps, isFloat](int row, unsigned char* buffer)
+        {
+            getScanline (row, buffer, bps, isFloat);
+        }
+    );
+}
+
+int ImageIO::saveTIFF (const Glib::ustring &fname, int width, int height, const ScanlineSource& getRow, int bps, bool isFloat, bool uncompressed) const
+{
+    if (width < 1 || height < 1 || bps < 0) {
+        return IMIO_HEADERERROR;
+    }
+
+    // Small strips, so that libtiff never has to hold more than a few rows when compressing
+    return writeTIFF (fname, width, height, 0, bps, isFloat, uncompressed, getRow);
+}
+
+int ImageIO::writeTIFF (const Glib::ustring &fname, int width, int height, int rowsPerStrip, int bps, bool isFloat, bool uncompressed, const ScanlineSource& getRow) const
+{
+    TraceScope trace("ImageIO::saveTIFF", width, height);
+
+    bool writeOk = true;
+
     int lineWidth = width * 3 * bps / 8;
     unsigned char* linebuffer = new unsigned char[lineWidth];
 
@@ -1481,7 +1524,7 @@ int ImageIO::saveTIFF (const Glib::ustring &fname, int bps, bool isFloat, bool u
     TIFFSetField (out, TIFFTAG_IMAGELENGTH, height);
     TIFFSetField (out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
     TIFFSetField (out, TIFFTAG_SAMPLESPERPIXEL, 3);
-    TIFFSetField (out, TIFFTAG_ROWSPERSTRIP, height);
+    TIFFSetField (out, TIFFTAG_ROWSPERSTRIP, rowsPerStrip > 0 ? rowsPerStrip : TIFFDefaultStripSize (out, 0));
     TIFFSetField (out, TIFFTAG_BITSPERSAMPLE, bps);
     TIFFSetField (out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
     TIFFSetField (out, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
@@ -1509,7 +1552,7 @@ int ImageIO::saveTIFF (const Glib::ustring &fname, int bps, bool isFloat, bool u
     }
 
     for (int row = 0; row < height; row++) {
-        getScanline (row, linebuffer, bps, isFloat);
+        getRow (row, linebuffer);
 
         if (bps == 16) {
             if(needsReverse && !uncompressed && isFloat) {
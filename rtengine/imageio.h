@@ -18,6 +18,7 @@
  */
 #pragma once
 
+#include <functional>
 #include <memory>
 
 #include <glibmm/ustring.h>
@@ -79,8 +80,13 @@ protected:
     IIOSampleFormat sampleFormat;
     IIOSampleArrangement sampleArrangement;
 
+public:
+    // Fills buffer with the given row of the image, in the sample format requested from saveTIFF
+    using ScanlineSource = std::function<void (int row, unsigned char* buffer)>;
+
 private:
     void deleteLoadedProfileData( );
+    int writeTIFF (const Glib::ustring &fname, int width, int height, int rowsPerStrip, int bps, bool isFloat, bool uncompressed, const ScanlineSource& getRow) const;
 
 public:
     static Glib::ustring errorMsg[6];
@@ -109,12 +115,17 @@ public:
     static int getPNGSampleFormat (const Glib::ustring &fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
     static int getTIFFSampleFormat (const Glib::ustring &fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
 
-    int loadJPEGFromMemory (const char* buffer, int bufsize);
+    // If minWidth or minHeight is set, the image is decoded with libjpeg's DCT scaling at the smallest of 1/1, 1/2, 1/4
+    // and 1/8 of its size still covering minWidth x minHeight. fullWidth and fullHeight then receive the unscaled size.
+    int loadJPEGFromMemory (const char* buffer, int bufsize, int minWidth = 0, int minHeight = 0, int* fullWidth = nullptr, int* fullHeight = nullptr);
     int loadPPMFromMemory(const char* buffer, int width, int height, bool swap, int bps);
 
     int savePNG (const Glib::ustring &fname, int bps = -1) const;
     int saveJPEG (const Glib::ustring &fname, int quality = 100, int subSamp = 3) const;
     int saveTIFF (const Glib::ustring &fname, int bps = -1, bool isFloat = false, bool uncompressed = false) const;
+    // Writes the metadata and output profile of this image along with rows provided on demand by getRow,
+    // which are requested in order from top to bottom and written in small strips
+    int saveTIFF (const Glib::ustring &fname, int width, int height, const ScanlineSource& getRow, int bps, bool isFloat = false, bool uncompressed = false) const;
 
     cmsHPROFILE getEmbeddedProfile () const;
     void getEmbeddedProfileData (int& length, unsigned char*& pdata) const;
@@ -0,0 +1,133 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "imagewriter.h"
+
+#include "iimage.h"
+
+namespace rtengine
+{
+
+ImageWriter::ImageWriter(std::size_t maxQueued) :
+    maxQueued(std::max<std::size_t>(maxQueued, 1)),
+    pending(0),
+    stop(false),
+    thread(&ImageWriter::process, this)
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+
+    jobAvailable.notify_all();
+    thread.join();
+}
+
+void ImageWriter::enqueue(IImagefloat* image, const Glib::ustring& fname, const SaveFunction& save, const DoneFunction& done)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    slotAvailable.wait(
+        lock,
+        [this]() -> bool
+        {
+            return pending < maxQueued;
+        }
+    );
+
+    ++pending;
+    pendingNames.insert(fname);
+
+    jobs.emplace_back();
+    Job& job = jobs.back();
+    job.image.reset(image);
+    job.fname = fname;
+    job.save = save;
+    job.done = done;
+
+    lock.unlock();
+    jobAvailable.notify_one();
+}
+
+void ImageWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    slotAvailable.wait(
+        lock,
+        [this]() -> bool
+        {
+            return pending == 0;
+        }
+    );
+}
+
+bool ImageWriter::isPending(const Glib::ustring& fname) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pendingNames.find(fname) != pendingNames.end();
+}
+
+void ImageWriter::process()
+{
+    while (true) {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            jobAvailable.wait(
+                lock,
+                [this]() -> bool
+                {
+                    return stop || !jobs.empty();
+                }
+            );
+
+            if (jobs.empty()) {
+                // stop requested and everything written
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        const int errorCode = job.save(job.image.get());
+        job.image.reset();
+
+        if (job.done) {
+            job.done(errorCode);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --pending;
+            pendingNames.erase(pendingNames.find(job.fname));
+        }
+
+        slotAvailable.notify_all();
+    }
+}
+
+}
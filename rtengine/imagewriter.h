@@ -0,0 +1,88 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <glibmm/ustring.h>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+class IImagefloat;
+
+/**
+ * @brief Background encoder for processed images
+ *
+ * The writer takes ownership of the images handed to enqueue() and encodes them
+ * on its own thread, so that the caller can start processing the next image
+ * right away. At most maxQueued images are owned by the writer at any time,
+ * enqueue() blocks until a slot is free, which caps the memory held by pending
+ * writes. The destructor waits for all pending images to be written.
+ */
+class ImageWriter final :
+    public NonCopyable
+{
+public:
+    // Encodes the image to disk, returns 0 on success or an IMIO_* error code
+    using SaveFunction = std::function<int (const IImagefloat* image)>;
+    // Called on the writer thread once the image has been written and freed
+    using DoneFunction = std::function<void (int errorCode)>;
+
+    explicit ImageWriter(std::size_t maxQueued = 1);
+    ~ImageWriter();
+
+    void enqueue(IImagefloat* image, const Glib::ustring& fname, const SaveFunction& save, const DoneFunction& done = DoneFunction());
+
+    // Blocks until all the images enqueued so far are written
+    void flush();
+
+    // Whether fname is the target of a write which is not finished yet
+    bool isPending(const Glib::ustring& fname) const;
+
+private:
+    struct Job {
+        std::unique_ptr<IImagefloat> image;
+        Glib::ustring fname;
+        SaveFunction save;
+        DoneFunction done;
+    };
+
+    void process();
+
+    const std::size_t maxQueued;
+    std::size_t pending;
+    bool stop;
+    std::deque<Job> jobs;
+    std::multiset<Glib::ustring> pendingNames;
+    mutable std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable slotAvailable;
+    std::thread thread;
+};
+
+}
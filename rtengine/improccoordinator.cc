@@ -16,6 +16,7 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <chrono>
 #include <fstream>
 #include <glibmm/thread.h>
 
@@ -35,6 +36,7 @@
 #include "lcp.h"
 #include "procparams.h"
 #include "refreshmap.h"
+#include "tracer.h"
 #include "guidedfilter.h"
 
 #include "../rtgui/options.h"
@@ -173,6 +175,10 @@ ImProcCoordinator::ImProcCoordinator() :
     updaterRunning(false),
     nextParams(new procparams::ProcParams),
     destroying(false),
+    updatePending(false),
+    abandonedChange(0),
+    abandonedPanningRelatedChange(false),
+    labAdjustmentsCache(sameLabAdjustmentsParams),
     utili(false),
     autili(false),
     butili(false),
@@ -296,6 +302,12 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
     // TODO Locallab printf
 
     MyMutex::MyLock processingLock(mProcessing);
+    TraceScope trace("ImProcCoordinator::updatePreviewImage", pW, pH);
+
+    // The input of the L*a*b* adjustments changes with any earlier stage
+    if (todo & ~(M_LUMACURVE | M_LUMINANCE | M_COLOR | M_MONITOR)) {
+        labAdjustmentsCache.invalidate();
+    }
 
     bool highDetailNeeded = options.prevdemo == PD_Sidecar ? true : (todo & M_HIGHQUAL);
                 //    printf("metwb=%s \n", params->wb.method.c_str());
@@ -862,6 +874,12 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
             */
         }
 
+        // The slow tools below are skipped when a newer change is waiting
+        if (isUpdateOutdated()) {
+            abandonUpdate(todo, panningRelatedChange);
+            return;
+        }
+
       //  if ((todo & (M_LUMINANCE + M_COLOR)) || (todo & M_AUTOEXP)) {
         //    if (todo & M_RGBCURVE) {
         if (((todo & (M_AUTOEXP | M_RGBCURVE)) || (todo & M_CROP)) && params->locallab.enabled && !params->locallab.spots.empty()) {
@@ -1282,23 +1300,33 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
 
         //scale = 1;
 
-        if ((todo & (M_LUMINANCE + M_COLOR)) || (todo & M_AUTOEXP)) {
-            nprevl->CopyFrom(oprevl);
-
-            histCCurve.clear();
-            histLCurve.clear();
-            ipf.chromiLuminanceCurve(nullptr, pW, nprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
-            ipf.vibrance(nprevl, params->vibrance, params->toneCurve.hrenabled, params->icm.workingProfile);
-            ipf.labColorCorrectionRegions(nprevl);
+        if (isUpdateOutdated()) {
+            abandonUpdate(todo, panningRelatedChange);
+            return;
+        }
 
-            if ((params->colorappearance.enabled && !params->colorappearance.tonecie) || (!params->colorappearance.enabled)) {
-                ipf.EPDToneMap(nprevl, 0, scale);
-            }
+        if ((todo & (M_LUMINANCE + M_COLOR)) || (todo & M_AUTOEXP)) {
+            // Only the tools after the wavelets run again if the parameters of the ones before are unchanged
+            if (!labAdjustmentsCache.restore(*params, 0, *nprevl)) {
+                nprevl->CopyFrom(oprevl);
+
+                histCCurve.clear();
+                histLCurve.clear();
+                ipf.chromiLuminanceCurve(nullptr, pW, nprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
+                ipf.vibrance(nprevl, params->vibrance, params->toneCurve.hrenabled, params->icm.workingProfile);
+                ipf.labColorCorrectionRegions(nprevl);
+
+                if ((params->colorappearance.enabled && !params->colorappearance.tonecie) || (!params->colorappearance.enabled)) {
+                    ipf.EPDToneMap(nprevl, 0, scale);
+                }
 
-            if (params->dirpyrequalizer.cbdlMethod == "aft") {
-                if (((params->colorappearance.enabled && !settings->autocielab) || (!params->colorappearance.enabled))) {
-                    ipf.dirpyrequalizer(nprevl, scale);
+                if (params->dirpyrequalizer.cbdlMethod == "aft") {
+                    if (((params->colorappearance.enabled && !settings->autocielab) || (!params->colorappearance.enabled))) {
+                        ipf.dirpyrequalizer(nprevl, scale);
+                    }
                 }
+
+                labAdjustmentsCache.store(*params, 0, *nprevl);
             }
 
             wavcontlutili = CurveFactory::diagonalCurve2Lut(params->wavelet.wavclCurve, wavclCurve, scale == 1 ? 1 : 16);
@@ -1631,11 +1659,25 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
     }
 
 // process crop, if needed
+    std::vector<Crop*> cropsToUpdate;
+
     for (size_t i = 0; i < crops.size(); i++)
         if (crops[i]->hasListener() && (panningRelatedChange || (highDetailNeeded && options.prevdemo != PD_Sidecar) || (todo & (M_MONITOR | M_RGBCURVE | M_LUMACURVE)) || crops[i]->get_skip() == 1)) {
-            crops[i]->update(todo);     // may call ourselves
+            cropsToUpdate.push_back(crops[i]);
         }
 
+    // Crops that took too long the last time are first computed at half resolution, and refined after the preview
+    const auto cropsUpdateTime = cropsUpdateTimes.find(todo);
+    const bool progressive =
+        options.progressivePreviewLatency > 0
+        && cropsUpdateTime != cropsUpdateTimes.end()
+        && cropsUpdateTime->second > options.progressivePreviewLatency;
+
+    if (!updateCrops(cropsToUpdate, todo, progressive)) {
+        abandonUpdate(todo, panningRelatedChange);
+        return;
+    }
+
     if (panningRelatedChange || (todo & M_MONITOR)) {
         if ((todo != CROP && todo != MINUPDATE) || (todo & M_MONITOR)) {
             MyMutex::MyLock prevImgLock(previmg->getMutex());
@@ -1684,6 +1726,11 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
         }
     }
 
+    if (progressive && !updateCrops(cropsToUpdate, todo, false)) {
+        abandonUpdate(todo, panningRelatedChange);
+        return;
+    }
+
     if (orig_prev != oprevi) {
         delete oprevi;
         oprevi = nullptr;
@@ -1692,6 +1739,44 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
 
 }
 
+bool ImProcCoordinator::isUpdateOutdated() const
+{
+    return options.progressivePreviewLatency > 0 && updatePending;
+}
+
+void ImProcCoordinator::abandonUpdate(int todo, bool panningRelatedChange)
+{
+    if (orig_prev != oprevi) {
+        delete oprevi;
+        oprevi = nullptr;
+    }
+
+    // The next update restarts from the earliest stage of both updates
+    abandonedChange |= todo;
+    abandonedPanningRelatedChange = abandonedPanningRelatedChange || panningRelatedChange;
+}
+
+bool ImProcCoordinator::updateCrops(const std::vector<Crop*>& cropsToUpdate, int todo, bool coarse)
+{
+    const auto start = std::chrono::steady_clock::now();
+    bool sameTodo = true;
+
+    for (const auto crop : cropsToUpdate) {
+        if (isUpdateOutdated()) {
+            return false;
+        }
+
+        sameTodo = crop->update(todo, coarse) == todo && sameTodo;     // may call ourselves
+    }
+
+    // A crop may have processed more than todo (e.g. everything after a window change), which doesn't tell how long todo takes
+    if (!coarse && sameTodo && !cropsToUpdate.empty()) {
+        cropsUpdateTimes[todo] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return true;
+}
+
 
 void ImProcCoordinator::freeAll()
 {
@@ -2333,6 +2418,7 @@ void ImProcCoordinator::startProcessing(int changeCode)
 {
     paramsUpdateMutex.lock();
     changeSinceLast |= changeCode;
+    updatePending = true;
     paramsUpdateMutex.unlock();
 
     startProcessing();
@@ -2384,12 +2470,16 @@ void ImProcCoordinator::process()
             || params->dehaze != nextParams->dehaze
             || params->pdsharpening != nextParams->pdsharpening
             || params->filmNegative != nextParams->filmNegative
-            || sharpMaskChanged;
+            || sharpMaskChanged
+            || abandonedPanningRelatedChange;
 
         sharpMaskChanged = false;
+        abandonedPanningRelatedChange = false;
         *params = *nextParams;
-        int change = changeSinceLast;
+        int change = changeSinceLast | abandonedChange;
         changeSinceLast = 0;
+        abandonedChange = 0;
+        updatePending = false;
         paramsUpdateMutex.unlock();
 
         // M_VOID means no update, and is a bit higher that the rest
@@ -2424,6 +2514,7 @@ void ImProcCoordinator::endUpdateParams(ProcEvent change)
 void ImProcCoordinator::endUpdateParams(int changeFlags)
 {
     changeSinceLast |= changeFlags;
+    updatePending = true;
 
     paramsUpdateMutex.unlock();
     startProcessing();
@@ -18,6 +18,8 @@
  */
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <memory>
 
 #include "array2D.h"
@@ -26,6 +28,7 @@
 #include "dcrop.h"
 #include "imagesource.h"
 #include "improcfun.h"
+#include "labstagecache.h"
 #include "LUT.h"
 #include "rtengine.h"
 
@@ -217,6 +220,12 @@ protected:
     bool updateWaveforms();
     void setScale(int prevscale);
     void updatePreviewImage (int todo, bool panningRelatedChange);
+    /// True when progressive updates are enabled and a change arrived since the running update started.
+    bool isUpdateOutdated() const;
+    /// Stops the running update, its changes are merged into the next one.
+    void abandonUpdate(int todo, bool panningRelatedChange);
+    /// Updates the crops, at twice their skip if coarse. Returns false if the update became outdated.
+    bool updateCrops(const std::vector<Crop*>& cropsToUpdate, int todo, bool coarse);
 
     MyMutex mProcessing;
     const std::unique_ptr<ProcParams> params;
@@ -236,6 +245,11 @@ protected:
     bool updaterRunning;
     const std::unique_ptr<ProcParams> nextParams;
     bool destroying;
+    std::atomic<bool> updatePending;     // changeSinceLast has been set since the updater took the parameters
+    int  abandonedChange;                // changes of the abandoned updates, only used by the updater thread
+    bool abandonedPanningRelatedChange;
+    std::map<int, double> cropsUpdateTimes; // duration in ms of the last update of the crops at full resolution, by change
+    LabStageCache labAdjustmentsCache;   // output of the L*a*b* adjustments preceding the wavelets
     bool utili;
     bool autili;
     bool butili;
@@ -46,6 +46,7 @@
 #include "rtengine.h"
 #include "rtthumbnail.h"
 #include "satandvalueblendingcurve.h"
+#include "tracer.h"
 #include "StopWatch.h"
 #include "utils.h"
 
@@ -274,12 +275,7 @@ namespace rtengine
 
 using namespace procparams;
 
-ImProcFunctions::~ImProcFunctions ()
-{
-    if (monitorTransform) {
-        cmsDeleteTransform(monitorTransform);
-    }
-}
+ImProcFunctions::~ImProcFunctions () = default;
 
 void ImProcFunctions::setScale(double iscale)
 {
@@ -290,14 +286,9 @@ void ImProcFunctions::setScale(double iscale)
 void ImProcFunctions::updateColorProfiles(const Glib::ustring& monitorProfile, RenderingIntent monitorIntent, bool softProof, bool gamutCheck)
 {
     // set up monitor transform
-    if (monitorTransform) {
-        cmsDeleteTransform(monitorTransform);
-    }
-
+    monitorTransform.reset();
     gamutWarning.reset(nullptr);
 
-    monitorTransform = nullptr;
-
     cmsHPROFILE monitor = nullptr;
 
     if (!monitorProfile.empty()) {
@@ -309,16 +300,11 @@ void ImProcFunctions::updateColorProfiles(const Glib::ustring& monitorProfile, R
     }
 
     if (monitor) {
-        MyMutex::MyLock lcmsLock(*lcmsMutex);
-
         cmsUInt32Number flags;
-        cmsHPROFILE iprof  = cmsCreateLab4Profile(nullptr);
         cmsHPROFILE gamutprof = nullptr;
         cmsUInt32Number gamutbpc = 0;
         RenderingIntent gamutintent = RI_RELATIVE;
 
-        bool softProofCreated = false;
-
         if (softProof) {
             cmsHPROFILE oprof = nullptr;
             RenderingIntent outIntent;
@@ -348,42 +334,8 @@ void ImProcFunctions::updateColorProfiles(const Glib::ustring& monitorProfile, R
                 //     flags |= cmsFLAGS_GAMUTCHECK;
                 // }
 
-                const auto make_gamma_table =
-                    [](cmsHPROFILE prof, cmsTagSignature tag) -> void
-                    {
-                        cmsToneCurve *tc = static_cast<cmsToneCurve *>(cmsReadTag(prof, tag));
-                        if (tc) {
-                            const cmsUInt16Number *table = cmsGetToneCurveEstimatedTable(tc);
-                            cmsToneCurve *tc16 = cmsBuildTabulatedToneCurve16(nullptr, cmsGetToneCurveEstimatedTableEntries(tc), table);
-                            if (tc16) {
-                                cmsWriteTag(prof, tag, tc16);
-                                cmsFreeToneCurve(tc16);
-                            }
-                        }
-                    };
-
-                cmsHPROFILE softproof = ProfileContent(oprof).toProfile();
-                if (softproof) {
-                    make_gamma_table(softproof, cmsSigRedTRCTag);
-                    make_gamma_table(softproof, cmsSigGreenTRCTag);
-                    make_gamma_table(softproof, cmsSigBlueTRCTag);
-                }
-
-                monitorTransform = cmsCreateProofingTransform(
-                                       iprof, TYPE_Lab_FLT,
-                                       monitor, TYPE_RGB_FLT,
-                                       softproof, //oprof,
-                                       monitorIntent, outIntent,
-                                       flags
-                                   );
-
-                if (softproof) {
-                    cmsCloseProfile(softproof);
-                }
-
-                if (monitorTransform) {
-                    softProofCreated = true;
-                }
+                // Kept by the store, switching soft-proofing back on does not rebuild it
+                monitorTransform = ICCStore::getInstance()->getProofingTransform(monitor, oprof, monitorIntent, outIntent, flags);
 
                 if (gamutCheck) {
                     gamutprof = oprof;
@@ -403,9 +355,6 @@ void ImProcFunctions::updateColorProfiles(const Glib::ustring& monitorProfile, R
 
             // monitorTransform = cmsCreateProofingTransform(iprof, TYPE_Lab_FLT, monitor, TYPE_RGB_8, monitor, monitorIntent, monitorIntent, flags);
 
-            // if (monitorTransform) {
-            //     softProofCreated = true;
-            // }
             gamutprof = monitor;
 
             if (settings->monitorBPC) {
@@ -415,21 +364,22 @@ void ImProcFunctions::updateColorProfiles(const Glib::ustring& monitorProfile, R
             gamutintent = monitorIntent;
         }
 
-        if (!softProofCreated) {
+        if (!monitorTransform) {
             flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE;
 
             if (settings->monitorBPC) {
                 flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
             }
 
-            monitorTransform = cmsCreateTransform(iprof, TYPE_Lab_FLT, monitor, TYPE_RGB_FLT, monitorIntent, flags);
+            monitorTransform = ICCStore::getInstance()->getTransform(nullptr, TYPE_Lab_FLT, monitor, TYPE_RGB_FLT, monitorIntent, flags);
         }
 
         if (gamutCheck && gamutprof) {
+            MyMutex::MyLock lcmsLock(*lcmsMutex);
+            cmsHPROFILE iprof = cmsCreateLab4Profile(nullptr);
             gamutWarning.reset(new GamutWarning(iprof, gamutprof, gamutintent, gamutbpc));
+            cmsCloseProfile(iprof);
         }
-
-        cmsCloseProfile(iprof);
     }
 }
 
@@ -506,6 +456,8 @@ void ImProcFunctions::ciecam_02float(CieImage* ncie, float adap, int pW, int pwb
                                      LUTu & histLCAM, LUTu & histCCAM, LUTf & CAMBrightCurveJ, LUTf & CAMBrightCurveQ, float &mean, int Iterates, int scale, bool execsharp, float &d, float &dj, float &yb, int rtt,
                                      bool showSharpMask)
 {
+    TraceScope trace("ImProcFunctions::ciecam_02float", lab->W, lab->H);
+
     if (params->colorappearance.enabled) {
         //preparate for histograms CIECAM
         LUTu hist16JCAM;
@@ -2034,6 +1986,7 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                                double &rrm, double &ggm, double &bbm, float &autor, float &autog, float &autob, double expcomp, int hlcompr, int hlcomprthresh,
                                DCPProfile *dcpProf, const DCPProfileApplyState& asIn, LUTu& histToneCurve, size_t chunkSize, bool measure)
 {
+    TraceScope trace("ImProcFunctions::rgbProc", working->getWidth(), working->getHeight());
 
     std::unique_ptr<StopWatch> stop;
 
@@ -4141,6 +4094,8 @@ void ImProcFunctions::luminanceCurve (LabImage* lold, LabImage* lnew, const LUTf
 
 void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW, LabImage* lold, LabImage* lnew, const LUTf& acurve, const LUTf& bcurve, const LUTf& satcurve, const LUTf& lhskcurve, const LUTf& clcurve, LUTf & curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &histCCurve, LUTu &histLCurve)
 {
+    TraceScope trace("ImProcFunctions::chromiLuminanceCurve", lold->W, lold->H);
+
     int W = lold->W;
     int H = lold->H;
 
@@ -5041,6 +4996,8 @@ void ImProcFunctions::badpixlab(LabImage* lab, double rad, int thr, float chrom)
 
 void ImProcFunctions::dirpyrequalizer(LabImage* lab, int scale)
 {
+    TraceScope trace("ImProcFunctions::dirpyrequalizer", lab->W, lab->H);
+
     if (params->dirpyrequalizer.enabled && lab->W >= 8 && lab->H >= 8) {
         float b_l = static_cast<float>(params->dirpyrequalizer.hueskin.getBottomLeft()) / 100.f;
         float t_l = static_cast<float>(params->dirpyrequalizer.hueskin.getTopLeft()) / 100.f;
@@ -5264,6 +5221,8 @@ void ImProcFunctions::EPDToneMap(LabImage *lab, unsigned int Iterates, int skip)
         return;
     }
 
+    TraceScope trace("ImProcFunctions::EPDToneMap", lab->W, lab->H);
+
     const float stren = params->epd.strength;
     const float edgest = std::min(params->epd.edgeStopping, params->localContrast.enabled ? 3.0 : 4.0);
     const float sca = params->epd.scale;
@@ -48,6 +48,7 @@ namespace rtengine
 
 class ColorAppearance;
 class ColorGradientCurve;
+class ColorTransform;
 class DCPProfile;
 class DCPProfileApplyState;
 class FlatCurve;
@@ -103,7 +104,7 @@ enum RenderingIntent : int;
 
 class ImProcFunctions
 {
-    cmsHTRANSFORM monitorTransform;
+    std::shared_ptr<const ColorTransform> monitorTransform;
     std::unique_ptr<GamutWarning> gamutWarning;
     Cairo::RefPtr<Cairo::ImageSurface> locImage;
 
@@ -202,7 +203,7 @@ enum class BlurType {
     void sharpeningcam(CieImage* ncie, float** buffer, bool showMask = false);
     void transform(Imagefloat* original, Imagefloat* transformed, int cx, int cy, int sx, int sy, int oW, int oH, int fW, int fH, const FramesMetaData *metadata, int rawRotationDeg, bool fullImage, bool useOriginalBuffer = false);
     float resizeScale(const procparams::ProcParams* params, int fw, int fh, int &imw, int &imh);
-    void lab2monitorRgb(LabImage* lab, Image8* image);
+    void lab2monitorRgb(LabImage* lab, Image8* image, int cx = 0, int cy = 0);
     void resize(Imagefloat* src, Imagefloat* dst, float dScale);
     void Lanczos(const LabImage* src, LabImage* dst, float scale);
     void Lanczos(const Imagefloat* src, Imagefloat* dst, float scale);
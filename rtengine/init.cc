@@ -29,8 +29,12 @@
 #include "improccoordinator.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
+#include "fftwplancache.h"
+#include "labstagecache.h"
+#include "planepool.h"
 #include "rtthumbnail.h"
 #include "profilestore.h"
+#include "../rtgui/options.h"
 #include "../rtgui/threadutils.h"
 #include "rtlensfun.h"
 #include "procparams.h"
@@ -86,7 +90,7 @@ int init (const Settings* s, const Glib::ustring& baseDir, const Glib::ustring&
 #pragma omp section
 #endif
 {
-    CameraConstantsStore::getInstance()->init(baseDir, userSettingsDir);
+    CameraConstantsStore::getInstance()->init(baseDir, userSettingsDir, options.cacheBaseDir);
 }
 #ifdef _OPENMP
 #pragma omp section
@@ -102,7 +106,10 @@ int init (const Settings* s, const Glib::ustring& baseDir, const Glib::ustring&
 }
 }
 
-    Color::init ();
+    Color::init (options.cacheBaseDir.empty() ? Glib::ustring() : Glib::ustring(Glib::build_filename(options.cacheBaseDir, "colortables")));
+    FFTWPlanCache::getInstance().init(options.cacheBaseDir.empty() ? Glib::ustring() : Glib::ustring(Glib::build_filename(options.cacheBaseDir, "fftwf_wisdom")));
+    PlanePool::getInstance().setLimit(static_cast<std::size_t>(options.planePoolSize) * 1024 * 1024);
+    LabStageCache::setLimit(static_cast<std::size_t>(options.stageCacheSize) * 1024 * 1024);
     delete lcmsMutex;
     lcmsMutex = new MyMutex;
     fftwMutex = new MyMutex;
@@ -114,6 +121,8 @@ void cleanup ()
     ProcParams::cleanup ();
     Color::cleanup ();
     RawImageSource::cleanup ();
+    FFTWPlanCache::getInstance().cleanup();
+    PlanePool::getInstance().clear();
 
 #ifdef RT_FFTW3F_OMP
     fftwf_cleanup_threads();
@@ -41,6 +41,7 @@
 #include "procparams.h"
 #include "rescale.h"
 #include "rt_math.h"
+#include "tracer.h"
 //#define BENCHMARK
 #include "StopWatch.h"
 
@@ -307,6 +308,8 @@ void ImProcFunctions::dehaze(Imagefloat *img, const DehazeParams &dehazeParams)
         return;
     }
 
+    TraceScope trace("ImProcFunctions::dehaze", img->getWidth(), img->getHeight());
+
     const float maxChannel = normalize(img, multiThread);
 
     const int W = img->getWidth();
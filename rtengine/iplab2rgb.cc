@@ -42,11 +42,9 @@ inline void copyAndClampLine(const float *src, unsigned char *dst, const int W)
 }
 
 
-inline void copyAndClamp(const LabImage *src, unsigned char *dst, const double rgb_xyz[3][3], bool multiThread)
+// Converts the W x H part of src at (cx, cy)
+inline void copyAndClamp(const LabImage *src, int cx, int cy, int W, int H, unsigned char *dst, const double rgb_xyz[3][3], bool multiThread)
 {
-    const int W = src->W;
-    const int H = src->H;
-
     float rgb_xyzf[3][3];
 
     for (int i = 0; i < 3; i++) {
@@ -68,9 +66,9 @@ inline void copyAndClamp(const LabImage *src, unsigned char *dst, const double r
         #pragma omp parallel for schedule(dynamic,16) if (multiThread)
 #endif
     for (int i = 0; i < H; ++i) {
-        float* rL = src->L[i];
-        float* ra = src->a[i];
-        float* rb = src->b[i];
+        float* rL = src->L[i + cy] + cx;
+        float* ra = src->a[i + cy] + cx;
+        float* rb = src->b[i + cy] + cx;
         int ix = i * 3 * W;
 
 #ifdef __SSE2__
@@ -125,12 +123,15 @@ inline void copyAndClamp(const LabImage *src, unsigned char *dst, const double r
 //
 // If monitorTransform, divide by 327.68 then apply monitorTransform (which can integrate soft-proofing)
 // otherwise divide by 327.68, convert to xyz and apply the sRGB transform, before converting with gamma2curve
-void ImProcFunctions::lab2monitorRgb(LabImage* lab, Image8* image)
+//
+// Only the part of lab at (cx, cy) having the size of image is converted, so the caller does not have to copy it out
+void ImProcFunctions::lab2monitorRgb(LabImage* lab, Image8* image, int cx, int cy)
 {
+    const int W = image->getWidth();
+    const int H = image->getHeight();
+
     if (monitorTransform) {
 
-        const int W = lab->W;
-        const int H = lab->H;
         unsigned char * data = image->data;
 
         // cmsDoTransform is relatively expensive
@@ -138,16 +139,16 @@ void ImProcFunctions::lab2monitorRgb(LabImage* lab, Image8* image)
         #pragma omp parallel firstprivate(lab, data, W, H)
 #endif
         {
-            AlignedBuffer<float> pBuf(3 * lab->W);
+            AlignedBuffer<float> pBuf(3 * W);
 
             AlignedBuffer<float> mBuf;
             AlignedBuffer<float> gwBuf1;
             AlignedBuffer<float> gwBuf2;
 
             if (gamutWarning) {
-                gwBuf1.resize(3 * lab->W);
-                gwBuf2.resize(3 * lab->W);
-                mBuf.resize(3 * lab->W);
+                gwBuf1.resize(3 * W);
+                gwBuf2.resize(3 * W);
+                mBuf.resize(3 * W);
             }
 
             float *buffer = pBuf.data;
@@ -162,9 +163,9 @@ void ImProcFunctions::lab2monitorRgb(LabImage* lab, Image8* image)
                 const int ix = i * 3 * W;
                 int iy = 0;
 
-                float* rL = lab->L[i];
-                float* ra = lab->a[i];
-                float* rb = lab->b[i];
+                float* rL = lab->L[i + cy] + cx;
+                float* ra = lab->a[i + cy] + cx;
+                float* rb = lab->b[i + cy] + cx;
 
                 for (int j = 0; j < W; j++) {
                     buffer[iy++] = rL[j] / 327.68f;
@@ -172,7 +173,7 @@ void ImProcFunctions::lab2monitorRgb(LabImage* lab, Image8* image)
                     buffer[iy++] = rb[j] / 327.68f;
                 }
 
-                cmsDoTransform(monitorTransform, buffer, outbuffer, W);
+                monitorTransform->transform(buffer, outbuffer, W);
                 copyAndClampLine(outbuffer, data + ix, W);
 
                 if (gamutWarning) {
@@ -181,7 +182,7 @@ void ImProcFunctions::lab2monitorRgb(LabImage* lab, Image8* image)
             }
         } // End of parallelization
     } else {
-        copyAndClamp(lab, image->data, sRGB_xyz, multiThread);
+        copyAndClamp(lab, cx, cy, W, H, image->data, sRGB_xyz, multiThread);
     }
 }
 
@@ -229,15 +230,10 @@ Image8* ImProcFunctions::lab2rgb(LabImage* lab, int cx, int cy, int cw, int ch,
         oprof = ICCStore::getInstance()->getProfile(profile);
     }
 
-    if (oprof) {
-        const cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE | (icm.outputBPC ? cmsFLAGS_BLACKPOINTCOMPENSATION : 0); // NOCACHE is important for thread safety
-
-        lcmsMutex->lock();
-        cmsHPROFILE LabIProf  = cmsCreateLab4Profile(nullptr);
-        cmsHTRANSFORM hTransform = cmsCreateTransform (LabIProf, TYPE_Lab_DBL, oprof, TYPE_RGB_FLT, icm.outputIntent, flags);
-        cmsCloseProfile(LabIProf);
-        lcmsMutex->unlock();
+    const cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE | (icm.outputBPC ? cmsFLAGS_BLACKPOINTCOMPENSATION : 0); // NOCACHE is important for thread safety
+    const std::shared_ptr<const ColorTransform> transform = oprof ? ICCStore::getInstance()->getTransform(nullptr, TYPE_Lab_DBL, oprof, TYPE_RGB_FLT, icm.outputIntent, flags) : nullptr;
 
+    if (transform) {
         unsigned char *data = image->data;
 
         // cmsDoTransform is relatively expensive
@@ -256,7 +252,7 @@ Image8* ImProcFunctions::lab2rgb(LabImage* lab, int cx, int cy, int cw, int ch,
 #endif
 
             for (int i = cy; i < condition; i++) {
-                const int ix = i * 3 * cw;
+                const int ix = (i - cy) * 3 * cw;
                 int iy = 0;
                 float* rL = lab->L[i];
                 float* ra = lab->a[i];
@@ -268,16 +264,13 @@ Image8* ImProcFunctions::lab2rgb(LabImage* lab, int cx, int cy, int cw, int ch,
                     buffer[iy++] = rb[j] / 327.68f;
                 }
 
-                cmsDoTransform (hTransform, buffer, outbuffer, cw);
+                transform->transform(buffer, outbuffer, cw);
                 copyAndClampLine(outbuffer, data + ix, cw);
             }
         } // End of parallelization
-
-        cmsDeleteTransform(hTransform);
-
     } else {
         const auto xyz_rgb = ICCStore::getInstance()->workingSpaceInverseMatrix(profile);
-        copyAndClamp(lab, image->data, xyz_rgb, multiThread);
+        copyAndClamp(lab, cx, cy, cw, ch, image->data, xyz_rgb, multiThread);
     }
 
     return image;
@@ -320,6 +313,7 @@ Imagefloat* ImProcFunctions::lab2rgbOut(LabImage* lab, int cx, int cy, int cw, i
 
     Imagefloat* image = new Imagefloat(cw, ch);
     cmsHPROFILE oprof = ICCStore::getInstance()->getProfile(icm.outputProfile);
+    std::shared_ptr<const ColorTransform> transform;
 
     if (oprof) {
         cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE;
@@ -328,13 +322,11 @@ Imagefloat* ImProcFunctions::lab2rgbOut(LabImage* lab, int cx, int cy, int cw, i
             flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
         }
 
-        lcmsMutex->lock();
-        cmsHPROFILE iprof = cmsCreateLab4Profile(nullptr);
-        cmsHTRANSFORM hTransform = cmsCreateTransform(iprof, TYPE_Lab_FLT, oprof, TYPE_RGB_FLT, icm.outputIntent, flags);
-        lcmsMutex->unlock();
+        transform = ICCStore::getInstance()->getTransform(nullptr, TYPE_Lab_FLT, oprof, TYPE_RGB_FLT, icm.outputIntent, flags);
+    }
 
-        image->ExecCMSTransform(hTransform, *lab, cx, cy);
-        cmsDeleteTransform(hTransform);
+    if (transform) {
+        image->ExecCMSTransform(*transform, *lab, cx, cy);
         image->normalizeFloatTo65535();
     } else {
         
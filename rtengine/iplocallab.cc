@@ -26,6 +26,7 @@
 #include "improcfun.h"
 #include "colortemp.h"
 #include "curves.h"
+#include "fftwplancache.h"
 #include "gauss.h"
 #include "iccstore.h"
 #include "imagefloat.h"
@@ -35,6 +36,7 @@
 #include "jaggedarray.h"
 #include "rt_algo.h"
 #include "settings.h"
+#include "tracer.h"
 #include "../rtgui/options.h"
 #include "utils.h"
 #ifdef _OPENMP
@@ -4381,10 +4383,9 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
 
    // BENCHFUN
 #ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
+    const int fftwThreads = multiThread ? omp_get_max_threads() : 1;
+#else
+    constexpr int fftwThreads = 1;
 #endif
 
     float *datashow = nullptr;
@@ -4420,9 +4421,8 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
     }
 
     //execute first
-    const auto dct_fw = fftwf_plan_r2r_2d(bfh, bfw, data_tmp, data_fft, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_fw);
-    fftwf_destroy_plan(dct_fw);
+    const auto dct_fw = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, data_tmp, data_fft, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, fftwThreads);
+    fftwf_execute_r2r(dct_fw.get(), data_tmp, data_fft);
 
     //execute second
     if (dEenable == 1) {
@@ -4434,9 +4434,8 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
         }
         //second call to laplacian with 40% strength ==> reduce effect if we are far from ref (deltaE)
         discrete_laplacian_threshold(data_tmp04, datain, bfw, bfh, 0.4f * thresh);
-        const auto dct_fw04 = fftwf_plan_r2r_2d(bfh, bfw, data_tmp04, data_fft04, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-        fftwf_execute(dct_fw04);
-        fftwf_destroy_plan(dct_fw04);
+        const auto dct_fw04 = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, data_tmp04, data_fft04, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, fftwThreads);
+        fftwf_execute_r2r(dct_fw04.get(), data_tmp04, data_fft04);
         constexpr float exponent = 4.5f;
 
 #ifdef _OPENMP
@@ -4484,9 +4483,8 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
         }
     }
 
-    const auto dct_bw = fftwf_plan_r2r_2d(bfh, bfw, data_fft, data_tmp, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_bw);
-    fftwf_destroy_plan(dct_bw);
+    const auto dct_bw = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, data_fft, data_tmp, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, fftwThreads);
+    fftwf_execute_r2r(dct_bw.get(), data_fft, data_tmp);
     fftwf_free(data_fft);
 
     if (show != 4 && normalize == 1) {
@@ -4515,13 +4513,6 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
     if (datashow) {
         fftwf_free(datashow);
     }
-    fftwf_cleanup();
-
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_cleanup_threads();
-    }
-#endif
 }
 
 void ImProcFunctions::maskcalccol(bool invmask, bool pde, int bfw, int bfh, int xstart, int ystart, int sk, int cx, int cy, LabImage* bufcolorig, LabImage* bufmaskblurcol, LabImage* originalmaskcol, LabImage* original, LabImage* reserved, int inv, struct local_params & lp,
@@ -7179,11 +7170,9 @@ void ImProcFunctions::exposure_pde(float * dataor, float * datain, float * datao
 
     //BENCHFUN
 #ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
-
+    const int fftwThreads = multiThread ? omp_get_max_threads() : 1;
+#else
+    constexpr int fftwThreads = 1;
 #endif
     float *data_fft, *data_tmp, *data;
 
@@ -7204,8 +7193,8 @@ void ImProcFunctions::exposure_pde(float * dataor, float * datain, float * datao
         abort();
     }
 
-    const auto dct_fw = fftwf_plan_r2r_2d(bfh, bfw, data_tmp, data_fft, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_fw);
+    const auto dct_fw = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, data_tmp, data_fft, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, fftwThreads);
+    fftwf_execute_r2r(dct_fw.get(), data_tmp, data_fft);
 
     fftwf_free(data_tmp);
 
@@ -7213,18 +7202,9 @@ void ImProcFunctions::exposure_pde(float * dataor, float * datain, float * datao
     /* 1. / (float) (bfw * bfh)) is the DCT normalisation term, see libfftw */
     ImProcFunctions::rex_poisson_dct(data_fft, bfw, bfh, 1. / (double)(bfw * bfh));
 
-    const auto dct_bw = fftwf_plan_r2r_2d(bfh, bfw, data_fft, data, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_bw);
-    fftwf_destroy_plan(dct_fw);
-    fftwf_destroy_plan(dct_bw);
+    const auto dct_bw = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, data_fft, data, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, fftwThreads);
+    fftwf_execute_r2r(dct_bw.get(), data_fft, data);
     fftwf_free(data_fft);
-    fftwf_cleanup();
-
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_cleanup_threads();
-    }
-#endif
 
     normalize_mean_dt(data, dataor, bfw * bfh, mod, 1.f);
     {
@@ -7265,18 +7245,15 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
     //BENCHFUN
 
 #ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
+    const int fftwThreads = multiThread ? omp_get_max_threads() : 1;
+#else
+    constexpr int fftwThreads = 1;
 #endif
 
 
     float *out; //for FFT data
     float *kern = nullptr;//for kernel gauss
     float *outkern = nullptr;//for FFT kernel
-    fftwf_plan p;
-    fftwf_plan pkern;//plan for FFT
     int image_size, image_sizechange;
     float n_x = 1.f;
     float n_y = 1.f;//relative coordinates for kernel Gauss
@@ -7292,10 +7269,8 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
 
     /*compute the Fourier transform of the input data*/
 
-    p = fftwf_plan_r2r_2d(bfh, bfw, input, out, FFTW_REDFT10, FFTW_REDFT10,  FFTW_ESTIMATE);//FFT 2 dimensions forward  FFTW_MEASURE FFTW_ESTIMATE
-
-    fftwf_execute(p);
-    fftwf_destroy_plan(p);
+    const auto p = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, input, out, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE, fftwThreads);//FFT 2 dimensions forward  FFTW_MEASURE FFTW_ESTIMATE
+    fftwf_execute_r2r(p.get(), input, out);
 
     /*define the gaussian constants for the convolution kernel*/
     if (algo == 0) {
@@ -7329,9 +7304,8 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
         }
 
         /*compute the Fourier transform of the kernel data*/
-        pkern = fftwf_plan_r2r_2d(bfh, bfw, kern, outkern, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE); //FFT 2 dimensions forward
-        fftwf_execute(pkern);
-        fftwf_destroy_plan(pkern);
+        const auto pkern = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, kern, outkern, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE, fftwThreads); //FFT 2 dimensions forward
+        fftwf_execute_r2r(pkern.get(), kern, outkern);
 
 #ifdef _OPENMP
         #pragma omp parallel for if (multiThread)
@@ -7375,8 +7349,8 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
         }
     }
 
-    p = fftwf_plan_r2r_2d(bfh, bfw, out, output, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);//FFT 2 dimensions backward
-    fftwf_execute(p);
+    const auto pback = FFTWPlanCache::getInstance().getR2R2D(bfh, bfw, out, output, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE, fftwThreads);//FFT 2 dimensions backward
+    fftwf_execute_r2r(pback.get(), out, output);
 
 #ifdef _OPENMP
     #pragma omp parallel for if (multiThread)
@@ -7385,14 +7359,7 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
         output[index] /= image_sizechange;
     }
 
-    fftwf_destroy_plan(p);
     fftwf_free(out);
-
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_cleanup_threads();
-    }
-#endif
 }
 
 void ImProcFunctions::fftw_convol_blur2(float **input2, float **output2, int bfw, int bfh, float radius, int fftkern, int algo)
@@ -7442,28 +7409,18 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
 {
     //BENCHFUN
     float epsil = 0.001f / (tilssize * tilssize);
-    fftwf_plan plan_forward_blox[2];
-    fftwf_plan plan_backward_blox[2];
+    FFTWPlanCache::Plan plan_forward_blox[2];
+    FFTWPlanCache::Plan plan_backward_blox[2];
 
     array2D<float> tilemask_in(tilssize, tilssize);
     array2D<float> tilemask_out(tilssize, tilssize);
 
-    float *Lbloxtmp  = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * tilssize * tilssize * sizeof(float)));
-    float *fLbloxtmp = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * tilssize * tilssize * sizeof(float)));
-
-    int nfwd[2] = {tilssize, tilssize};
-
-    //for DCT:
-    fftw_r2r_kind fwdkind[2] = {FFTW_REDFT10, FFTW_REDFT10};
-    fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
-
-    // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-    plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, tilssize * tilssize, fLbloxtmp, nullptr, 1, tilssize * tilssize, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, tilssize * tilssize, Lbloxtmp, nullptr, 1, tilssize * tilssize, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, tilssize * tilssize, fLbloxtmp, nullptr, 1, tilssize * tilssize, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, tilssize * tilssize, Lbloxtmp, nullptr, 1, tilssize * tilssize, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    fftwf_free(Lbloxtmp);
-    fftwf_free(fLbloxtmp);
+    // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit, the plan cache makes this a one-time cost
+    FFTWPlanCache& planCache = FFTWPlanCache::getInstance();
+    plan_forward_blox[0]  = planCache.getManyR2R2D(tilssize, tilssize, max_numblox_W, FFTW_REDFT10, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+    plan_backward_blox[0] = planCache.getManyR2R2D(tilssize, tilssize, max_numblox_W, FFTW_REDFT01, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+    plan_forward_blox[1]  = planCache.getManyR2R2D(tilssize, tilssize, min_numblox_W, FFTW_REDFT10, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+    plan_backward_blox[1] = planCache.getManyR2R2D(tilssize, tilssize, min_numblox_W, FFTW_REDFT01, FFTW_MEASURE | FFTW_DESTROY_INPUT);
     const int border = rtengine::max(2, tilssize / 16);
 
     for (int i = 0; i < tilssize; ++i) {
@@ -7569,9 +7526,9 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
 
             //fftwf_print_plan (plan_forward_blox);
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_forward_blox[0], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[0].get(), Lblox, fLblox);    // DCT an entire row of tiles
             } else {
-                fftwf_execute_r2r(plan_forward_blox[1], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[1].get(), Lblox, fLblox);    // DCT an entire row of tiles
             }
 
             const float n_xy = rtengine::SQR(rtengine::RT_PI / tilssize);
@@ -7591,9 +7548,9 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
 
             //now perform inverse FT of an entire row of blocks
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_backward_blox[0], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[0].get(), fLblox, Lblox);    //for DCT
             } else {
-                fftwf_execute_r2r(plan_backward_blox[1], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[1].get(), fLblox, Lblox);    //for DCT
             }
 
             int topproc = (vblk - 1) * offset;
@@ -7634,12 +7591,6 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
         fftwf_free(LbloxArray[i]);
         fftwf_free(fLbloxArray[i]);
     }
-
-    fftwf_destroy_plan(plan_forward_blox[0]);
-    fftwf_destroy_plan(plan_backward_blox[0]);
-    fftwf_destroy_plan(plan_forward_blox[1]);
-    fftwf_destroy_plan(plan_backward_blox[1]);
-    fftwf_cleanup();
 }
 
 void ImProcFunctions::wavcbd(wavelet_decomposition &wdspot, int level_bl, int maxlvl,
@@ -8740,29 +8691,20 @@ void ImProcFunctions::fftw_denoise(int sk, int GW, int GH, int max_numblox_W, in
 {
    // BENCHFUN
 
-    fftwf_plan plan_forward_blox[2];
-    fftwf_plan plan_backward_blox[2];
+    FFTWPlanCache::Plan plan_forward_blox[2];
+    FFTWPlanCache::Plan plan_backward_blox[2];
 
     array2D<float> tilemask_in(TS, TS);
     array2D<float> tilemask_out(TS, TS);
 
-    float *Lbloxtmp  = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
-    float *fLbloxtmp = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
     float params_Ldetail = 0.f;
 
-    int nfwd[2] = {TS, TS};
-
-    //for DCT:
-    fftw_r2r_kind fwdkind[2] = {FFTW_REDFT10, FFTW_REDFT10};
-    fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
-
-    // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-    plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    fftwf_free(Lbloxtmp);
-    fftwf_free(fLbloxtmp);
+    // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit, the plan cache makes this a one-time cost
+    FFTWPlanCache& planCache = FFTWPlanCache::getInstance();
+    plan_forward_blox[0]  = planCache.getManyR2R2D(TS, TS, max_numblox_W, FFTW_REDFT10, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+    plan_backward_blox[0] = planCache.getManyR2R2D(TS, TS, max_numblox_W, FFTW_REDFT01, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+    plan_forward_blox[1]  = planCache.getManyR2R2D(TS, TS, min_numblox_W, FFTW_REDFT10, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+    plan_backward_blox[1] = planCache.getManyR2R2D(TS, TS, min_numblox_W, FFTW_REDFT01, FFTW_MEASURE | FFTW_DESTROY_INPUT);
     const int border = rtengine::max(2, TS / 16);
 
     for (int i = 0; i < TS; ++i) {
@@ -8877,9 +8819,9 @@ void ImProcFunctions::fftw_denoise(int sk, int GW, int GH, int max_numblox_W, in
 
             //fftwf_print_plan (plan_forward_blox);
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_forward_blox[0], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[0].get(), Lblox, fLblox);    // DCT an entire row of tiles
             } else {
-                fftwf_execute_r2r(plan_forward_blox[1], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[1].get(), Lblox, fLblox);    // DCT an entire row of tiles
             }
 
             // now process the vblk row of blocks for noise reduction
@@ -8907,9 +8849,9 @@ void ImProcFunctions::fftw_denoise(int sk, int GW, int GH, int max_numblox_W, in
 
             //now perform inverse FT of an entire row of blocks
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_backward_blox[0], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[0].get(), fLblox, Lblox);    //for DCT
             } else {
-                fftwf_execute_r2r(plan_backward_blox[1], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[1].get(), fLblox, Lblox);    //for DCT
             }
 
             int topproc = (vblk - 1) * offset;
@@ -8996,14 +8938,6 @@ void ImProcFunctions::fftw_denoise(int sk, int GW, int GH, int max_numblox_W, in
         fftwf_free(LbloxArray[i]);
         fftwf_free(fLbloxArray[i]);
     }
-
-    fftwf_destroy_plan(plan_forward_blox[0]);
-    fftwf_destroy_plan(plan_backward_blox[0]);
-    fftwf_destroy_plan(plan_forward_blox[1]);
-    fftwf_destroy_plan(plan_backward_blox[1]);
-    fftwf_cleanup();
-
-
 }
 
 void ImProcFunctions::DeNoise(int call, float * slidL, float * slida, float * slidb, int aut,  bool noiscfactiv, const struct local_params & lp, LabImage * originalmaskbl, LabImage *  bufmaskblurbl, int levred, float huerefblur, float lumarefblur, float chromarefblur, LabImage * original, LabImage * transformed, int cx, int cy, int sk, const LocwavCurve& locwavCurvehue, bool locwavhueutili)
@@ -11256,6 +11190,8 @@ void ImProcFunctions::Lab_Local(
         return;
     }
 
+    TraceScope trace("ImProcFunctions::Lab_Local", original->W, original->H);
+
     //BENCHFUN
 
     constexpr int del = 3; // to avoid crash with [loy - begy] and [lox - begx] and bfh bfw  // with gtk2 [loy - begy-1] [lox - begx -1 ] and del = 1
@@ -27,6 +27,7 @@
 #include "rtengine.h"
 #include "rtlensfun.h"
 #include "sleef.h"
+#include "tracer.h"
 
 using namespace std;
 
@@ -653,6 +654,8 @@ void ImProcFunctions::transform (Imagefloat* original, Imagefloat* transformed,
                                  const FramesMetaData *metadata,
                                  int rawRotationDeg, bool fullImage, bool useOriginalBuffer)
 {
+    TraceScope trace("ImProcFunctions::transform", oW, oH);
+
     double focalLen = metadata->getFocalLen();
     double focalLen35mm = metadata->getFocalLen35mm();
     float focusDist = metadata->getFocusDist();
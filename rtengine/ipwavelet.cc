@@ -43,6 +43,7 @@
 #include "rt_math.h"
 #include "rtengine.h"
 #include "sleef.h"
+#include "tracer.h"
 #include "../rtgui/options.h"
 #include "guidedfilter.h"
 #ifdef _OPENMP
@@ -217,6 +218,8 @@ void ImProcFunctions::ip_wavelet(LabImage * lab, LabImage * dst, int kall, const
 
 
 {
+    TraceScope trace("ImProcFunctions::ip_wavelet", lab->W, lab->H);
+
     TMatrix wiprof = ICCStore::getInstance()->workingSpaceInverseMatrix(params->icm.workingProfile);
     const double wip[3][3] = {
         {wiprof[0][0], wiprof[0][1], wiprof[0][2]},
@@ -18,8 +18,10 @@
  */
 
 #include <memory>
+#include <new>
 
 #include "labimage.h"
+#include "planepool.h"
 
 namespace rtengine
 {
@@ -90,7 +92,16 @@ void LabImage::allocLab(size_t w, size_t h)
     a = new float*[h];
     b = new float*[h];
 
-    data = new float [w * h * 3];
+    data = static_cast<float*>(PlanePool::acquire(w * h * 3 * sizeof(float)));
+
+    if (!data) {
+        delete [] L;
+        delete [] a;
+        delete [] b;
+        throw std::bad_alloc();
+    }
+
+    memoryTag.set(w * h * 3 * sizeof(float));
     float * index = data;
 
     for (size_t i = 0; i < h; i++) {
@@ -115,7 +126,8 @@ void LabImage::deleteLab()
     delete [] L;
     delete [] a;
     delete [] b;
-    delete [] data;
+    PlanePool::release(data, static_cast<std::size_t>(W) * H * 3 * sizeof(float));
+    memoryTag.set(0);
 }
 
 void LabImage::reallocLab()
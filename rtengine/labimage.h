@@ -20,6 +20,8 @@
 
 #include <cstring>
 
+#include "memoryaccounting.h"
+
 namespace rtengine
 {
 
@@ -28,6 +30,8 @@ class LabImage final
 private:
     void allocLab(size_t w, size_t h);
 
+    MemoryTag memoryTag;
+
 public:
     int W, H;
     float * data;
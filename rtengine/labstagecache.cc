@@ -0,0 +1,151 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <mutex>
+#include <new>
+
+#include "labstagecache.h"
+
+#include "labimage.h"
+#include "procparams.h"
+
+namespace
+{
+
+// Shared by all the caches, which are used by the updater thread and the detail window threads
+std::mutex mutex;
+std::size_t limit = 0;
+std::size_t usedBytes = 0;
+std::list<rtengine::LabStageCache*> lru; // most recently used first
+
+}
+
+rtengine::LabStageCache::LabStageCache(SameParams sameParams) :
+    sameParams(sameParams),
+    variant(0),
+    bytes(0)
+{
+}
+
+rtengine::LabStageCache::~LabStageCache()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    drop();
+}
+
+void rtengine::LabStageCache::setLimit(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    limit = bytes;
+
+    while (usedBytes > limit) {
+        lru.back()->drop();
+    }
+}
+
+void rtengine::LabStageCache::invalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    drop();
+}
+
+bool rtengine::LabStageCache::restore(const procparams::ProcParams& params, int variant, LabImage& dst)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!output || output->W != dst.W || output->H != dst.H || variant != this->variant || !sameParams(params, *this->params)) {
+        return false;
+    }
+
+    dst.CopyFrom(output.get());
+    lru.splice(lru.begin(), lru, lruPosition);
+
+    return true;
+}
+
+void rtengine::LabStageCache::store(const procparams::ProcParams& params, int variant, const LabImage& src)
+{
+    const std::size_t srcBytes = static_cast<std::size_t>(src.W) * src.H * 3 * sizeof(float);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    drop();
+
+    if (srcBytes > limit) {
+        return;
+    }
+
+    while (usedBytes + srcBytes > limit) {
+        lru.back()->drop();
+    }
+
+    try {
+        output.reset(new LabImage(src, true));
+    } catch (const std::bad_alloc&) {
+        return;
+    }
+
+    if (!this->params) {
+        this->params.reset(new procparams::ProcParams);
+    }
+
+    *this->params = params;
+    this->variant = variant;
+    bytes = srcBytes;
+    usedBytes += bytes;
+    lru.push_front(this);
+    lruPosition = lru.begin();
+}
+
+void rtengine::LabStageCache::drop()
+{
+    if (output) {
+        output.reset();
+        usedBytes -= bytes;
+        bytes = 0;
+        lru.erase(lruPosition);
+    }
+}
+
+bool rtengine::sameLabAdjustmentsParams(const procparams::ProcParams& lhs, const procparams::ProcParams& rhs)
+{
+    return
+        lhs.labCurve == rhs.labCurve
+        && lhs.toneCurve == rhs.toneCurve
+        && lhs.colorToning == rhs.colorToning
+        && lhs.blackwhite == rhs.blackwhite
+        && lhs.colorappearance == rhs.colorappearance
+        && lhs.dirpyrDenoise == rhs.dirpyrDenoise
+        && lhs.icm == rhs.icm
+        && lhs.vibrance == rhs.vibrance
+        && lhs.epd == rhs.epd
+        && lhs.localContrast == rhs.localContrast
+        && lhs.locallab == rhs.locallab
+        && lhs.dirpyrequalizer == rhs.dirpyrequalizer
+        && lhs.ppVersion == rhs.ppVersion;
+}
+
+bool rtengine::sameCropLabAdjustmentsParams(const procparams::ProcParams& lhs, const procparams::ProcParams& rhs)
+{
+    return
+        sameLabAdjustmentsParams(lhs, rhs)
+        && lhs.impulseDenoise == rhs.impulseDenoise
+        && lhs.defringe == rhs.defringe
+        && lhs.sharpenEdge == rhs.sharpenEdge
+        && lhs.sharpenMicro == rhs.sharpenMicro
+        && lhs.sharpening == rhs.sharpening;
+}
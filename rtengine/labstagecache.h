@@ -0,0 +1,88 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+class LabImage;
+
+namespace procparams
+{
+
+class ProcParams;
+
+}
+
+/**
+ * Cache of the output of a stage of the L*a*b* pipeline.
+ *
+ * The refresh map invalidates the pipeline from a coarse stage on, so changing a wavelet parameter
+ * (M_LUMINANCE) also runs again the curves, tone mapping, sharpening and contrast by detail levels
+ * preceding the wavelets. A LabStageCache keeps the output of such a group of tools together with
+ * the parameters it was computed with. Its owner invalidates it when the input of the stage changes,
+ * and restores the output instead of running the tools if the parameters they read are unchanged.
+ *
+ * The memory of all the stage caches is bounded by setLimit(), the least recently used outputs are
+ * dropped first.
+ */
+class LabStageCache final :
+    public NonCopyable
+{
+public:
+    /** Returns true if the tools of the stage give the same output with both parameters. */
+    using SameParams = bool (*)(const procparams::ProcParams& lhs, const procparams::ProcParams& rhs);
+
+    explicit LabStageCache(SameParams sameParams);
+    ~LabStageCache();
+
+    /** Sets the maximum number of bytes kept by all the stage caches, 0 disables them. */
+    static void setLimit(std::size_t bytes);
+
+    /** Drops the cached output, to be called when the input of the stage changed. */
+    void invalidate();
+    /**
+     * Copies the cached output into dst if it has the same size and was computed with the same parameters
+     * and variant (any other input of the tools, which is not part of the parameters). Returns true if so.
+     */
+    bool restore(const procparams::ProcParams& params, int variant, LabImage& dst);
+    /** Keeps a copy of src, the output of the stage computed with params and variant. */
+    void store(const procparams::ProcParams& params, int variant, const LabImage& src);
+
+private:
+    void drop();
+
+    const SameParams sameParams;
+    std::unique_ptr<LabImage> output;
+    std::unique_ptr<procparams::ProcParams> params;
+    int variant;
+    std::size_t bytes;
+    std::list<LabStageCache*>::iterator lruPosition; // valid while output is set
+};
+
+/** LabStageCache::SameParams of the L*a*b* adjustments preceding the wavelets of the preview. */
+bool sameLabAdjustmentsParams(const procparams::ProcParams& lhs, const procparams::ProcParams& rhs);
+/** Same as above for the crops, which also run the impulse denoise, defringe and sharpening tools. */
+bool sameCropLabAdjustmentsParams(const procparams::ProcParams& lhs, const procparams::ProcParams& rhs);
+
+}
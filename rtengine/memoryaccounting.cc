@@ -0,0 +1,185 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+#include "memoryaccounting.h"
+
+namespace
+{
+
+thread_local const char* currentStage = nullptr;
+
+constexpr const char* NO_STAGE = "(no stage)";
+
+}
+
+std::atomic<bool> rtengine::MemoryAccounting::enabled(false);
+
+rtengine::MemoryAccounting& rtengine::MemoryAccounting::getInstance()
+{
+    // Never destroyed, static containers may release their buffer after it would be
+    static MemoryAccounting* const instance = new MemoryAccounting;
+    return *instance;
+}
+
+std::size_t rtengine::MemoryAccounting::getCurrent() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+std::size_t rtengine::MemoryAccounting::getPeak() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return peak;
+}
+
+std::vector<rtengine::MemoryAccounting::Usage> rtengine::MemoryAccounting::getUsage() const
+{
+    std::vector<Usage> res;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto& stage : stages) {
+            res.push_back({stage.name, stage.current, stage.peak, stage.atTotalPeak});
+        }
+    }
+
+    std::sort(
+        res.begin(),
+        res.end(),
+        [](const Usage& lhs, const Usage& rhs) -> bool
+        {
+            return lhs.atTotalPeak > rhs.atTotalPeak || (lhs.atTotalPeak == rhs.atTotalPeak && lhs.peak > rhs.peak);
+        }
+    );
+
+    return res;
+}
+
+void rtengine::MemoryAccounting::resetPeaks()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    peak = current;
+
+    for (auto& stage : stages) {
+        stage.peak = stage.current;
+        stage.atTotalPeak = stage.current;
+    }
+}
+
+void rtengine::MemoryAccounting::printSummary(std::ostream& stream) const
+{
+    const std::vector<Usage> usage = getUsage();
+    const auto oldFlags = stream.flags();
+    const auto oldPrecision = stream.precision();
+    constexpr double MiB = 1024.0 * 1024.0;
+
+    stream << std::left << std::setw(48) << "Stage" << std::right << std::setw(14) << "Current (MiB)" << std::setw(12) << "Peak (MiB)" << std::setw(20) << "At total peak (MiB)" << std::endl;
+    stream << std::fixed << std::setprecision(1);
+
+    for (const auto& stage : usage) {
+        stream
+            << std::left << std::setw(48) << stage.stage
+            << std::right << std::setw(14) << stage.current / MiB
+            << std::setw(12) << stage.peak / MiB
+            << std::setw(20) << stage.atTotalPeak / MiB
+            << std::endl;
+    }
+
+    stream << std::left << std::setw(48) << "Total" << std::right << std::setw(14) << getCurrent() / MiB << std::setw(12) << getPeak() / MiB << std::endl;
+
+    stream.flags(oldFlags);
+    stream.precision(oldPrecision);
+}
+
+rtengine::MemoryAccounting::MemoryAccounting() :
+    current(0),
+    peak(0)
+{
+}
+
+unsigned int rtengine::MemoryAccounting::charge(std::size_t bytes)
+{
+    const char* const name = currentStage ? currentStage : NO_STAGE;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Stages are few, and usually found by their address
+    unsigned int index = 0;
+
+    while (index < stages.size() && stages[index].name != name && std::strcmp(stages[index].name, name)) {
+        ++index;
+    }
+
+    if (index == stages.size()) {
+        stages.push_back({name, 0, 0, 0});
+    }
+
+    Stage& stage = stages[index];
+    stage.current += bytes;
+    stage.peak = std::max(stage.peak, stage.current);
+    current += bytes;
+
+    if (current > peak) {
+        peak = current;
+
+        for (auto& s : stages) {
+            s.atTotalPeak = s.current;
+        }
+    }
+
+    return index;
+}
+
+void rtengine::MemoryAccounting::release(unsigned int stage, std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    stages[stage].current -= bytes;
+    current -= bytes;
+}
+
+rtengine::MemoryStage::MemoryStage(const char* name) :
+    previous(currentStage)
+{
+    currentStage = name;
+}
+
+rtengine::MemoryStage::~MemoryStage()
+{
+    currentStage = previous;
+}
+
+void rtengine::MemoryTag::update(std::size_t newBytes)
+{
+    MemoryAccounting& accounting = MemoryAccounting::getInstance();
+
+    if (bytes) {
+        accounting.release(stage, bytes);
+        bytes = 0;
+    }
+
+    if (newBytes && MemoryAccounting::isEnabled()) {
+        stage = accounting.charge(newBytes);
+        bytes = newBytes;
+    }
+}
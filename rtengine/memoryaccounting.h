@@ -0,0 +1,163 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/**
+ * Accounting of the memory held by the image containers (AlignedBuffer and thus the Image8, Image16
+ * and Imagefloat planes, array2D, LabImage and CieImage), per pipeline stage.
+ *
+ * A buffer is charged to the innermost MemoryStage (or TraceScope) that is active on the thread
+ * allocating it, and stays charged to that stage until it is freed, whichever stage frees it.
+ * Buffers allocated by OpenMP worker threads, or outside of any stage, are charged to
+ * "(no stage)". For each stage the current and peak bytes are kept, as well as the bytes it held
+ * when the total reached its peak, which tells which buffers were alive at the peak.
+ *
+ * When disabled, the containers only pay for an atomic load per allocation.
+ */
+class MemoryAccounting final :
+    public NonCopyable
+{
+public:
+    struct Usage {
+        std::string stage;
+        std::size_t current;
+        std::size_t peak;
+        std::size_t atTotalPeak;
+    };
+
+    static MemoryAccounting& getInstance();
+
+    static void setEnabled(bool enabled)
+    {
+        MemoryAccounting::enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    static bool isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    std::size_t getCurrent() const;
+    std::size_t getPeak() const;
+    /** Returns the usage of each stage, by decreasing bytes held at the peak of the total. */
+    std::vector<Usage> getUsage() const;
+    /** Restarts the peaks from the current usage. */
+    void resetPeaks();
+
+    void printSummary(std::ostream& stream) const;
+
+private:
+    friend class MemoryTag;
+
+    struct Stage {
+        const char* name;
+        std::size_t current;
+        std::size_t peak;
+        std::size_t atTotalPeak;
+    };
+
+    MemoryAccounting();
+
+    unsigned int charge(std::size_t bytes);
+    void release(unsigned int stage, std::size_t bytes);
+
+    static std::atomic<bool> enabled;
+
+    mutable std::mutex mutex;
+    std::vector<Stage> stages;
+    std::size_t current;
+    std::size_t peak;
+};
+
+/**
+ * Makes the calling thread charge its allocations to the stage called name during its lifetime.
+ * name must have static storage duration. Stages nest, the innermost one is charged.
+ */
+class MemoryStage final :
+    public NonCopyable
+{
+public:
+    explicit MemoryStage(const char* name);
+    ~MemoryStage();
+
+private:
+    const char* const previous;
+};
+
+/**
+ * Member of the image containers, holding the bytes charged for their buffer.
+ * A copy of a tag is uncharged, as the copied container owns a buffer of its own.
+ */
+class MemoryTag final
+{
+public:
+    MemoryTag() :
+        stage(0),
+        bytes(0)
+    {
+    }
+
+    MemoryTag(const MemoryTag&) :
+        MemoryTag()
+    {
+    }
+
+    MemoryTag& operator =(const MemoryTag&)
+    {
+        return *this;
+    }
+
+    ~MemoryTag()
+    {
+        set(0);
+    }
+
+    /** Records that the owner now holds newBytes, charged to the current stage of the calling thread. */
+    void set(std::size_t newBytes)
+    {
+        if (bytes || (newBytes && MemoryAccounting::isEnabled())) {
+            update(newBytes);
+        }
+    }
+
+    void swap(MemoryTag& other)
+    {
+        std::swap(stage, other.stage);
+        std::swap(bytes, other.bytes);
+    }
+
+private:
+    void update(std::size_t newBytes);
+
+    unsigned int stage;
+    std::size_t bytes;
+};
+
+}
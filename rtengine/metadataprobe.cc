@@ -0,0 +1,597 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include <strings.h>
+
+#include <glib/gstdio.h>
+
+#include "metadataprobe.h"
+
+namespace
+{
+
+// Limits against corrupted or hostile files
+constexpr unsigned int MAX_IFDS = 64;
+constexpr unsigned int MAX_IFD_ENTRIES = 1000;
+constexpr unsigned int MAX_SUB_IFDS = 16;
+constexpr unsigned int MAX_STRING_LENGTH = 1024;
+
+struct IfdEntry {
+    std::uint16_t tag;
+    std::uint16_t type;
+    std::uint32_t count;
+    const unsigned char* value; // the 4 bytes holding the value or its offset
+};
+
+// Reads the tags of a TIFF structure by seeking to them, the image data is never read
+class TiffReader final
+{
+public:
+    explicit TiffReader(FILE* f) :
+        f(f),
+        size(0),
+        bigEndian(false)
+    {
+        if (!fseek(f, 0, SEEK_END)) {
+            const long end = ftell(f);
+            size = end > 0 ? end : 0;
+        }
+    }
+
+    // Returns the offset of the first IFD, or 0 if this is not a TIFF structure
+    std::uint32_t readHeader()
+    {
+        unsigned char header[8];
+
+        if (!read(0, header, sizeof(header))) {
+            return 0;
+        }
+
+        if (header[0] == 'I' && header[1] == 'I') {
+            bigEndian = false;
+        } else if (header[0] == 'M' && header[1] == 'M') {
+            bigEndian = true;
+        } else {
+            return 0;
+        }
+
+        const std::uint16_t magic = get2(header + 2);
+
+        // TIFF, Olympus ORF ("RO" and "RS") and Panasonic RW2
+        if (magic != 42 && magic != 0x4f52 && magic != 0x5352 && magic != 0x55) {
+            return 0;
+        }
+
+        return get4(header + 4);
+    }
+
+    // Reads the entries of the IFD at offset into buffer, returns the offset of the next IFD
+    std::uint32_t readIfd(std::uint32_t offset, std::vector<unsigned char>& buffer, std::vector<IfdEntry>& entries)
+    {
+        entries.clear();
+
+        unsigned char countBytes[2];
+
+        if (!read(offset, countBytes, sizeof(countBytes))) {
+            return 0;
+        }
+
+        const unsigned int count = get2(countBytes);
+
+        if (count == 0 || count > MAX_IFD_ENTRIES) {
+            return 0;
+        }
+
+        buffer.resize(count * 12 + 4);
+
+        if (!read(offset + 2, buffer.data(), buffer.size())) {
+            return 0;
+        }
+
+        for (unsigned int i = 0; i < count; ++i) {
+            const unsigned char* const entry = buffer.data() + i * 12;
+            entries.push_back({get2(entry), get2(entry + 2), get4(entry + 4), entry + 8});
+        }
+
+        return get4(buffer.data() + count * 12);
+    }
+
+    std::string getString(const IfdEntry& entry)
+    {
+        if (entry.type != 2 && entry.type != 1 && entry.type != 7) {
+            return {};
+        }
+
+        const std::uint32_t length = std::min<std::uint32_t>(entry.count, MAX_STRING_LENGTH);
+        std::string result(length, '\0');
+
+        if (!getValue(entry, &result[0], length)) {
+            return {};
+        }
+
+        result.resize(std::min(result.find('\0'), result.size()));
+        result.erase(result.find_last_not_of(' ') + 1);
+
+        return Glib::ustring(result).validate() ? result : "???";
+    }
+
+    double getDouble(const IfdEntry& entry, std::uint32_t index = 0)
+    {
+        const unsigned int elementSize = typeSize(entry.type);
+
+        if (!elementSize || index >= entry.count) {
+            return 0.0;
+        }
+
+        unsigned char value[8];
+
+        if (!getValue(entry, value, elementSize, index * elementSize)) {
+            return 0.0;
+        }
+
+        switch (entry.type) {
+            case 1:
+            case 7: {
+                return value[0];
+            }
+
+            case 6: {
+                return static_cast<signed char>(value[0]);
+            }
+
+            case 3: {
+                return get2(value);
+            }
+
+            case 8: {
+                return static_cast<std::int16_t>(get2(value));
+            }
+
+            case 4:
+            case 13: {
+                return get4(value);
+            }
+
+            case 9: {
+                return static_cast<std::int32_t>(get4(value));
+            }
+
+            case 5: {
+                const std::uint32_t denominator = get4(value + 4);
+                return denominator ? static_cast<double>(get4(value)) / denominator : 0.0;
+            }
+
+            case 10: {
+                const std::int32_t denominator = get4(value + 4);
+                return denominator ? static_cast<double>(static_cast<std::int32_t>(get4(value))) / denominator : 0.0;
+            }
+
+            case 11: {
+                const std::uint32_t bits = get4(value);
+                float result;
+                memcpy(&result, &bits, sizeof(result));
+                return result;
+            }
+
+            case 12: {
+                const std::uint64_t bits = bigEndian
+                    ? static_cast<std::uint64_t>(get4(value)) << 32 | get4(value + 4)
+                    : static_cast<std::uint64_t>(get4(value + 4)) << 32 | get4(value);
+                double result;
+                memcpy(&result, &bits, sizeof(result));
+                return result;
+            }
+
+            default: {
+                return 0.0;
+            }
+        }
+    }
+
+private:
+    static unsigned int typeSize(std::uint16_t type)
+    {
+        static constexpr unsigned int sizes[14] = {0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8, 4};
+        return type < 14 ? sizes[type] : 0;
+    }
+
+    bool read(std::uint32_t offset, void* dst, std::size_t count)
+    {
+        return
+            offset < size
+            && count <= size - offset
+            && !fseek(f, offset, SEEK_SET)
+            && fread(dst, 1, count, f) == count;
+    }
+
+    // Copies count bytes of the value of entry, starting at byte start
+    bool getValue(const IfdEntry& entry, void* dst, std::size_t count, std::size_t start = 0)
+    {
+        const std::uint64_t valueSize = static_cast<std::uint64_t>(entry.count) * typeSize(entry.type);
+
+        if (start + count > valueSize) {
+            return false;
+        }
+
+        if (valueSize <= 4) {
+            memcpy(dst, entry.value + start, count);
+            return true;
+        }
+
+        return read(get4(entry.value) + start, dst, count);
+    }
+
+    std::uint16_t get2(const unsigned char* p) const
+    {
+        return bigEndian ? p[0] << 8 | p[1] : p[1] << 8 | p[0];
+    }
+
+    std::uint32_t get4(const unsigned char* p) const
+    {
+        return bigEndian
+            ? static_cast<std::uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]
+            : static_cast<std::uint32_t>(p[3]) << 24 | p[2] << 16 | p[1] << 8 | p[0];
+    }
+
+    FILE* const f;
+    std::uint32_t size;
+    bool bigEndian;
+};
+
+class Prober final
+{
+public:
+    Prober(FILE* f, rtengine::ProbedMetaData& data) :
+        reader(f),
+        data(data),
+        next(0),
+        orientationFound(false),
+        exposureTimeFound(false),
+        fNumberFound(false),
+        shutterSpeedValueFound(false),
+        apertureValueFound(false),
+        recommendedExposureIndex(0)
+    {
+    }
+
+    bool probe()
+    {
+        std::uint32_t offset = reader.readHeader();
+
+        // The IFD chain, usually the thumbnails and for some formats the raw data
+        while (offset && parseIfd(offset, false)) {
+            offset = next;
+        }
+
+        if (make.empty()) {
+            return false;
+        }
+
+        data.make = rtengine::simplifyMake(make);
+        data.model = rtengine::simplifyModel(data.make, model);
+
+        if (data.model.empty()) {
+            // FramesData then looks for a UniqueCameraModel tag in the frame
+            data.model = "Unknown";
+            data.needsFullMetaData = true;
+        }
+
+        const bool isoOutOfRange = data.isoSpeed == 65535 || data.isoSpeed == 0;
+
+        if (!data.make.compare(0, 4, "SONY") && isoOutOfRange && recommendedExposureIndex) {
+            data.isoSpeed = recommendedExposureIndex;
+        }
+
+        // FramesData takes these from the maker notes
+        if ((!data.make.compare(0, 5, "NIKON") || !data.make.compare(0, 5, "Canon")) && isoOutOfRange) {
+            data.needsFullMetaData = true;
+        }
+
+        if (!data.make.compare(0, 6, "PENTAX") || (!data.make.compare(0, 5, "RICOH") && !data.model.compare(0, 6, "PENTAX"))) {
+            data.needsFullMetaData = true; // ISO and focal length
+        }
+
+        // Without ExposureTime or FNumber, FramesData uses ShutterSpeedValue or ApertureValue as is, in APEX units
+        if ((shutterSpeedValueFound && !exposureTimeFound) || (apertureValueFound && !fNumberFound)) {
+            data.needsFullMetaData = true;
+        }
+
+        if (!lensModel.empty()) {
+            data.lens = lensMake.empty() ? lensModel : lensMake + ' ' + lensModel;
+        }
+
+        return true;
+    }
+
+private:
+    bool parseIfd(std::uint32_t offset, bool isExif)
+    {
+        if (visited.size() >= MAX_IFDS || !visited.insert(offset).second) {
+            return false;
+        }
+
+        std::vector<unsigned char> buffer;
+        std::vector<IfdEntry> entries;
+        next = reader.readIfd(offset, buffer, entries);
+
+        if (entries.empty()) {
+            return false;
+        }
+
+        const std::uint32_t ifdNext = next;
+        int width = 0;
+        int height = 0;
+
+        for (const auto& entry : entries) {
+            if (isExif) {
+                parseExifTag(entry);
+                continue;
+            }
+
+            switch (entry.tag) {
+                case 0x0100: {
+                    width = reader.getDouble(entry);
+                    break;
+                }
+
+                case 0x0101: {
+                    height = reader.getDouble(entry);
+                    break;
+                }
+
+                case 0x010f: {
+                    if (make.empty()) {
+                        make = reader.getString(entry);
+                    }
+                    break;
+                }
+
+                case 0x0110: {
+                    if (model.empty()) {
+                        model = reader.getString(entry);
+                    }
+                    break;
+                }
+
+                case 0x0112: {
+                    if (!orientationFound) {
+                        data.orientation = reader.getDouble(entry);
+                        orientationFound = true;
+                    }
+                    break;
+                }
+
+                case 0x014a: {
+                    for (std::uint32_t i = 0; i < std::min<std::uint32_t>(entry.count, MAX_SUB_IFDS); ++i) {
+                        const std::uint32_t subIfd = reader.getDouble(entry, i);
+
+                        if (subIfd) {
+                            parseIfd(subIfd, false);
+                        }
+                    }
+                    break;
+                }
+
+                case 0x8769: {
+                    const std::uint32_t exifIfd = reader.getDouble(entry);
+
+                    if (exifIfd) {
+                        parseIfd(exifIfd, true);
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (static_cast<long>(width) * height > static_cast<long>(data.width) * data.height) {
+            data.width = width;
+            data.height = height;
+        }
+
+        next = ifdNext;
+        return true;
+    }
+
+    void parseExifTag(const IfdEntry& entry)
+    {
+        switch (entry.tag) {
+            case 0x829a: {
+                data.shutterSpeed = reader.getDouble(entry);
+                exposureTimeFound = true;
+                break;
+            }
+
+            case 0x829d: {
+                data.fNumber = reader.getDouble(entry);
+                fNumberFound = true;
+                break;
+            }
+
+            // ShutterSpeedValue and ApertureValue, see probe()
+            case 0x9201: {
+                shutterSpeedValueFound = true;
+                break;
+            }
+
+            case 0x9202: {
+                apertureValueFound = true;
+                break;
+            }
+
+            case 0x9204: {
+                data.expComp = reader.getDouble(entry);
+                break;
+            }
+
+            case 0x920a: {
+                data.focalLen = reader.getDouble(entry);
+                break;
+            }
+
+            case 0xa405: {
+                data.focalLen35mm = reader.getDouble(entry);
+                break;
+            }
+
+            case 0x8827: {
+                data.isoSpeed = reader.getDouble(entry);
+                break;
+            }
+
+            case 0x8832: {
+                recommendedExposureIndex = reader.getDouble(entry);
+                break;
+            }
+
+            case 0x9003: {
+                const std::string dateTime = reader.getString(entry);
+                tm& time = data.dateTime;
+
+                if (sscanf(dateTime.c_str(), "%d:%d:%d %d:%d:%d", &time.tm_year, &time.tm_mon, &time.tm_mday, &time.tm_hour, &time.tm_min, &time.tm_sec) == 6) {
+                    time.tm_year -= 1900;
+                    time.tm_mon -= 1;
+                    time.tm_isdst = -1;
+                    mktime(&time);
+                    data.dateTimeValid = true;
+                }
+                break;
+            }
+
+            case 0xa433: {
+                lensMake = reader.getString(entry);
+                break;
+            }
+
+            case 0xa434: {
+                lensModel = reader.getString(entry);
+                break;
+            }
+        }
+    }
+
+    TiffReader reader;
+    rtengine::ProbedMetaData& data;
+    std::set<std::uint32_t> visited;
+    std::uint32_t next;
+    std::string make;
+    std::string model;
+    std::string lensMake;
+    std::string lensModel;
+    bool orientationFound;
+    bool exposureTimeFound;
+    bool fNumberFound;
+    bool shutterSpeedValueFound;
+    bool apertureValueFound;
+    int recommendedExposureIndex;
+};
+
+}
+
+bool rtengine::probeMetaData(const Glib::ustring& fname, ProbedMetaData& data)
+{
+    FILE* const f = g_fopen(fname.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    data = {};
+    const bool res = Prober(f, data).probe();
+
+    fclose(f);
+
+    return res;
+}
+
+std::string rtengine::simplifyMake(const std::string& make)
+{
+    std::string res = make;
+
+    // Same dcraw treatment
+    for (const auto& corp : {
+        "Canon",
+        "NIKON",
+        "EPSON",
+        "KODAK",
+        "Kodak",
+        "OLYMPUS",
+        "PENTAX",
+        "RICOH",
+        "MINOLTA",
+        "Minolta",
+        "Konica",
+        "CASIO",
+        "Sinar",
+        "Phase One",
+        "SAMSUNG",
+        "Mamiya",
+        "MOTOROLA",
+        "Leaf",
+        "Panasonic"
+    }) {
+        if (res.find(corp) != std::string::npos) { // Simplify company names
+            res = corp;
+            break;
+        }
+    }
+
+    res.erase(res.find_last_not_of(' ') + 1);
+
+    return res;
+}
+
+std::string rtengine::simplifyModel(const std::string& make, const std::string& model)
+{
+    std::string res = model;
+
+    if (res.empty()) {
+        return res;
+    }
+
+    std::string::size_type i = 0;
+
+    if (
+        make.find("KODAK") != std::string::npos
+        && (
+            (i = res.find(" DIGITAL CAMERA")) != std::string::npos
+            || (i = res.find(" Digital Camera")) !=  std::string::npos
+            || (i = res.find("FILE VERSION")) !=  std::string::npos
+        )
+    ) {
+        res.resize(i);
+    }
+
+    res.erase(res.find_last_not_of(' ') + 1);
+
+    if (!strncasecmp(res.c_str(), make.c_str(), make.size())) {
+        if (res.size() >= make.size() && res[make.size()] == ' ') {
+            res.erase(0, make.size() + 1);
+        }
+    }
+
+    if (res.find("Digital Camera ") != std::string::npos) {
+        res.erase(0, 15);
+    }
+
+    return res;
+}
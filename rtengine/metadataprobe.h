@@ -0,0 +1,72 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <ctime>
+#include <string>
+
+#include <glibmm/ustring.h>
+
+namespace rtengine
+{
+
+/**
+ * The shooting data of a file, as read by probeMetaData().
+ *
+ * The values are the standard EXIF ones, the maker notes are not parsed. The make and model
+ * are simplified the same way as in FramesData, but the lens is only the EXIF LensMake and
+ * LensModel (empty if missing), which may differ from the lens FramesData finds in the maker notes.
+ */
+struct ProbedMetaData {
+    std::string make;
+    std::string model;
+    std::string lens;
+    int isoSpeed = 0;
+    double fNumber = 0.0;
+    double focalLen = 0.0;
+    double focalLen35mm = 0.0;
+    double shutterSpeed = 0.0;
+    double expComp = 0.0;
+    tm dateTime = {};
+    bool dateTimeValid = false;
+    int orientation = 1; // the EXIF value, 1 to 8
+    int width = 0; // size of the largest image in the file, usually the raw data
+    int height = 0;
+    // True if FramesData may find other values for this file, from the maker notes (ISO and focal
+    // length of some makes), from other tags (missing model) or in other units (shutter speed and
+    // aperture in APEX only), so results must come from FramesData
+    bool needsFullMetaData = false;
+
+    std::string getCamera() const
+    {
+        return make + " " + model;
+    }
+};
+
+/**
+ * Reads the shooting data of a TIFF based file (TIFF, DNG and most raw formats) from the
+ * IFD chain, its SubIFDs and the EXIF IFD only, without identifying the raw data or building
+ * the EXIF tag tree. Returns false for the other formats or if the file has no Make tag.
+ */
+bool probeMetaData(const Glib::ustring& fname, ProbedMetaData& data);
+
+/** Simplifies the company name of make the same way as dcraw. */
+std::string simplifyMake(const std::string& make);
+/** Removes the make and the redundant words from model. */
+std::string simplifyModel(const std::string& make, const std::string& model);
+
+}
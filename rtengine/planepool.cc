@@ -0,0 +1,152 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdlib>
+#include <iterator>
+
+#include "planepool.h"
+
+constexpr std::size_t rtengine::PlanePool::MIN_POOLED_SIZE;
+
+rtengine::PlanePool& rtengine::PlanePool::getInstance()
+{
+    // Never destroyed, static containers may release their blocks after it would be
+    static PlanePool* const instance = new PlanePool;
+    return *instance;
+}
+
+void* rtengine::PlanePool::acquire(std::size_t size)
+{
+    if (size < MIN_POOLED_SIZE) {
+        return malloc(size);
+    }
+
+    const std::size_t classSize = getClassSize(size);
+    void* const block = getInstance().get(classSize);
+
+    return block ? block : malloc(classSize);
+}
+
+void rtengine::PlanePool::release(void* block, std::size_t size)
+{
+    if (!block) {
+        return;
+    }
+
+    if (size < MIN_POOLED_SIZE) {
+        free(block);
+    } else {
+        getInstance().put(block, getClassSize(size));
+    }
+}
+
+void rtengine::PlanePool::setLimit(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    limit = bytes;
+    trim();
+}
+
+void rtengine::PlanePool::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (const auto& block : blocks) {
+        free(block.data);
+    }
+
+    blocks.clear();
+    blocksBySize.clear();
+    cachedBytes = 0;
+}
+
+std::size_t rtengine::PlanePool::getCachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cachedBytes;
+}
+
+rtengine::PlanePool::PlanePool() :
+    limit(0),
+    cachedBytes(0)
+{
+}
+
+std::size_t rtengine::PlanePool::getClassSize(std::size_t size)
+{
+    std::size_t octave = MIN_POOLED_SIZE;
+
+    while (octave <= size / 2) {
+        octave *= 2;
+    }
+
+    const std::size_t step = octave / 8;
+
+    return (size + step - 1) / step * step;
+}
+
+void* rtengine::PlanePool::get(std::size_t classSize)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = blocksBySize.find(classSize);
+
+    if (it == blocksBySize.end()) {
+        return nullptr;
+    }
+
+    void* const block = it->second->data;
+    cachedBytes -= classSize;
+    blocks.erase(it->second);
+    blocksBySize.erase(it);
+
+    return block;
+}
+
+void rtengine::PlanePool::put(void* block, std::size_t classSize)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (classSize > limit) {
+        free(block);
+        return;
+    }
+
+    blocks.push_front({block, classSize});
+    blocksBySize.emplace(classSize, blocks.begin());
+    cachedBytes += classSize;
+    trim();
+}
+
+void rtengine::PlanePool::trim()
+{
+    while (cachedBytes > limit) {
+        const Block oldest = blocks.back();
+        const auto range = blocksBySize.equal_range(oldest.size);
+
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == std::prev(blocks.end())) {
+                blocksBySize.erase(it);
+                break;
+            }
+        }
+
+        blocks.pop_back();
+        cachedBytes -= oldest.size;
+        free(oldest.data);
+    }
+}
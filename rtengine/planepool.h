@@ -0,0 +1,131 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+#include <new>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/**
+ * Process-wide pool of the large blocks backing the image planes.
+ *
+ * The pipelines allocate and free multi-megabyte planes on every run (and Locallab per spot and
+ * per tool). Large blocks are mmapped and unmapped by the C library each time, so every run pays
+ * for the page faults and the kernel's zeroing of the pages again. Freed blocks of at least
+ * MIN_POOLED_SIZE bytes are therefore kept, up to the limit set with setLimit(), and handed out
+ * again to requests of the same size class. The least recently freed blocks are dropped first.
+ *
+ * Size classes are 1/8 of a power of two apart, so a block wastes at most 12.5% of its size.
+ * Smaller blocks, and all blocks while the limit is 0 (the default), use malloc() and free().
+ * Blocks are not cleared.
+ */
+class PlanePool final :
+    public NonCopyable
+{
+public:
+    static constexpr std::size_t MIN_POOLED_SIZE = 1 << 20;
+
+    static PlanePool& getInstance();
+
+    /** Returns a block of at least size bytes, as aligned as malloc() does, or nullptr on failure. */
+    static void* acquire(std::size_t size);
+    /** Gives back a block returned by acquire(size). */
+    static void release(void* block, std::size_t size);
+
+    /** Sets the maximum number of bytes kept in the pool, 0 disables pooling. */
+    void setLimit(std::size_t bytes);
+    /** Frees all the blocks kept in the pool. */
+    void clear();
+
+    std::size_t getCachedBytes() const;
+
+private:
+    struct Block {
+        void* data;
+        std::size_t size;
+    };
+
+    using BlockList = std::list<Block>;
+
+    PlanePool();
+
+    static std::size_t getClassSize(std::size_t size);
+
+    void* get(std::size_t classSize);
+    void put(void* block, std::size_t classSize);
+    void trim();
+
+    mutable std::mutex mutex;
+    std::size_t limit;
+    std::size_t cachedBytes;
+    BlockList blocks; // most recently freed first
+    std::multimap<std::size_t, BlockList::iterator> blocksBySize;
+};
+
+/**
+ * Allocator taking the storage of standard containers from the PlanePool.
+ */
+template<typename T>
+class PlanePoolAllocator
+{
+public:
+    using value_type = T;
+
+    PlanePoolAllocator() = default;
+
+    template<typename U>
+    PlanePoolAllocator(const PlanePoolAllocator<U>&)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        void* const block = PlanePool::acquire(n * sizeof(T));
+
+        if (!block) {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<T*>(block);
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        PlanePool::release(p, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator ==(const PlanePoolAllocator<U>&) const
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator !=(const PlanePoolAllocator<U>&) const
+    {
+        return false;
+    }
+};
+
+}
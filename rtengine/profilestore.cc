@@ -23,6 +23,7 @@
 #include "profilestore.h"
 
 #include "dynamicprofile.h"
+#include "metadataprobe.h"
 #include "procparams.h"
 
 #include "../rtgui/options.h"
@@ -522,23 +523,59 @@ PartialProfile *ProfileStore::loadDynamicProfile (const FramesMetaData *im)
 
     for (auto rule : dynamicRules) {
         if (rule.matches (im)) {
-            if (settings->verbose) {
-                printf ("found matching profile %s\n", rule.profilepath.c_str());
-            }
+            applyDynamicRule (rule, ret);
+        }
+    }
 
-            const PartialProfile *p = getProfile (rule.profilepath);
+    return ret;
+}
 
-            if (p != nullptr) {
-                p->applyTo (ret->pparams);
-            } else {
-                printf ("ERROR loading matching profile from: %s\n", rule.profilepath.c_str());
-            }
+PartialProfile *ProfileStore::loadDynamicProfile (const ProbedMetaData &data)
+{
+    if (storeState == STORESTATE_NOTINITIALIZED) {
+        parseProfilesOnce();
+    }
+
+    if (!rulesLoaded) {
+        loadRules();
+    }
+
+    if (data.needsFullMetaData) {
+        return nullptr;
+    }
+
+    for (const auto &rule : dynamicRules) {
+        if (rule.needsFullMetaData()) {
+            return nullptr;
+        }
+    }
+
+    PartialProfile *ret = new PartialProfile (true, true);
+
+    for (const auto &rule : dynamicRules) {
+        if (rule.matches (data)) {
+            applyDynamicRule (rule, ret);
         }
     }
 
     return ret;
 }
 
+void ProfileStore::applyDynamicRule (const DynamicProfileRule &rule, PartialProfile *profile)
+{
+    if (settings->verbose) {
+        printf ("found matching profile %s\n", rule.profilepath.c_str());
+    }
+
+    const PartialProfile *p = getProfile (rule.profilepath);
+
+    if (p != nullptr) {
+        p->applyTo (profile->pparams);
+    } else {
+        printf ("ERROR loading matching profile from: %s\n", rule.profilepath.c_str());
+    }
+}
+
 ProfileStoreEntry::ProfileStoreEntry() : type (PSET_FOLDER), parentFolderId (0), folderId (0) {}
 
 ProfileStoreEntry::ProfileStoreEntry (Glib::ustring label, PSEType type, unsigned short parentFolder, unsigned short folder) : label (label), type (type), parentFolderId (parentFolder), folderId (folder) {}
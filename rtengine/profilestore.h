@@ -41,6 +41,8 @@ class PartialProfile;
 
 }
 
+struct ProbedMetaData;
+
 }
 
 class DynamicProfileRule;
@@ -177,6 +179,9 @@ private:
     void clearFileList ();
     void clearProfileList ();
     const ProfileStoreEntry* findEntryFromFullPathU (Glib::ustring path);
+    /** @brief Applies the profile of a matching dynamic profile rule to profile
+     */
+    void applyDynamicRule (const DynamicProfileRule &rule, rtengine::procparams::PartialProfile *profile);
 
 public:
 
@@ -210,6 +215,8 @@ public:
     void removeListener (ProfileStoreListener *listener);
 
     rtengine::procparams::PartialProfile*        loadDynamicProfile (const rtengine::FramesMetaData *im);
+    /** Same as above from the data of probeMetaData(), returns nullptr if a rule needs the full metadata */
+    rtengine::procparams::PartialProfile*        loadDynamicProfile (const rtengine::ProbedMetaData &data);
 
     void dumpFolderList();
 };
@@ -18,12 +18,15 @@
  */
 #include <cmath>
 #include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 #include "camconst.h"
 #include "color.h"
 #include "curves.h"
 #include "dcp.h"
+#include "demosaiccache.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
 #include "iccmatrices.h"
@@ -41,6 +44,7 @@
 #include "rt_math.h"
 #include "rtengine.h"
 #include "rtlensfun.h"
+#include "tracer.h"
 #include "../rtgui/options.h"
 
 #define BENCHMARK
@@ -417,6 +421,35 @@ void transLineD1x (const float* const red, const float* const green, const float
     }
 }
 
+// Serializes all the raw parameters, they all have an influence on the output of preprocessing and demosaicing
+std::string getRawParamsKey(const rtengine::procparams::RAWParams& raw)
+{
+    const auto& bayer = raw.bayersensor;
+    const auto& xtrans = raw.xtranssensor;
+
+    std::ostringstream key;
+    key << std::setprecision(17)
+        << bayer.method << ';' << bayer.border << ';' << bayer.imageNum << ';' << bayer.ccSteps << ';'
+        << bayer.black0 << ';' << bayer.black1 << ';' << bayer.black2 << ';' << bayer.black3 << ';' << bayer.twogreen << ';'
+        << bayer.linenoise << ';' << int(bayer.linenoiseDirection) << ';' << bayer.greenthresh << ';'
+        << bayer.dcb_iterations << ';' << bayer.dcb_enhance << ';' << bayer.lmmse_iterations << ';'
+        << bayer.dualDemosaicAutoContrast << ';' << bayer.dualDemosaicContrast << ';'
+        << int(bayer.pixelShiftMotionCorrectionMethod) << ';' << bayer.pixelShiftEperIso << ';' << bayer.pixelShiftSigma << ';'
+        << bayer.pixelShiftShowMotion << ';' << bayer.pixelShiftShowMotionMaskOnly << ';' << bayer.pixelShiftHoleFill << ';'
+        << bayer.pixelShiftMedian << ';' << bayer.pixelShiftGreen << ';' << bayer.pixelShiftBlur << ';' << bayer.pixelShiftSmoothFactor << ';'
+        << bayer.pixelShiftEqualBright << ';' << bayer.pixelShiftEqualBrightChannel << ';' << bayer.pixelShiftNonGreenCross << ';'
+        << bayer.pixelShiftDemosaicMethod << ';' << bayer.pdafLinesFilter << ';'
+        << xtrans.method << ';' << xtrans.dualDemosaicAutoContrast << ';' << xtrans.dualDemosaicContrast << ';' << xtrans.border << ';'
+        << xtrans.ccSteps << ';' << xtrans.blackred << ';' << xtrans.blackgreen << ';' << xtrans.blackblue << ';'
+        << raw.dark_frame << ';' << raw.df_autoselect << ';'
+        << raw.ff_file << ';' << raw.ff_AutoSelect << ';' << raw.ff_BlurRadius << ';' << raw.ff_BlurType << ';'
+        << raw.ff_AutoClipControl << ';' << raw.ff_clipControl << ';'
+        << raw.ca_autocorrect << ';' << raw.ca_avoidcolourshift << ';' << raw.caautoiterations << ';' << raw.cared << ';' << raw.cablue << ';'
+        << raw.expos << ';' << int(raw.preprocessWB.mode) << ';'
+        << raw.hotPixelFilter << ';' << raw.deadPixelFilter << ';' << raw.hotdeadpix_thresh;
+    return key.str();
+}
+
 }
 
 
@@ -688,6 +721,8 @@ void RawImageSource::getWBMults (const ColorTemp &ctemp, const RAWParams &raw, s
 
 void RawImageSource::getImage (const ColorTemp &ctemp, int tran, Imagefloat* image, const PreviewProps &pp, const ToneCurveParams &hrp, const RAWParams &raw)
 {
+    TraceScope trace("RawImageSource::getImage", image->getWidth(), image->getHeight());
+
     MyMutex::MyLock lock(getImageMutex);
 
     tran = defTransform (tran);
@@ -1060,6 +1095,7 @@ void RawImageSource::vflip (Imagefloat* image)
 
 int RawImageSource::load (const Glib::ustring &fname, bool firstFrameOnly)
 {
+    TraceScope trace("RawImageSource::load");
 
     MyTime t1, t2;
     t1.set();
@@ -1278,6 +1314,8 @@ int RawImageSource::load (const Glib::ustring &fname, bool firstFrameOnly)
 
 void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &lensProf, const CoarseTransformParams& coarse, bool prepareDenoise)
 {
+    TraceScope trace("RawImageSource::preprocess", W, H);
+
 //    BENCHFUN
     MyTime t1, t2;
     t1.set();
@@ -1609,6 +1647,26 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         printf("Preprocessing: %d usec\n", t2.etime(t1));
     }
 
+    // Identify the raw file and the preprocessing inputs which are not part of the raw parameters,
+    // demosaic() completes this with the raw parameters to build the demosaic cache key
+    demosaicCacheKey.clear();
+
+    if (DemosaicCache::getInstance().isEnabled()) {
+        const std::string fileHash = DemosaicCache::getFileHash(fileName);
+
+        if (!fileHash.empty()) {
+            std::ostringstream key;
+            key << fileHash << ';' << currFrame << ';' << (rid ? rid->get_filename() : std::string()) << ';' << (rif ? rif->get_filename() : std::string());
+
+            if (!hasFlatField && lensProf.useVign && lensProf.lcMode != LensProfParams::LcMode::NONE) {
+                key << ';' << int(lensProf.lcMode) << ';' << lensProf.lcpFile << ';' << lensProf.lfCameraMake << ';' << lensProf.lfCameraModel << ';' << lensProf.lfLens
+                    << ';' << coarse.rotate << ';' << coarse.hflip << ';' << coarse.vflip;
+            }
+
+            demosaicCacheKey = key.str();
+        }
+    }
+
     rawDirty = true;
     return;
 }
@@ -1616,10 +1674,20 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
 
 void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &contrastThreshold, bool cache)
 {
+    TraceScope trace("RawImageSource::demosaic", W, H);
+
     MyTime t1, t2;
     t1.set();
 
-    if (ri->getSensorType() == ST_BAYER) {
+    const std::string cacheKey = demosaicCacheKey.empty() ? std::string() : demosaicCacheKey + ';' + getRawParamsKey(raw) + ';' + (autoContrast ? '1' : '0');
+    double cachedContrastThreshold = contrastThreshold;
+    const bool fromCache = !cacheKey.empty() && DemosaicCache::getInstance().get(cacheKey, red, green, blue, cachedContrastThreshold);
+
+    if (fromCache) {
+        if (autoContrast) {
+            contrastThreshold = cachedContrastThreshold;
+        }
+    } else if (ri->getSensorType() == ST_BAYER) {
         if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::HPHD)) {
             hphd_demosaic ();
         } else if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::VNG4)) {
@@ -1683,6 +1751,10 @@ void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &c
         nodemosaic(true);
     }
 
+    if (!fromCache && !cacheKey.empty()) {
+        DemosaicCache::getInstance().put(cacheKey, red, green, blue, contrastThreshold);
+    }
+
     t2.set();
 
 
@@ -21,6 +21,7 @@
 #include <array>
 #include <iostream>
 #include <memory>
+#include <string>
 
 #include "array2D.h"
 #include "colortemp.h"
@@ -100,6 +101,7 @@ protected:
     // the interpolated blue plane:
     array2D<float>* blueCache;
     bool rawDirty;
+    std::string demosaicCacheKey; // identifies the input of demosaic() in the demosaic cache, set by preprocess()
     float psRedBrightness[4];
     float psGreenBrightness[4];
     float psBlueBrightness[4];
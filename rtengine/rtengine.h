@@ -695,6 +695,18 @@ public:
    * @return the resulting image, with the output profile applied, exif and iptc data set. You have to save it or you can access the pixel data directly.  */
 IImagefloat* processImage (ProcessingJob* job, int& errorCode, ProgressListener* pl = nullptr, bool flush = false);
 
+/** Like processImage(), but writes the result to a TIFF file. When the enabled tools allow it, the end of the pipeline runs over
+   * horizontal bands which are written as soon as they are ready, so that the memory needed after the RGB stage depends on the
+   * band height instead of the image height. Otherwise the image is processed as a whole and saved.
+   * The ProcessingJob passed becomes invalid, you can not use it any more.
+   * @param job the ProcessingJob to process.
+   * @param errorCode is the error code if an error occurred during the processing (e.g. the input image could not be loaded etc.)
+   * @param fname is the name of the TIFF file to write
+   * @param bps, isFloat, uncompressed have the same meaning as for IImagefloat::saveAsTIFF()
+   * @param pl is an optional ProgressListener if you want to keep track of the progress
+   * @return 0 if the file has been written, an error code otherwise */
+int processImageToTIFF (ProcessingJob* job, int& errorCode, const Glib::ustring& fname, int bps, bool isFloat, bool uncompressed, ProgressListener* pl = nullptr);
+
 /** This class is used to control the batch processing. The class implementing this interface will be called when the full processing of an
    * image is ready and the next job to process is needed. */
 class BatchProcessingListener : public ProgressListener
@@ -316,32 +316,36 @@ bool LFLens::hasCACorrection() const
 LFDatabase LFDatabase::instance_;
 
 
-bool LFDatabase::init(const Glib::ustring &dbdir)
+void LFDatabase::init(const Glib::ustring &dbdir)
 {
-    instance_.data_ = lfDatabase::Create();
+    instance_.dbdir_ = dbdir;
+}
+
+
+void LFDatabase::load()
+{
+    data_ = lfDatabase::Create();
 
     if (settings->verbose) {
         std::cout << "Loading lensfun database from ";
-        if (dbdir.empty()) {
+        if (dbdir_.empty()) {
             std::cout << "the default directories";
         } else {
-            std::cout << "'" << dbdir << "'";
+            std::cout << "'" << dbdir_ << "'";
         }
         std::cout << "..." << std::flush;
     }
 
     bool ok = false;
-    if (dbdir.empty()) {
-        ok = (instance_.data_->Load() ==  LF_NO_ERROR);
+    if (dbdir_.empty()) {
+        ok = (data_->Load() ==  LF_NO_ERROR);
     } else {
-        ok = instance_.LoadDirectory(dbdir.c_str());
+        ok = LoadDirectory(dbdir_.c_str());
     }
 
     if (settings->verbose) {
         std::cout << (ok ? "OK" : "FAIL") << std::endl;
     }
-    
-    return ok;
 }
 
 
@@ -399,6 +403,8 @@ LFDatabase::~LFDatabase()
 
 const LFDatabase *LFDatabase::getInstance()
 {
+    // Loaded on first use, so the runs not using the lensfun corrections do not pay for it
+    std::call_once(instance_.loaded_, [] { instance_.load(); });
     return &instance_;
 }
 
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 
@@ -113,7 +114,8 @@ class LFDatabase final :
     public NonCopyable
 {
 public:
-    static bool init(const Glib::ustring &dbdir);
+    /** Only records the directory, the database is loaded by the first getInstance(). */
+    static void init(const Glib::ustring &dbdir);
     static const LFDatabase *getInstance();
 
     ~LFDatabase();
@@ -136,10 +138,13 @@ private:
                                             float focalLen, float aperture, float focusDist,
                                             int width, int height, bool swap_xy) const;
     LFDatabase();
+    void load();
     bool LoadDirectory(const char *dirname);
 
     mutable MyMutex lfDBMutex;
     static LFDatabase instance_;
+    Glib::ustring dbdir_;
+    std::once_flag loaded_;
     lfDatabase *data_;
     mutable std::set<std::string> notFound;
 };
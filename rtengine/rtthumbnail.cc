@@ -425,13 +425,20 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
     img->setSampleArrangement (IIOSA_CHUNKY);
 
     int err = 1;
+    int fullWidth = 0;
+    int fullHeight = 0;
 
     // See if it is something we support
     if (checkRawImageThumb (*ri)) {
         const char* data ((const char*)fdata (ri->get_thumbOffset(), ri->get_file()));
 
         if ( (unsigned char)data[1] == 0xd8 ) {
-            err = img->loadJPEGFromMemory (data, ri->get_thumbLength());
+            if (inspectorMode) {
+                err = img->loadJPEGFromMemory (data, ri->get_thumbLength());
+            } else {
+                // Embedded previews are often full sized, only decode what the thumbnail needs
+                err = img->loadJPEGFromMemory (data, ri->get_thumbLength(), fixwh == 1 ? 0 : w, fixwh == 1 ? h : 0, &fullWidth, &fullHeight);
+            }
         } else if (ri->is_ppmThumb()) {
             err = img->loadPPMFromMemory (data, ri->get_thumbWidth(), ri->get_thumbHeight(), ri->get_thumbSwap(), ri->get_thumbBPS());
         }
@@ -470,12 +477,18 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
             return tpp;
         }
     } else {
+        // The scale relates the thumbnail to the embedded image, not to its decoded size
+        if (fullWidth <= 0 || fullHeight <= 0) {
+            fullWidth = img->getWidth();
+            fullHeight = img->getHeight();
+        }
+
         if (fixwh == 1) {
-            w = h * img->getWidth() / img->getHeight();
-            tpp->scale = (double)img->getHeight() / h;
+            w = h * fullWidth / fullHeight;
+            tpp->scale = (double)fullHeight / h;
         } else {
-            h = w * img->getHeight() / img->getWidth();
-            tpp->scale = (double)img->getWidth() / w;
+            h = w * fullHeight / fullWidth;
+            tpp->scale = (double)fullWidth / w;
         }
     }
 
@@ -1956,26 +1969,44 @@ bool Thumbnail::writeImage (const Glib::ustring& fname)
         return false;
     }
 
-    fwrite (thumbImg->getType(), sizeof (char), strlen (thumbImg->getType()), f);
-    fputc ('\n', f);
+    const bool success = writeImage (f);
+    fclose (f);
+    return success;
+}
+
+bool Thumbnail::writeImage (FILE* f)
+{
+
+    if (!thumbImg) {
+        return false;
+    }
+
+    // The results of the writes are checked rather than ferror(), which stays set on a FILE* reused after a failure
+    const size_t typeLength = strlen (thumbImg->getType());
     guint32 w = guint32 (thumbImg->getWidth());
     guint32 h = guint32 (thumbImg->getHeight());
-    fwrite (&w, sizeof (guint32), 1, f);
-    fwrite (&h, sizeof (guint32), 1, f);
+
+    if (
+        fwrite (thumbImg->getType(), sizeof (char), typeLength, f) != typeLength
+        || fputc ('\n', f) == EOF
+        || fwrite (&w, sizeof (guint32), 1, f) != 1
+        || fwrite (&h, sizeof (guint32), 1, f) != 1
+    ) {
+        return false;
+    }
 
     if (thumbImg->getType() == sImage8) {
         Image8 *image = static_cast<Image8*> (thumbImg);
-        image->writeData (f);
+        return image->writeData (f);
     } else if (thumbImg->getType() == sImage16) {
         Image16 *image = static_cast<Image16*> (thumbImg);
-        image->writeData (f);
+        return image->writeData (f);
     } else if (thumbImg->getType() == sImagefloat) {
         Imagefloat *image = static_cast<Imagefloat*> (thumbImg);
-        image->writeData (f);
+        return image->writeData (f);
     }
 
     //thumbImg->writeData(f);
-    fclose (f);
     return true;
 }
 
@@ -1999,8 +2030,25 @@ bool Thumbnail::readImage (const Glib::ustring& fname)
         return false;
     }
 
+    const bool success = readImage (f);
+    fclose(f);
+    return success;
+}
+
+bool Thumbnail::readImage (FILE* f)
+{
+
+    if (thumbImg) {
+        delete thumbImg;
+        thumbImg = nullptr;
+    }
+
     char imgType[31];  // 30 -> arbitrary size, but should be enough for all image type's name
-    fgets(imgType, 30, f);
+
+    if (!fgets(imgType, 30, f) || !imgType[0]) {
+        return false;
+    }
+
     imgType[strlen(imgType) - 1] = '\0'; // imgType has a \n trailing character, so we overwrite it by the \0 char
 
     guint32 width, height;
@@ -2035,7 +2083,6 @@ bool Thumbnail::readImage (const Glib::ustring& fname)
             printf ("readImage: Unsupported image type \"%s\"!\n", imgType);
         }
     }
-    fclose(f);
     return success;
 }
 
@@ -2250,27 +2297,39 @@ bool Thumbnail::readEmbProfile  (const Glib::ustring& fname)
     FILE* f = g_fopen (fname.c_str (), "rb");
 
     if (f) {
+        bool success = false;
+
         if (!fseek (f, 0, SEEK_END)) {
             int profileLength = ftell (f);
 
-            if (profileLength > 0) {
-                embProfileLength = profileLength;
-
-                if (!fseek (f, 0, SEEK_SET)) {
-                    embProfileData = new unsigned char[embProfileLength];
-                    embProfileLength = fread (embProfileData, 1, embProfileLength, f);
-                    embProfile = cmsOpenProfileFromMem (embProfileData, embProfileLength);
-                }
+            if (profileLength > 0 && !fseek (f, 0, SEEK_SET)) {
+                success = readEmbProfile (f, profileLength);
             }
         }
 
         fclose (f);
-        return embProfile != nullptr;
+        return success;
     }
 
     return false;
 }
 
+bool Thumbnail::readEmbProfile (FILE* f, std::size_t length)
+{
+
+    embProfileData = nullptr;
+    embProfile = nullptr;
+    embProfileLength = 0;
+
+    if (length > 0) {
+        embProfileData = new unsigned char[length];
+        embProfileLength = fread (embProfileData, 1, length, f);
+        embProfile = cmsOpenProfileFromMem (embProfileData, embProfileLength);
+    }
+
+    return embProfile != nullptr;
+}
+
 bool Thumbnail::writeEmbProfile (const Glib::ustring& fname)
 {
 
@@ -2278,15 +2337,25 @@ bool Thumbnail::writeEmbProfile (const Glib::ustring& fname)
         FILE* f = g_fopen (fname.c_str (), "wb");
 
         if (f) {
-            fwrite (embProfileData, 1, embProfileLength, f);
+            const bool success = writeEmbProfile (f);
             fclose (f);
-            return true;
+            return success;
         }
     }
 
     return false;
 }
 
+bool Thumbnail::writeEmbProfile (FILE* f)
+{
+
+    if (!embProfileData) {
+        return false;
+    }
+
+    return fwrite (embProfileData, 1, embProfileLength, f) == static_cast<std::size_t>(embProfileLength);
+}
+
 unsigned char* Thumbnail::getImage8Data()
 {
     if (thumbImg && thumbImg->getType() == rtengine::sImage8) {
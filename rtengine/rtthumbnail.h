@@ -108,12 +108,21 @@ public:
     unsigned char* getGrayscaleHistEQ (int trim_width);
     bool writeImage (const Glib::ustring& fname);
     bool readImage (const Glib::ustring& fname);
+    // Same as above, at the current position of an open file
+    bool writeImage (FILE* f);
+    bool readImage (FILE* f);
 
     bool readData  (const Glib::ustring& fname);
     bool writeData  (const Glib::ustring& fname);
 
     bool readEmbProfile  (const Glib::ustring& fname);
     bool writeEmbProfile (const Glib::ustring& fname);
+    bool readEmbProfile  (FILE* f, std::size_t length);
+    bool writeEmbProfile (FILE* f);
+    bool hasEmbProfile () const
+    {
+        return embProfileData;
+    }
 
     unsigned char* getImage8Data();  // accessor to the 8bit image if it is one, which should be the case for the "Inspector" mode.
 
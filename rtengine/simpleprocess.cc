@@ -29,6 +29,10 @@
 #include "clutstore.h"
 #include "processingjob.h"
 #include "procparams.h"
+#include "tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <glibmm/ustring.h>
 #include <glibmm/thread.h>
 #include "../rtgui/options.h"
@@ -46,6 +50,9 @@ namespace rtengine
 namespace
 {
 
+// Height in rows of the bands of the streamed TIFF export, before adding the halo
+constexpr int STREAM_BAND_HEIGHT = 256;
+
 template <typename T>
 void adjust_radius(const T &default_param, double scale_factor, T &param)
 {
@@ -99,7 +106,21 @@ public:
         labView(nullptr),
         ctColorCurve(),
         autili(false),
-        butili(false)
+        butili(false),
+        utili(false),
+        clcutili(false),
+        ccutili(false),
+        cclutili(false),
+        opautili(false),
+        satLimit(0.f),
+        satLimitOpacity(0.f),
+        rrm(0.0),
+        ggm(0.0),
+        bbm(0.0),
+        autor(0.f),
+        autog(0.f),
+        autob(0.f),
+        dcpProf(nullptr)
     {
     }
 
@@ -112,6 +133,30 @@ public:
         }
     }
 
+    // Processes the image and writes it to fname as TIFF, returns an IMIO_* code
+    int operator()(const Glib::ustring &fname, int bps, bool isFloat, bool uncompressed)
+    {
+        if (!can_stream()) {
+            Imagefloat* const readyImg = (*this)();
+
+            if (!readyImg) {
+                return IMIO_CANNOTREADFILE;
+            }
+
+            const int result = readyImg->saveTIFF(fname, bps, isFloat, uncompressed);
+            delete readyImg;
+            return result;
+        }
+
+        if (!stage_init()) {
+            return IMIO_CANNOTREADFILE;
+        }
+
+        stage_denoise();
+        stage_transform();
+        return stage_finish_streamed(fname, bps, isFloat, uncompressed);
+    }
+
 private:
     Imagefloat *normal_pipeline()
     {
@@ -144,6 +189,8 @@ private:
 
     bool stage_init()
     {
+        TraceScope trace("ImageProcessor::stage_init");
+
         errorCode = 0;
 
         if (pl) {
@@ -804,6 +851,8 @@ private:
 
     void stage_denoise()
     {
+        TraceScope trace("ImageProcessor::stage_denoise", fw, fh);
+
         const procparams::ProcParams& params = job->pparams;
 
         DirPyrDenoiseParams denoiseParams = params.dirpyrDenoise;   // make a copy because we cheat here
@@ -859,6 +908,8 @@ private:
 
     void stage_transform()
     {
+        TraceScope trace("ImageProcessor::stage_transform", fw, fh);
+
         const procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -911,6 +962,8 @@ private:
 
     Imagefloat *stage_finish()
     {
+        TraceScope trace("ImageProcessor::stage_finish", fw, fh);
+
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -1206,78 +1259,11 @@ private:
         }
 
 
-        curve1(65536);
-        curve2(65536);
-        curve(65536, 0);
-        satcurve(65536, 0);
-        lhskcurve(65536, 0);
-        lumacurve(32770, 0);  // lumacurve[32768] and lumacurve[32769] will be set to 32768 and 32769 later to allow linear interpolation
-        clcurve(65536, 0);
-        wavclCurve(65536, 0);
-
-        //if(params.blackwhite.enabled) params.toneCurve.hrenabled=false;
-
-        CurveFactory::complexCurve(expcomp, black / 65535.0, hlcompr, hlcomprthresh, params.toneCurve.shcompr, bright, contr,
-                                   params.toneCurve.curve, params.toneCurve.curve2,
-                                   hist16, curve1, curve2, curve, dummy, customToneCurve1, customToneCurve2);
-
-        CurveFactory::RGBCurve(params.rgbCurves.rcurve, rCurve, 1);
-        CurveFactory::RGBCurve(params.rgbCurves.gcurve, gCurve, 1);
-        CurveFactory::RGBCurve(params.rgbCurves.bcurve, bCurve, 1);
-
-        bool opautili = false;
-
-        if (params.colorToning.enabled) {
-            TMatrix wprof = ICCStore::getInstance()->workingSpaceMatrix(params.icm.workingProfile);
-            double wp[3][3] = {
-                {wprof[0][0], wprof[0][1], wprof[0][2]},
-                {wprof[1][0], wprof[1][1], wprof[1][2]},
-                {wprof[2][0], wprof[2][1], wprof[2][2]}
-            };
-            params.colorToning.getCurves(ctColorCurve, ctOpacityCurve, wp, opautili);
-            clToningcurve(65536, 0);
-            CurveFactory::diagonalCurve2Lut(params.colorToning.clcurve, clToningcurve, 1);
-            cl2Toningcurve(65536, 0);
-            CurveFactory::diagonalCurve2Lut(params.colorToning.cl2curve, cl2Toningcurve, 1);
-        }
-
-//        labView = new LabImage(fw, fh);
-
-        if (params.blackwhite.enabled) {
-            CurveFactory::curveBW(params.blackwhite.beforeCurve, params.blackwhite.afterCurve, hist16, dummy, customToneCurvebw1, customToneCurvebw2, 1);
-        }
-
-        double rrm, ggm, bbm;
-        float autor, autog, autob;
-        float satLimit = float (params.colorToning.satProtectionThreshold) / 100.f * 0.7f + 0.3f;
-        float satLimitOpacity = 1.f - (float (params.colorToning.saturatedOpacity) / 100.f);
-
-        if (params.colorToning.enabled  && params.colorToning.autosat && params.colorToning.method != "LabGrid") { //for colortoning evaluation of saturation settings
-            float moyS = 0.f;
-            float eqty = 0.f;
-            ipf.moyeqt(baseImg, moyS, eqty); //return image : mean saturation and standard dev of saturation
-            float satp = ((moyS + 1.5f * eqty) - 0.3f) / 0.7f; //1.5 sigma ==> 93% pixels with high saturation -0.3 / 0.7 convert to Hombre scale
-
-            if (satp >= 0.92f) {
-                satp = 0.92f;    //avoid values too high (out of gamut)
-            }
-
-            if (satp <= 0.15f) {
-                satp = 0.15f;    //avoid too low values
-            }
-
-            satLimit = 100.f * satp;
-
-            satLimitOpacity = 100.f * (moyS - 0.85f * eqty); //-0.85 sigma==>20% pixels with low saturation
-        }
-
-        autor = -9000.f; // This will ask to compute the "auto" values for the B&W tool (have to be inferior to -5000)
-        DCPProfileApplyState as;
-        DCPProfile *dcpProf = imgsrc->getDCP(params.icm, as);
+        stage_rgb_curves();
 
         LUTu histToneCurve;
 
-        ipf.rgbProc(baseImg, labView, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve, options.chunkSizeRGB, options.measure);
+        ipf.rgbProc(baseImg, labView, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, dcpApplyState, histToneCurve, options.chunkSizeRGB, options.measure);
 
         if (settings->verbose) {
             printf ("Output image / Auto B&W coefs:   R=%.2f   G=%.2f   B=%.2f\n", static_cast<double>(autor), static_cast<double>(autog), static_cast<double>(autob));
@@ -1338,14 +1324,7 @@ private:
             }
         }
 
-        bool utili;
-        CurveFactory::complexLCurve(params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
-
-        const bool clcutili = CurveFactory::diagonalCurve2Lut(params.labCurve.clcurve, clcurve, 1);
-
-        bool ccutili, cclutili;
-        CurveFactory::complexsgnCurve(autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
-                                      params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 1);
+        stage_lab_curves();
 
         ipf.chromiLuminanceCurve(nullptr, 1, labView, labView, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
 
@@ -1715,6 +1694,207 @@ private:
             readyImg = tempImage;
         }
 
+        set_output_metadata(readyImg);
+
+//    t2.set();
+//    if( settings->verbose )
+//           printf("Total:- %d usec\n", t2.etime(t1));
+
+        if (!job->initialImage) {
+            initialImage->decreaseRef();
+        }
+
+        delete job;
+
+        if (pl) {
+            pl->setProgress(0.75);
+        }
+
+        /*  curve1.reset();curve2.reset();
+            curve.reset();
+            satcurve.reset();
+            lhskcurve.reset();
+
+            rCurve.reset();
+            gCurve.reset();
+            bCurve.reset();
+            hist16.reset();
+            hist16C.reset();
+        */
+        return readyImg;
+    }
+
+    // Whether all the tools enabled after the RGB stage only need a bounded neighbourhood of each row,
+    // which is what stage_finish_streamed() relies on
+    bool can_stream() const
+    {
+        const procparams::ProcParams& params = job->pparams;
+
+        return
+            !params.dirpyrequalizer.enabled
+            && !(params.locallab.enabled && !params.locallab.spots.empty())
+            && !params.sh.enabled
+            && !params.localContrast.enabled
+            && !params.blackwhite.enabled
+            && !(params.colorToning.enabled && params.colorToning.method == "LabRegions")
+            && params.labCurve.contrast == 0
+            && !params.epd.enabled
+            && !params.impulseDenoise.enabled
+            && !params.defringe.enabled
+            && !params.sharpenEdge.enabled
+            && !params.sharpenMicro.enabled
+            && !params.wavelet.enabled
+            && !params.colorappearance.enabled
+            && !params.resize.enabled;
+    }
+
+    // Number of rows the sharpening needs above and below a band to give the same result as on the whole image
+    int sharpening_halo() const
+    {
+        const procparams::SharpeningParams& sharpening = job->pparams.sharpening;
+
+        if (!sharpening.enabled || sharpening.amount < 1) {
+            return 0;
+        }
+
+        // the gaussian blurs are accounted with a support of 3 sigma
+        double radius = sharpening.blurradius >= 0.25 ? sharpening.blurradius : 0.0;
+
+        if (sharpening.method == "rld") {
+            // each iteration blurs twice
+            radius += 2.0 * sharpening.deconvradius * sharpening.deconviter;
+        } else {
+            radius += sharpening.radius + (sharpening.edgesonly ? sharpening.edges_radius : 0.0);
+        }
+
+        // + blend mask and halo control neighbourhoods
+        return std::ceil(3.0 * radius) + 4;
+    }
+
+    // Runs the RGB and Lab stages on rows [y0, y1) of baseImg, returns the rows converted to the output space
+    Imagefloat *process_band(int y0, int y1, int halo, int cx, int cw)
+    {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        const int top = std::max(y0 - halo, 0);
+        const int height = std::min(y1 + halo, fh) - top;
+
+        Imagefloat working(fw, height);
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int i = 0; i < height; ++i) {
+            std::copy(baseImg->r(top + i), baseImg->r(top + i) + fw, working.r(i));
+            std::copy(baseImg->g(top + i), baseImg->g(top + i) + fw, working.g(i));
+            std::copy(baseImg->b(top + i), baseImg->b(top + i) + fw, working.b(i));
+        }
+
+        LabImage lab(fw, height);
+        LUTu histToneCurve;
+        // the auto B&W and the mixer statistics are not used, B&W excludes streaming
+        double bandrm, bandgm, bandbm;
+        float bandautor = autor, bandautog = autog, bandautob = autob;
+
+        ipf.rgbProc(&working, &lab, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, bandrm, bandgm, bandbm, bandautor, bandautog, bandautob, expcomp, hlcompr, hlcomprthresh, dcpProf, dcpApplyState, histToneCurve, options.chunkSizeRGB, options.measure);
+
+        ipf.chromiLuminanceCurve(nullptr, 1, &lab, &lab, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+        ipf.vibrance(&lab, params.vibrance, params.toneCurve.hrenabled, params.icm.workingProfile);
+
+        if (params.sharpening.enabled) {
+            ipf.sharpening(&lab, params.sharpening);
+        }
+
+        ipf.softLight(&lab, params.softlight);
+
+        return ipf.lab2rgbOut(&lab, cx, y0 - top, cw, y1 - y0, params.icm);
+    }
+
+    // Same result as stage_finish(), but the RGB and Lab stages run over horizontal bands which are
+    // written to the TIFF file as soon as they are ready, so that no full size LabImage nor output
+    // image is ever allocated. Only valid if can_stream()
+    int stage_finish_streamed(const Glib::ustring &fname, int bps, bool isFloat, bool uncompressed)
+    {
+        TraceScope trace("ImageProcessor::stage_finish_streamed", fw, fh);
+
+        procparams::ProcParams& params = job->pparams;
+
+        stage_rgb_curves();
+        stage_lab_curves();
+
+        int cx = 0, cy = 0, cw = fw, ch = fh;
+
+        if (params.crop.enabled) {
+            cx = params.crop.x;
+            cy = params.crop.y;
+            cw = params.crop.w;
+            ch = params.crop.h;
+        }
+
+        const int halo = sharpening_halo();
+        const int bandHeight = std::max(STREAM_BAND_HEIGHT, 2 * halo);
+
+        // only carries the metadata and the output profile, the rows come from the bands
+        Imagefloat header;
+        set_output_metadata(&header);
+
+        std::unique_ptr<Imagefloat> band;
+        int bandStart = 0;
+        int bandEnd = 0;
+
+        const int result = header.saveTIFF(
+            fname,
+            cw,
+            ch,
+            [&](int row, unsigned char* buffer)
+            {
+                if (row >= bandEnd) {
+                    bandStart = row;
+                    bandEnd = std::min(row + bandHeight, ch);
+                    band.reset();
+                    band.reset(process_band(cy + bandStart, cy + bandEnd, halo, cx, cw));
+
+                    if (pl) {
+                        pl->setProgress(0.55 + 0.45 * bandStart / ch);
+                    }
+                }
+
+                band->getScanline(row - bandStart, buffer, bps, isFloat);
+            },
+            bps,
+            isFloat,
+            uncompressed
+        );
+
+        band.reset();
+
+        if (params.filmSimulation.enabled && !params.filmSimulation.clutFilename.empty() && options.clutCacheSize == 1) {
+            CLUTStore::getInstance().clearCache();
+        }
+
+        delete baseImg;
+        baseImg = nullptr;
+
+        if (!job->initialImage) {
+            initialImage->decreaseRef();
+        }
+
+        delete job;
+
+        if (pl) {
+            pl->setProgress(1.0);
+        }
+
+        return result;
+    }
+
+    // Attaches the metadata and the output profile to the image which will be saved
+    void set_output_metadata(Imagefloat* readyImg)
+    {
+        procparams::ProcParams& params = job->pparams;
+
         switch (params.metadata.mode) {
             case MetaDataParams::TUNNEL:
                 // Sending back the whole first root, which won't necessarily be the selected frame number
@@ -1757,37 +1937,103 @@ private:
             // No ICM
             readyImg->setOutputProfile(nullptr, 0);
         }
+    }
 
-//    t2.set();
-//    if( settings->verbose )
-//           printf("Total:- %d usec\n", t2.etime(t1));
+    // Computes the curves of the RGB stage, shared by stage_finish and stage_finish_streamed
+    void stage_rgb_curves()
+    {
+        TraceScope trace("ImageProcessor::stage_rgb_curves", fw, fh);
 
-        if (!job->initialImage) {
-            initialImage->decreaseRef();
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        curve1(65536);
+        curve2(65536);
+        curve(65536, 0);
+        satcurve(65536, 0);
+        lhskcurve(65536, 0);
+        lumacurve(32770, 0);  // lumacurve[32768] and lumacurve[32769] will be set to 32768 and 32769 later to allow linear interpolation
+        clcurve(65536, 0);
+        wavclCurve(65536, 0);
+
+        //if(params.blackwhite.enabled) params.toneCurve.hrenabled=false;
+
+        CurveFactory::complexCurve(expcomp, black / 65535.0, hlcompr, hlcomprthresh, params.toneCurve.shcompr, bright, contr,
+                                   params.toneCurve.curve, params.toneCurve.curve2,
+                                   hist16, curve1, curve2, curve, dummy, customToneCurve1, customToneCurve2);
+
+        CurveFactory::RGBCurve(params.rgbCurves.rcurve, rCurve, 1);
+        CurveFactory::RGBCurve(params.rgbCurves.gcurve, gCurve, 1);
+        CurveFactory::RGBCurve(params.rgbCurves.bcurve, bCurve, 1);
+
+        opautili = false;
+
+        if (params.colorToning.enabled) {
+            TMatrix wprof = ICCStore::getInstance()->workingSpaceMatrix(params.icm.workingProfile);
+            double wp[3][3] = {
+                {wprof[0][0], wprof[0][1], wprof[0][2]},
+                {wprof[1][0], wprof[1][1], wprof[1][2]},
+                {wprof[2][0], wprof[2][1], wprof[2][2]}
+            };
+            params.colorToning.getCurves(ctColorCurve, ctOpacityCurve, wp, opautili);
+            clToningcurve(65536, 0);
+            CurveFactory::diagonalCurve2Lut(params.colorToning.clcurve, clToningcurve, 1);
+            cl2Toningcurve(65536, 0);
+            CurveFactory::diagonalCurve2Lut(params.colorToning.cl2curve, cl2Toningcurve, 1);
         }
 
-        delete job;
+//        labView = new LabImage(fw, fh);
 
-        if (pl) {
-            pl->setProgress(0.75);
+        if (params.blackwhite.enabled) {
+            CurveFactory::curveBW(params.blackwhite.beforeCurve, params.blackwhite.afterCurve, hist16, dummy, customToneCurvebw1, customToneCurvebw2, 1);
         }
 
-        /*  curve1.reset();curve2.reset();
-            curve.reset();
-            satcurve.reset();
-            lhskcurve.reset();
+        satLimit = float (params.colorToning.satProtectionThreshold) / 100.f * 0.7f + 0.3f;
+        satLimitOpacity = 1.f - (float (params.colorToning.saturatedOpacity) / 100.f);
+
+        if (params.colorToning.enabled  && params.colorToning.autosat && params.colorToning.method != "LabGrid") { //for colortoning evaluation of saturation settings
+            float moyS = 0.f;
+            float eqty = 0.f;
+            ipf.moyeqt(baseImg, moyS, eqty); //return image : mean saturation and standard dev of saturation
+            float satp = ((moyS + 1.5f * eqty) - 0.3f) / 0.7f; //1.5 sigma ==> 93% pixels with high saturation -0.3 / 0.7 convert to Hombre scale
+
+            if (satp >= 0.92f) {
+                satp = 0.92f;    //avoid values too high (out of gamut)
+            }
+
+            if (satp <= 0.15f) {
+                satp = 0.15f;    //avoid too low values
+            }
+
+            satLimit = 100.f * satp;
+
+            satLimitOpacity = 100.f * (moyS - 0.85f * eqty); //-0.85 sigma==>20% pixels with low saturation
+        }
+
+        autor = -9000.f; // This will ask to compute the "auto" values for the B&W tool (have to be inferior to -5000)
+        dcpProf = imgsrc->getDCP(params.icm, dcpApplyState);
 
-            rCurve.reset();
-            gCurve.reset();
-            bCurve.reset();
-            hist16.reset();
-            hist16C.reset();
-        */
-        return readyImg;
+    }
+
+    // Computes the curves of the Lab adjustments, hist16 has to be filled if the contrast is used
+    void stage_lab_curves()
+    {
+        TraceScope trace("ImageProcessor::stage_lab_curves", fw, fh);
+
+        procparams::ProcParams& params = job->pparams;
+
+        CurveFactory::complexLCurve(params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
+
+        clcutili = CurveFactory::diagonalCurve2Lut(params.labCurve.clcurve, clcurve, 1);
+
+        CurveFactory::complexsgnCurve(autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
+                                      params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 1);
     }
 
     void stage_early_resize()
     {
+        TraceScope trace("ImageProcessor::stage_early_resize", fw, fh);
+
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -1991,6 +2237,15 @@ private:
     ToneCurve customToneCurvebw2;
 
     bool autili, butili;
+    bool utili, clcutili, ccutili, cclutili;
+
+    bool opautili;
+    float satLimit;
+    float satLimitOpacity;
+    double rrm, ggm, bbm;
+    float autor, autog, autob;
+    DCPProfileApplyState dcpApplyState;
+    DCPProfile *dcpProf;
 };
 
 } // namespace
@@ -2002,6 +2257,12 @@ IImagefloat* processImage(ProcessingJob* pjob, int& errorCode, ProgressListener*
     return proc();
 }
 
+int processImageToTIFF(ProcessingJob* pjob, int& errorCode, const Glib::ustring& fname, int bps, bool isFloat, bool uncompressed, ProgressListener* pl)
+{
+    ImageProcessor proc(pjob, errorCode, pl, false);
+    return proc(fname, bps, isFloat, uncompressed);
+}
+
 void batchProcessingThread(ProcessingJob* job, BatchProcessingListener* bpl)
 {
 
@@ -67,6 +67,7 @@
 
 #include "array2D.h"
 #include "color.h"
+#include "fftwplancache.h"
 #include "iccstore.h"
 #include "imagefloat.h"
 #include "improcfun.h"
@@ -76,6 +77,7 @@
 #include "rt_algo.h"
 #include "settings.h"
 #include "sleef.h"
+#include "tracer.h"
 #include "StopWatch.h"
 
 namespace rtengine
@@ -734,6 +736,16 @@ void tmo_fattal02(size_t width,
 // for both solvers.
 
 
+// number of threads used by the fft routines
+int fftw_threads(bool multithread)
+{
+#ifdef RT_FFTW3F_OMP
+    return multithread ? omp_get_max_threads() : 1;
+#else
+    return 1;
+#endif
+}
+
 // returns T = EVy A EVx^tr
 // note, modifies input data
 void transform_ev2normal(Array2Df *A, Array2Df *T, bool multithread)
@@ -773,11 +785,9 @@ void transform_ev2normal(Array2Df *A, Array2Df *T, bool multithread)
     // fftwf_free(in);
 
     // executes 2d discrete cosine transform
-    fftwf_plan p;
-    p = fftwf_plan_r2r_2d(height, width, A->data(), T->data(),
-                          FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE);
-    fftwf_execute(p);
-    fftwf_destroy_plan(p);
+    const auto p = FFTWPlanCache::getInstance().getR2R2D(height, width, A->data(), T->data(),
+                   FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE, fftw_threads(multithread));
+    fftwf_execute_r2r(p.get(), A->data(), T->data());
 }
 
 
@@ -789,11 +799,9 @@ void transform_normal2ev(Array2Df *A, Array2Df *T, bool multithread)
     assert((int)T->getCols() == width && (int)T->getRows() == height);
 
     // executes 2d discrete cosine transform
-    fftwf_plan p;
-    p = fftwf_plan_r2r_2d(height, width, A->data(), T->data(),
-                          FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE);
-    fftwf_execute(p);
-    fftwf_destroy_plan(p);
+    const auto p = FFTWPlanCache::getInstance().getR2R2D(height, width, A->data(), T->data(),
+                   FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE, fftw_threads(multithread));
+    fftwf_execute_r2r(p.get(), A->data(), T->data());
 
     // need to scale the output matrix to get the right transform
     float factor = (1.0f / ((height - 1) * (width - 1)));
@@ -884,18 +892,6 @@ void solve_pde_fft(Array2Df *F, Array2Df *U, Array2Df *buf, bool multithread, in
     assert((int)U->getCols() == width && (int)U->getRows() == height);
     assert(buf->getCols() == width && buf->getRows() == height);
 
-    // activate parallel execution of fft routines
-#ifdef RT_FFTW3F_OMP
-
-    if (multithread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
-
-// #else
-//   fftwf_plan_with_nthreads( 2 );
-#endif
-
     // in general there might not be a solution to the Poisson pde
     // with Neumann boundary conditions unless the boundary satisfies
     // an integral condition, this function modifies the boundary so that
@@ -1072,6 +1068,8 @@ void ImProcFunctions::ToneMapFattal02(Imagefloat *rgb, const FattalToneMappingPa
         return;
     }
 
+    TraceScope trace("ImProcFunctions::ToneMapFattal02", rgb->getWidth(), rgb->getHeight());
+
     BENCHFUN
 //    const int detail_level = 3;
 
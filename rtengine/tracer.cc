@@ -0,0 +1,193 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <string>
+
+#include <glib/gstdio.h>
+
+#include "tracer.h"
+
+namespace
+{
+
+// A long GUI session must not grow the event list without bounds, later events are dropped
+constexpr std::size_t MAX_EVENTS = 1 << 20;
+
+unsigned int getThreadNumber()
+{
+    static std::atomic<unsigned int> threadCount(0);
+    thread_local const unsigned int number = ++threadCount;
+    return number;
+}
+
+}
+
+rtengine::Tracer& rtengine::Tracer::getInstance()
+{
+    static Tracer instance;
+    return instance;
+}
+
+void rtengine::Tracer::setEnabled(bool enabled)
+{
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+std::int64_t rtengine::Tracer::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void rtengine::Tracer::addEvent(const Event& event)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (events.size() < MAX_EVENTS) {
+        events.push_back(event);
+    }
+}
+
+void rtengine::Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+}
+
+bool rtengine::Tracer::writeChromeTrace(const Glib::ustring& fname) const
+{
+    FILE* const f = g_fopen(fname.c_str(), "wb");
+
+    if (!f) {
+        return false;
+    }
+
+    bool ok = fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f) >= 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (std::size_t i = 0; ok && i < events.size(); ++i) {
+            const Event& event = events[i];
+            ok = fprintf(
+                f,
+                "%s{\"name\":\"%s\",\"cat\":\"rtengine\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%" PRId64 ",\"dur\":%" PRId64 ",\"args\":{\"width\":%d,\"height\":%d}}\n",
+                i ? "," : "",
+                event.name,
+                event.thread,
+                event.start,
+                event.duration,
+                event.width,
+                event.height
+            ) > 0;
+        }
+    }
+
+    ok = ok && fputs("]}\n", f) >= 0;
+
+    return fclose(f) == 0 && ok;
+}
+
+void rtengine::Tracer::printSummary(std::ostream& stream) const
+{
+    struct Stage {
+        std::string name;
+        unsigned int count;
+        std::int64_t total;
+        std::int64_t max;
+    };
+
+    std::map<std::string, Stage> stages;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto& event : events) {
+            Stage& stage = stages[event.name];
+            stage.name = event.name;
+            ++stage.count;
+            stage.total += event.duration;
+            stage.max = std::max(stage.max, event.duration);
+        }
+    }
+
+    std::vector<Stage> sorted;
+
+    for (const auto& stage : stages) {
+        sorted.push_back(stage.second);
+    }
+
+    std::sort(
+        sorted.begin(),
+        sorted.end(),
+        [](const Stage& lhs, const Stage& rhs) -> bool
+        {
+            return lhs.total > rhs.total;
+        }
+    );
+
+    const auto oldFlags = stream.flags();
+    const auto oldPrecision = stream.precision();
+
+    stream << std::left << std::setw(48) << "Stage" << std::right << std::setw(8) << "Calls" << std::setw(14) << "Total (ms)" << std::setw(12) << "Mean (ms)" << std::setw(12) << "Max (ms)" << std::endl;
+    stream << std::fixed << std::setprecision(1);
+
+    for (const auto& stage : sorted) {
+        stream
+            << std::left << std::setw(48) << stage.name
+            << std::right << std::setw(8) << stage.count
+            << std::setw(14) << stage.total / 1000.0
+            << std::setw(12) << stage.total / 1000.0 / stage.count
+            << std::setw(12) << stage.max / 1000.0
+            << std::endl;
+    }
+
+    stream.flags(oldFlags);
+    stream.precision(oldPrecision);
+}
+
+rtengine::Tracer::Tracer() :
+    enabled(false),
+    epoch(std::chrono::steady_clock::now())
+{
+}
+
+rtengine::TraceScope::TraceScope(const char* name, int width, int height) :
+    name(name),
+    memoryStage(name),
+    start(Tracer::getInstance().isEnabled() ? Tracer::getInstance().now() : -1),
+    width(width),
+    height(height)
+{
+}
+
+rtengine::TraceScope::~TraceScope()
+{
+    if (start >= 0) {
+        Tracer& tracer = Tracer::getInstance();
+        tracer.addEvent({name, getThreadNumber(), start, tracer.now() - start, width, height});
+    }
+}
+
+void rtengine::TraceScope::setSize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+}
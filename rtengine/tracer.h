@@ -0,0 +1,103 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include <glibmm/ustring.h>
+
+#include "memoryaccounting.h"
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/**
+ * Runtime tracing of the processing stages.
+ *
+ * Unlike BENCHFUN, tracing is compiled in and enabled at runtime. When enabled, every TraceScope
+ * records its name, the thread, its start and stop time and the size of the image it works on.
+ * The events can be written in the Chrome trace event format (to be opened with chrome://tracing
+ * or Perfetto) or summarized per stage. When disabled, a TraceScope costs an atomic load.
+ */
+class Tracer final :
+    public NonCopyable
+{
+public:
+    struct Event {
+        const char* name; // must have static storage duration, usually a string literal
+        unsigned int thread;
+        std::int64_t start; // microseconds since the creation of the tracer
+        std::int64_t duration;
+        int width;
+        int height;
+    };
+
+    static Tracer& getInstance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /** Microseconds since the creation of the tracer. */
+    std::int64_t now() const;
+    void addEvent(const Event& event);
+    void clear();
+
+    /** Writes the events in the Chrome trace event JSON format. Returns false on failure. */
+    bool writeChromeTrace(const Glib::ustring& fname) const;
+    /** Prints the number of calls, total, mean and maximum time of each stage, by decreasing total time. */
+    void printSummary(std::ostream& stream) const;
+
+private:
+    Tracer();
+
+    std::atomic<bool> enabled;
+    const std::chrono::steady_clock::time_point epoch;
+    mutable std::mutex mutex;
+    std::vector<Event> events;
+};
+
+/**
+ * Records an event spanning its own lifetime, if tracing is enabled when it is created.
+ * The buffers allocated by the thread during its lifetime are charged to the same stage.
+ */
+class TraceScope final :
+    public NonCopyable
+{
+public:
+    explicit TraceScope(const char* name, int width = 0, int height = 0);
+    ~TraceScope();
+
+    void setSize(int width, int height);
+
+private:
+    const char* const name;
+    const MemoryStage memoryStage;
+    const std::int64_t start; // negative when tracing is disabled
+    int width;
+    int height;
+};
+
+}
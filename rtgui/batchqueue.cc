@@ -90,6 +90,9 @@ BatchQueue::BatchQueue (FileCatalog* aFileCatalog) : processing(nullptr), fileCa
 
 BatchQueue::~BatchQueue ()
 {
+    // the pending writes still notify the thumbnails, and put the failed entries back into fd
+    writer.flush();
+
     std::set<BatchQueueEntry*> removable_bqes;
 
     mutex_removable_batch_queue_entries.lock();
@@ -238,7 +241,7 @@ bool BatchQueue::saveBatchQueue ()
     {
         MYREADERLOCK(l, entryRW);
 
-        if (fd.empty ())
+        if (fd.empty () && writingEntries.empty ())
             return true;
 
         // The column's header is mandatory (the first line will be skipped when loaded)
@@ -246,10 +249,15 @@ bool BatchQueue::saveBatchQueue ()
              << "png bit depth|png compression|tiff bit depth|tiff is float|uncompressed tiff|save output params|force format options|fast export|<end of line>"
              << std::endl;
 
-        // method is already running with entryLock, so no need to lock again
+        // the entries whose image is being written come first, they're only done once written
+        std::vector<BatchQueueEntry*> entries (writingEntries);
+
         for (const auto fdEntry : fd) {
+            entries.push_back (static_cast<BatchQueueEntry*> (fdEntry));
+        }
 
-            const auto entry = static_cast<BatchQueueEntry*> (fdEntry);
+        // method is already running with entryLock, so no need to lock again
+        for (const auto entry : entries) {
             const auto& saveFormat = entry->saveFormat;
 
             // Warning: for code's simplicity in loadBatchQueue, each field must end by the '|' character, safer than ';' or ',' since it can't be used in paths
@@ -689,35 +697,9 @@ rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
 
     //printf ("fname=%s, %s\n", fname.c_str(), removeExtension(fname).c_str());
 
-    if (img && !fname.empty()) {
-        int err = 0;
-
-        if (saveFormat.format == "tif") {
-            err = img->saveAsTIFF (fname, saveFormat.tiffBits, saveFormat.tiffFloat, saveFormat.tiffUncompressed);
-        } else if (saveFormat.format == "png") {
-            err = img->saveAsPNG (fname, saveFormat.pngBits);
-        } else if (saveFormat.format == "jpg") {
-            err = img->saveAsJPEG (fname, saveFormat.jpegQuality, saveFormat.jpegSubSamp);
-        }
-
-        delete img;
-
-        if (err) {
-            throw Glib::FileError(Glib::FileError::FAILED, M("MAIN_MSG_CANNOTSAVE") + "\n" + fname);
-        }
-
-        if (saveFormat.saveParams) {
-            // We keep the extension to avoid overwriting the profile when we have
-            // the same output filename with different extension
-            //processing->params.save (removeExtension(fname) + paramFileExtension);
-            processing->params->save (fname + ".out" + paramFileExtension);
-        }
-
-        if (processing->thumbnail) {
-            processing->thumbnail->imageDeveloped ();
-            processing->thumbnail->imageRemovedFromQueue ();
-        }
-    }
+    // The image is encoded by the writer thread, so that the next job can be started right away.
+    // The entry is kept until the image is written, see imageWritten()
+    BatchQueueEntry* const written = img && !fname.empty() ? processing : nullptr;
 
     // save temporary params file name: delete as last thing
     Glib::ustring processedParams = processing->savedParamsFile;
@@ -728,13 +710,18 @@ rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
     {
         MYWRITERLOCK(l, entryRW);
 
-        delete processing;
+        if (written) {
+            writingEntries.push_back (processing);
+        } else {
+            delete processing;
+        }
+
         processing = nullptr;
 
         fd.erase (fd.begin());
 
-        // return next job
-        if (!fd.empty() && listener && listener->canStartNext ()) {
+        // return next job, unless a previous image couldn't be written
+        if (!fd.empty() && listener && listener->canStartNext () && !hasWriteError()) {
             BatchQueueEntry* next = static_cast<BatchQueueEntry*>(fd[0]);
             // tag it as selected and set sequence
             next->processing = true;
@@ -757,6 +744,31 @@ rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
         }
     }
 
+    if (written) {
+        const bool saveParams = saveFormat.saveParams;
+
+        writer.enqueue(
+            img,
+            fname,
+            [saveFormat, fname](const rtengine::IImagefloat* image) -> int
+            {
+                if (saveFormat.format == "tif") {
+                    return image->saveAsTIFF (fname, saveFormat.tiffBits, saveFormat.tiffFloat, saveFormat.tiffUncompressed);
+                } else if (saveFormat.format == "png") {
+                    return image->saveAsPNG (fname, saveFormat.pngBits);
+                } else if (saveFormat.format == "jpg") {
+                    return image->saveAsJPEG (fname, saveFormat.jpegQuality, saveFormat.jpegSubSamp);
+                }
+
+                return 0;
+            },
+            [this, written, fname, saveParams](int err)
+            {
+                imageWritten (written, fname, saveParams, err);
+            }
+        );
+    }
+
     if (remove_button_set) {
         // ButtonSet have Cairo::Surface which might be rendered while we're trying to delete them
         GThreadLock lock;
@@ -764,14 +776,16 @@ rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
     }
 
     if (saveBatchQueue ()) {
-        ::g_remove (processedParams.c_str ());
+        if (!written) {
+            ::g_remove (processedParams.c_str ());
+        }
 
         // Delete all files in directory batch when finished, just to be sure to remove zombies
         auto isEmpty = false;
 
         {
             MYREADERLOCK(l, entryRW);
-            isEmpty = fd.empty();
+            isEmpty = fd.empty() && writingEntries.empty();
         }
 
         if (isEmpty) {
@@ -791,12 +805,94 @@ rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
         }
     }
 
+    if (!processing) {
+        // make sure the output is complete when the queue reports being done
+        writer.flush();
+    }
+
+    Glib::ustring writeErrorDescr;
+
+    {
+        MyMutex::MyLock lock(writeErrorMutex);
+        writeErrorDescr.swap(writeErrorMessage);
+    }
+
+    if (!writeErrorDescr.empty() && listener) {
+        BatchQueueListener* const bql = listener;
+
+        idle_register.add(
+            [bql, writeErrorDescr]() -> bool
+            {
+                bql->queueSizeChanged(0, false, true, writeErrorDescr);
+                return false;
+            }
+        );
+    }
+
     redraw ();
     notifyListener ();
 
     return processing ? processing->job : nullptr;
 }
 
+// Called by the writer thread once the image of entry, which was removed from the queue, has been written
+void BatchQueue::imageWritten (BatchQueueEntry* entry, const Glib::ustring& fname, bool saveParams, int err)
+{
+    if (!err) {
+        if (saveParams) {
+            // We keep the extension to avoid overwriting the profile when we have
+            // the same output filename with different extension
+            //processing->params.save (removeExtension(fname) + paramFileExtension);
+            entry->params->save (fname + ".out" + paramFileExtension);
+        }
+
+        if (entry->thumbnail) {
+            entry->thumbnail->imageDeveloped ();
+            entry->thumbnail->imageRemovedFromQueue ();
+        }
+
+        // the temporary params file is only deleted once the image is safely written
+        const Glib::ustring processedParams = entry->savedParamsFile;
+
+        {
+            MYWRITERLOCK(l, entryRW);
+
+            writingEntries.erase (std::find (writingEntries.begin(), writingEntries.end(), entry));
+            delete entry;
+        }
+
+        if (saveBatchQueue ()) {
+            ::g_remove (processedParams.c_str ());
+        }
+
+        return;
+    }
+
+    {
+        MyMutex::MyLock lock(writeErrorMutex);
+        writeErrorMessage = M("MAIN_MSG_CANNOTSAVE") + "\n" + fname;
+    }
+
+    {
+        MYWRITERLOCK(l, entryRW);
+
+        writingEntries.erase (std::find (writingEntries.begin(), writingEntries.end(), entry));
+
+        // restore the failed entry the same way as error(), after the one being processed if any
+        BatchQueueButtonSet* bqbs = new BatchQueueButtonSet (entry);
+        bqbs->setButtonListener (this);
+        entry->addButtonSet (bqbs);
+        entry->processing = false;
+        entry->job = rtengine::ProcessingJob::create(entry->filename, entry->thumbnail->getType() == FT_Raw, *entry->params);
+
+        fd.insert (std::find_if (fd.begin (), fd.end (), [] (const ThumbBrowserEntryBase* fdEntry) { return !fdEntry->processing; }), entry);
+    }
+
+    saveBatchQueue ();
+    redraw ();
+    notifyListener ();
+}
+
 // Calculates automatic filename of processed batch entry, but just the base name
 // example output: "c:\out\converted\dsc0121"
 Glib::ustring BatchQueue::calcAutoFileNameBase (const Glib::ustring& origFileName, int sequence)
@@ -954,7 +1050,7 @@ Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, c
             fname = Glib::ustring::compose ("%1-%2.%3", Glib::build_filename (dstdir,  dstfname), tries, format);
         }
 
-        int fileExists = Glib::file_test (fname, Glib::FILE_TEST_EXISTS);
+        int fileExists = Glib::file_test (fname, Glib::FILE_TEST_EXISTS) || writer.isPending (fname);
 
         if (inOverwriteMode && fileExists) {
             if (::g_remove (fname.c_str ()) != 0) {
@@ -985,6 +1081,12 @@ void BatchQueue::buttonPressed (LWButton* button, int actionCode, void* actionDa
     }
 }
 
+bool BatchQueue::hasWriteError ()
+{
+    MyMutex::MyLock lock(writeErrorMutex);
+    return !writeErrorMessage.empty();
+}
+
 void BatchQueue::notifyListener ()
 {
     const bool queueRunning = processing;
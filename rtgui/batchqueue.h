@@ -26,6 +26,7 @@
 #include "threadutils.h"
 #include "thumbbrowserbase.h"
 
+#include "../rtengine/imagewriter.h"
 #include "../rtengine/rtengine.h"
 #include "../rtengine/noncopyable.h"
 
@@ -99,6 +100,8 @@ private:
     Glib::ustring autoCompleteFileName (const Glib::ustring& fileName, const Glib::ustring& format);
     Glib::ustring getTempFilenameForParams( const Glib::ustring &filename );
     bool saveBatchQueue ();
+    void imageWritten (BatchQueueEntry* entry, const Glib::ustring& fname, bool saveParams, int err);
+    bool hasWriteError ();
     void notifyListener ();
 
     using ThumbBrowserBase::redrawNeeded;
@@ -123,4 +126,9 @@ private:
     MyMutex mutex_removable_batch_queue_entries;
 
     IdleRegister idle_register;
+
+    rtengine::ImageWriter writer;
+    std::vector<BatchQueueEntry*> writingEntries; // removed from the queue, waiting for their image to be written
+    Glib::ustring writeErrorMessage;
+    MyMutex writeErrorMutex;
 };
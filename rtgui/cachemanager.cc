@@ -17,10 +17,15 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
 #include <memory>
 #include <iostream>
+#include <mutex>
+#include <vector>
 
-#include <dirent.h>
 #include <giomm.h>
 #include <glib/gstdio.h>
 
@@ -41,6 +46,113 @@ namespace
 constexpr int cacheDirMode = 0777;
 constexpr const char* cacheDirs[] = { "profiles", "images", "embprofiles", "data" };
 
+constexpr std::size_t IDENTITY_BLOCK_SIZE = 16 * 1024;
+constexpr std::uint64_t IDENTITY_SEED = 0x52617754686572ULL;
+
+struct Identity {
+    std::int64_t size;
+    std::int64_t mtime;
+    std::string id;
+    bool verified; // false once the folder has been left, the file is then stat'ed again
+};
+
+// Identities of the files by folder and name, so browsing a folder needs no file system access
+std::mutex identityMutex;
+std::map<std::string, std::map<std::string, Identity>> identities;
+
+// xxHash64, see https://github.com/Cyan4973/xxHash
+constexpr std::uint64_t XXH_PRIME1 = 11400714785074694791ULL;
+constexpr std::uint64_t XXH_PRIME2 = 14029467366897019727ULL;
+constexpr std::uint64_t XXH_PRIME3 = 1609587929392839161ULL;
+constexpr std::uint64_t XXH_PRIME4 = 9650029242287828579ULL;
+constexpr std::uint64_t XXH_PRIME5 = 2870177450012600261ULL;
+
+inline std::uint64_t rotl64 (std::uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline std::uint64_t read64 (const unsigned char* p)
+{
+    std::uint64_t v;
+    memcpy (&v, p, sizeof (v));
+    return v;
+}
+
+inline std::uint32_t read32 (const unsigned char* p)
+{
+    std::uint32_t v;
+    memcpy (&v, p, sizeof (v));
+    return v;
+}
+
+inline std::uint64_t xxhRound (std::uint64_t acc, std::uint64_t input)
+{
+    acc += input * XXH_PRIME2;
+    return rotl64 (acc, 31) * XXH_PRIME1;
+}
+
+inline std::uint64_t xxhMergeRound (std::uint64_t acc, std::uint64_t val)
+{
+    acc ^= xxhRound (0, val);
+    return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+// Little endian platforms only, which is enough for a local cache key
+std::uint64_t xxh64 (const unsigned char* p, std::size_t len, std::uint64_t seed)
+{
+    const unsigned char* const end = p + len;
+    std::uint64_t h;
+
+    if (len >= 32) {
+        std::uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+        std::uint64_t v2 = seed + XXH_PRIME2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - XXH_PRIME1;
+
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxhRound (v1, read64 (p));
+            v2 = xxhRound (v2, read64 (p + 8));
+            v3 = xxhRound (v3, read64 (p + 16));
+            v4 = xxhRound (v4, read64 (p + 24));
+        }
+
+        h = rotl64 (v1, 1) + rotl64 (v2, 7) + rotl64 (v3, 12) + rotl64 (v4, 18);
+        h = xxhMergeRound (h, v1);
+        h = xxhMergeRound (h, v2);
+        h = xxhMergeRound (h, v3);
+        h = xxhMergeRound (h, v4);
+    } else {
+        h = seed + XXH_PRIME5;
+    }
+
+    h += len;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxhRound (0, read64 (p));
+        h = rotl64 (h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+
+    if (p + 4 <= end) {
+        h ^= read32 (p) * XXH_PRIME1;
+        h = rotl64 (h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+
+    for (; p < end; ++p) {
+        h ^= *p * XXH_PRIME5;
+        h = rotl64 (h, 11) * XXH_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+
+    return h;
+}
+
 }
 
 CacheManager* CacheManager::getInstance ()
@@ -65,6 +177,8 @@ void CacheManager::init ()
     if (error != 0 && rtengine::settings->verbose) {
         std::cerr << "Failed to create all cache directories: " << g_strerror(errno) << std::endl;
     }
+
+    packedItems.init (Glib::build_filename (baseDir, "images"));
 }
 
 Thumbnail* CacheManager::getEntry (const Glib::ustring& fname)
@@ -156,6 +270,7 @@ void CacheManager::deleteEntry (const Glib::ustring& fname)
 
     if (iterator == openEntries.end ()) {
         deleteFiles (fname, getMD5 (fname), true, true);
+        forgetFile (fname);
         return;
     }
 
@@ -175,6 +290,7 @@ void CacheManager::deleteEntry (const Glib::ustring& fname)
     // if not, delete it
     if (openEntries.count (fname) == 0) {
         deleteFiles (fname, thumbnail->getMD5 (), true, true);
+        forgetFile (fname);
     }
 }
 
@@ -190,14 +306,16 @@ void CacheManager::renameEntry (const std::string& oldfilename, const std::strin
     const auto newmd5 = getMD5 (newfilename);
 
     auto error = g_rename (getCacheFileName ("profiles", oldfilename, paramFileExtension, oldmd5).c_str (), getCacheFileName ("profiles", newfilename, paramFileExtension, newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".rtti", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".rtti", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("embprofiles", oldfilename, ".icc", oldmd5).c_str (), getCacheFileName ("embprofiles", newfilename, ".icc", newmd5).c_str ());
+    packedItems.rename (getItemKey (oldfilename, oldmd5, ".rtti"), getItemKey (newfilename, newmd5, ".rtti"));
+    packedItems.rename (getItemKey (oldfilename, oldmd5, ".icc"), getItemKey (newfilename, newmd5, ".icc"));
     error |= g_rename (getCacheFileName ("data", oldfilename, ".txt", oldmd5).c_str (), getCacheFileName ("data", newfilename, ".txt", newmd5).c_str ());
 
     if (error != 0 && rtengine::settings->verbose) {
         std::cerr << "Failed to rename all files for cache entry '" << oldfilename << "': " << g_strerror(errno) << std::endl;
     }
 
+    forgetFile (oldfilename);
+
     // check if it is opened
     // if it is open, update md5
     const auto iterator = openEntries.find (oldfilename);
@@ -234,18 +352,22 @@ void CacheManager::clearAll () const
 {
     MyMutex::MyLock lock (mutex);
 
-    for (const auto& cacheDir : cacheDirs) {
-        deleteDir (cacheDir);
-    }
+    packedItems.clear ([this]() {
+        for (const auto& cacheDir : cacheDirs) {
+            deleteDir (cacheDir);
+        }
+    });
 }
 
 void CacheManager::clearImages () const
 {
     MyMutex::MyLock lock (mutex);
 
-    deleteDir ("data");
-    deleteDir ("images");
-    deleteDir ("embprofiles");
+    packedItems.clear ([this]() {
+        deleteDir ("data");
+        deleteDir ("images");
+        deleteDir ("embprofiles");
+    });
 }
 
 void CacheManager::clearProfiles () const
@@ -282,8 +404,10 @@ void CacheManager::deleteFiles (const Glib::ustring& fname, const std::string& m
         return;
     }
 
-    auto error = g_remove (getCacheFileName ("images", fname, ".rtti", md5).c_str ());
-    error |= g_remove (getCacheFileName ("embprofiles", fname, ".icc", md5).c_str ());
+    packedItems.remove (getItemKey (fname, md5, ".rtti"));
+    packedItems.remove (getItemKey (fname, md5, ".icc"));
+
+    auto error = 0;
 
     if (purgeData) {
         error |= g_remove (getCacheFileName ("data", fname, ".txt", md5).c_str ());
@@ -300,38 +424,103 @@ void CacheManager::deleteFiles (const Glib::ustring& fname, const std::string& m
 
 std::string CacheManager::getMD5 (const Glib::ustring& fname)
 {
+    const std::string dirName = Glib::path_get_dirname (fname);
+    const std::string baseName = Glib::path_get_basename (fname);
 
-#ifdef WIN32
+    {
+        std::lock_guard<std::mutex> lock (identityMutex);
+
+        const auto dir = identities.find (dirName);
+
+        if (dir != identities.end ()) {
+            const auto file = dir->second.find (baseName);
+
+            if (file != dir->second.end () && file->second.verified) {
+                return file->second.id;
+            }
+        }
+    }
 
-    std::unique_ptr<wchar_t, GFreeFunc> wfname(reinterpret_cast<wchar_t*>(g_utf8_to_utf16 (fname.c_str (), -1, NULL, NULL, NULL)), g_free);
+    GStatBuf stat;
 
-    WIN32_FILE_ATTRIBUTE_DATA fileAttr;
-    if (GetFileAttributesExW(wfname.get(), GetFileExInfoStandard, &fileAttr)) {
-        // We use name, size and creation time to identify a file.
-        const auto identifier = Glib::ustring::compose("%1-%2-%3-%4", fileAttr.nFileSizeLow, fileAttr.ftCreationTime.dwHighDateTime, fileAttr.ftCreationTime.dwLowDateTime, fname);
-        return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, identifier);
+    if (g_stat (fname.c_str (), &stat) != 0) {
+        return {};
     }
 
-#else
+    Identity identity = {static_cast<std::int64_t> (stat.st_size), static_cast<std::int64_t> (stat.st_mtime), {}, true};
 
-    const auto file = Gio::File::create_for_path(fname);
-    if (file) {
+    {
+        std::lock_guard<std::mutex> lock (identityMutex);
 
-        try
-        {
-            const auto info = file->query_info("standard::*");
-            if (info) {
-                // We only use name and size to identify a file.
-                const auto identifier = Glib::ustring::compose("%1%2", fname, info->get_size());
-                return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, identifier);
-            }
+        auto& known = identities[dirName][baseName];
+
+        if (!known.id.empty () && known.size == identity.size && known.mtime == identity.mtime) {
+            // Unchanged since the folder was last browsed
+            known.verified = true;
+            return known.id;
+        }
+    }
 
-        } catch(Gio::Error&) {}
+    FILE* const f = g_fopen (fname.c_str (), "rb");
+
+    if (!f) {
+        return {};
     }
 
-#endif
+    // The first block holds the headers and metadata, which are unique to a shot with cameras,
+    // the last one the end of the image data, size and mtime catch edits in between
+    std::vector<unsigned char> data (2 * IDENTITY_BLOCK_SIZE + 2 * sizeof (std::int64_t));
+    std::size_t length = fread (data.data (), 1, IDENTITY_BLOCK_SIZE, f);
+
+    if (identity.size > static_cast<std::int64_t> (2 * IDENTITY_BLOCK_SIZE)) {
+        if (fseek (f, -static_cast<long> (IDENTITY_BLOCK_SIZE), SEEK_END) == 0) {
+            length += fread (data.data () + length, 1, IDENTITY_BLOCK_SIZE, f);
+        }
+    } else {
+        length += fread (data.data () + length, 1, 2 * IDENTITY_BLOCK_SIZE - length, f);
+    }
+
+    fclose (f);
+
+    memcpy (data.data () + length, &identity.size, sizeof (identity.size));
+    length += sizeof (identity.size);
+    memcpy (data.data () + length, &identity.mtime, sizeof (identity.mtime));
+    length += sizeof (identity.mtime);
+
+    // Same length as the MD5 digests used so far, which the cache file names rely on
+    char id[33];
+    snprintf (id, sizeof (id), "%016" PRIx64 "%016" PRIx64, xxh64 (data.data (), length, 0), xxh64 (data.data (), length, IDENTITY_SEED));
+    identity.id = id;
+
+    std::lock_guard<std::mutex> lock (identityMutex);
+    identities[dirName][baseName] = identity;
+
+    return identity.id;
+}
 
-    return {};
+void CacheManager::forgetFile (const Glib::ustring& fname)
+{
+    std::lock_guard<std::mutex> lock (identityMutex);
+
+    const auto dir = identities.find (Glib::path_get_dirname (fname));
+
+    if (dir != identities.end ()) {
+        dir->second.erase (Glib::path_get_basename (fname));
+    }
+}
+
+void CacheManager::leaveDirectory (const Glib::ustring& dirName)
+{
+    std::lock_guard<std::mutex> lock (identityMutex);
+
+    // Same form as the folder names of getMD5()
+    const auto dir = identities.find (Glib::path_get_dirname (Glib::build_filename (dirName, "_")));
+
+    if (dir != identities.end ()) {
+        for (auto& file : dir->second) {
+            file.second.verified = false;
+        }
+    }
 }
 
 Glib::ustring CacheManager::getCacheFileName (const Glib::ustring& subDir,
@@ -344,72 +533,59 @@ Glib::ustring CacheManager::getCacheFileName (const Glib::ustring& subDir,
     return Glib::build_filename (dirName, baseName + fext);
 }
 
-void CacheManager::applyCacheSizeLimitation () const
+std::string CacheManager::getItemKey (const Glib::ustring& fname, const std::string& md5, const std::string& suffix) const
 {
-    // first count files without fetching file name and timestamp.
-    auto cachedir = opendir(Glib::build_filename(baseDir, "data").c_str());
-    if (!cachedir) {
-        return;
-    }
+    return Glib::path_get_basename (fname) + "." + md5 + suffix;
+}
 
-    std::size_t numFiles = 0;
-    while (readdir(cachedir)) {
-        ++numFiles;
-    }
+bool CacheManager::putItem (const Glib::ustring& fname, const std::string& md5, const std::string& suffix, const PackedCache::Writer& writer)
+{
+    return !md5.empty () && packedItems.put (getItemKey (fname, md5, suffix), writer);
+}
 
-    closedir(cachedir);
-    if (numFiles > 2) {
-        numFiles -= 2; // because . and .. are counted
-    }
+bool CacheManager::getItem (const Glib::ustring& fname, const std::string& md5, const std::string& suffix, const PackedCache::Reader& reader) const
+{
+    return !md5.empty () && packedItems.get (getItemKey (fname, md5, suffix), reader);
+}
 
-    if (numFiles <= options.maxCacheEntries) {
-        return;
+void CacheManager::removeItem (const Glib::ustring& fname, const std::string& md5, const std::string& suffix)
+{
+    if (!md5.empty ()) {
+        packedItems.remove (getItemKey (fname, md5, suffix));
     }
+}
 
-    using FNameMTime = std::pair<Glib::ustring, Glib::TimeVal>;
-
-    std::vector<FNameMTime> files;
-    files.reserve(numFiles);
-
-    constexpr std::size_t md5_size = 32;
-    // get filenames and timestamps
-    try {
-        const auto dir = Gio::File::create_for_path(Glib::build_filename(baseDir, "data"));
-        const auto enumerator = dir->enumerate_children("standard::name,time::modified");
+void CacheManager::applyCacheSizeLimitation () const
+{
+    // Every entry has a thumbnail image, the packed cache indexes them in write order
+    const std::size_t numEntries = packedItems.count (".rtti");
 
-        while (const auto file = enumerator->next_file()) {
-            const auto name = file->get_name();
-            if (name.size() >= md5_size + 5) {
-                files.emplace_back(name, file->modification_time());
-            }
-        }
+    if (numEntries <= options.maxCacheEntries) {
+        return;
+    }
 
-    } catch (Glib::Exception&) {}
+    const std::vector<std::string> keys = packedItems.getKeys (".rtti");
 
-    if (files.size() <= options.maxCacheEntries) {
-        // limit not reached
+    if (keys.size () <= options.maxCacheEntries) {
         return;
     }
 
-    const std::size_t toDelete = files.size() - options.maxCacheEntries + options.maxCacheEntries * 5 / 100; // reserve 5% free cache space
+    const std::size_t toDelete = std::min (keys.size (), keys.size () - options.maxCacheEntries + options.maxCacheEntries * 5 / 100); // reserve 5% free cache space
+
+    constexpr std::size_t md5_size = 32;
+    constexpr std::size_t suffix_size = 5; // ".rtti"
+
+    for (std::size_t i = 0; i < toDelete; ++i) {
+        const auto& key = keys[i];
 
-    std::nth_element(
-        files.begin(),
-        files.begin() + toDelete,
-        files.end(),
-        [](const FNameMTime& lhs, const FNameMTime& rhs) -> bool
-        {
-            return lhs.second < rhs.second;
+        if (key.size () < md5_size + suffix_size + 2) {
+            continue;
         }
-    );
 
-    for (std::vector<FNameMTime>::const_iterator entry = files.begin(), end = files.begin() + toDelete; entry != end; ++entry) {
-        const auto& name = entry->first;
-        const auto name_size = name.size() - md5_size;
-        const auto fname = name.substr(0, name_size - 5);
-        const auto md5 = name.substr(name_size - 4, md5_size);
+        const auto name_size = key.size () - suffix_size;
+        const auto fname = key.substr (0, name_size - md5_size - 1);
+        const auto md5 = key.substr (name_size - md5_size, md5_size);
 
-        deleteFiles(fname, md5, true, false);
+        deleteFiles (fname, md5, true, false);
     }
 }
-
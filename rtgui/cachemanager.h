@@ -23,6 +23,7 @@
 
 #include <glibmm/ustring.h>
 
+#include "packedcache.h"
 #include "threadutils.h"
 
 #include "../rtengine/noncopyable.h"
@@ -37,6 +38,9 @@ private:
     Entries openEntries;
     Glib::ustring    baseDir;
     mutable MyMutex  mutex;
+    mutable PackedCache packedItems; // thumbnail images and embedded profiles
+
+    std::string getItemKey (const Glib::ustring& fname, const std::string& md5, const std::string& suffix) const;
 
     void deleteDir   (const Glib::ustring& dirName) const;
     void deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile) const;
@@ -59,12 +63,24 @@ public:
     void clearImages () const;
     void clearProfiles () const;
     void clearFromCache (const Glib::ustring& fname, bool purge) const;
+    // Identity of a file in the cache, a hash of its first and last blocks, its size and modification time.
+    // It does not depend on the file name, so cache entries survive renaming and moving the file.
     static std::string getMD5 (const Glib::ustring& fname);
+    // The identity of a file which changed must be computed again
+    static void forgetFile (const Glib::ustring& fname);
+    // Files in a folder which is not browsed any more may change unnoticed, their size and modification time
+    // are checked on next use
+    static void leaveDirectory (const Glib::ustring& dirName);
 
     Glib::ustring    getCacheFileName (const Glib::ustring& subDir,
                                        const Glib::ustring& fname,
                                        const Glib::ustring& fext,
                                        const Glib::ustring& md5) const;
+
+    // The thumbnail images (".rtti") and embedded profiles (".icc") of the entries are kept in a packed cache
+    bool putItem (const Glib::ustring& fname, const std::string& md5, const std::string& suffix, const PackedCache::Writer& writer);
+    bool getItem (const Glib::ustring& fname, const std::string& md5, const std::string& suffix, const PackedCache::Reader& reader) const;
+    void removeItem (const Glib::ustring& fname, const std::string& md5, const std::string& suffix);
 };
 
 #define cacheMgr CacheManager::getInstance()
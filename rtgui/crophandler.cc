@@ -31,6 +31,32 @@
 
 using namespace rtengine;
 
+namespace
+{
+
+// Wraps the pixels in a pixbuf without copying them, the pixbuf frees them
+Glib::RefPtr<Gdk::Pixbuf> takePixels(std::vector<unsigned char>& pixels, int width, int height)
+{
+    auto* const data = new std::vector<unsigned char>(std::move(pixels));
+    pixels.clear();
+
+    return Gdk::Pixbuf::create_from_data(
+        data->data(),
+        Gdk::COLORSPACE_RGB,
+        false,
+        8,
+        width,
+        height,
+        3 * width,
+        [data](const guint8*)
+        {
+            delete data;
+        }
+    );
+}
+
+}
+
 CropHandler::CropHandler() :
     cropParams(new procparams::CropParams),
     colorParams(new procparams::ColorManagementParams),
@@ -327,7 +353,10 @@ void CropHandler::setDetailedCrop(
         cropimgtrue.clear();
     }
 
-    if (ax == cropX && ay == cropY && aw == cropW && ah == cropH && askip == (zoom >= 1000 ? 1 : zoom / 10)) {
+    // a coarse crop has twice the skip of the window, it is shown until the refined one arrives
+    const int windowSkip = zoom >= 1000 ? 1 : zoom / 10;
+
+    if (ax == cropX && ay == cropY && aw == cropW && ah == cropH && (askip == windowSkip || askip == 2 * windowSkip)) {
         cropimg_width = im->getWidth ();
         cropimg_height = im->getHeight ();
         const std::size_t cropimg_size = 3 * cropimg_width * cropimg_height;
@@ -358,11 +387,14 @@ void CropHandler::setDetailedCrop(
                         }
 
                         if (!cropimg.empty()) {
-                            if (cix == cropX && ciy == cropY && ciw == cropW && cih == cropH && cis == (zoom >= 1000 ? 1 : zoom / 10)) {
+                            const int windowSkip = zoom >= 1000 ? 1 : zoom / 10;
+
+                            if (cix == cropX && ciy == cropY && ciw == cropW && cih == cropH && (cis == windowSkip || cis == 2 * windowSkip)) {
                                 // calculate final image size
                                 float czoom = zoom >= 1000 ?
                                     zoom / 1000.f :
                                     float((zoom/10) * 10) / float(zoom);
+                                czoom *= cis / windowSkip;
                                 int imw = cropimg_width * czoom;
                                 int imh = cropimg_height * czoom;
 
@@ -374,15 +406,21 @@ void CropHandler::setDetailedCrop(
                                     imh = wh;
                                 }
 
-                                Glib::RefPtr<Gdk::Pixbuf> tmpPixbuf = Gdk::Pixbuf::create_from_data (cropimg.data(), Gdk::COLORSPACE_RGB, false, 8, cropimg_width, cropimg_height, 3 * cropimg_width);
-                                cropPixbuf = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8, imw, imh);
-                                tmpPixbuf->scale (cropPixbuf, 0, 0, imw, imh, 0, 0, czoom, czoom, Gdk::INTERP_TILES);
-                                tmpPixbuf.clear ();
-
-                                Glib::RefPtr<Gdk::Pixbuf> tmpPixbuftrue = Gdk::Pixbuf::create_from_data (cropimgtrue.data(), Gdk::COLORSPACE_RGB, false, 8, cropimg_width, cropimg_height, 3 * cropimg_width);
-                                cropPixbuftrue = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8, imw, imh);
-                                tmpPixbuftrue->scale (cropPixbuftrue, 0, 0, imw, imh, 0, 0, czoom, czoom, Gdk::INTERP_TILES);
-                                tmpPixbuftrue.clear ();
+                                if (imw == cropimg_width && imh == cropimg_height) {
+                                    // nothing to scale, the pixbufs take over the received images
+                                    cropPixbuf = takePixels(cropimg, cropimg_width, cropimg_height);
+                                    cropPixbuftrue = takePixels(cropimgtrue, cropimg_width, cropimg_height);
+                                } else {
+                                    Glib::RefPtr<Gdk::Pixbuf> tmpPixbuf = Gdk::Pixbuf::create_from_data (cropimg.data(), Gdk::COLORSPACE_RGB, false, 8, cropimg_width, cropimg_height, 3 * cropimg_width);
+                                    cropPixbuf = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8, imw, imh);
+                                    tmpPixbuf->scale (cropPixbuf, 0, 0, imw, imh, 0, 0, czoom, czoom, Gdk::INTERP_TILES);
+                                    tmpPixbuf.clear ();
+
+                                    Glib::RefPtr<Gdk::Pixbuf> tmpPixbuftrue = Gdk::Pixbuf::create_from_data (cropimgtrue.data(), Gdk::COLORSPACE_RGB, false, 8, cropimg_width, cropimg_height, 3 * cropimg_width);
+                                    cropPixbuftrue = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8, imw, imh);
+                                    tmpPixbuftrue->scale (cropPixbuftrue, 0, 0, imw, imh, 0, 0, czoom, czoom, Gdk::INTERP_TILES);
+                                    tmpPixbuftrue.clear ();
+                                }
                             }
 
                             cropimg.clear();
@@ -555,6 +555,11 @@ void FileCatalog::closeDir ()
     // terminate thumbnail updater
     thumbImageUpdater->removeAllJobs ();
 
+    // files of the folder may change unnoticed from now on
+    if (!selectedDirectory.empty ()) {
+        CacheManager::leaveDirectory (selectedDirectory);
+    }
+
     // remove entries
     selectedDirectory = "";
     fileBrowser->close ();
@@ -1750,6 +1755,8 @@ void FileCatalog::on_dir_changed (const Glib::RefPtr<Gio::File>& file, const Gli
 
     if (options.has_retained_extention(file->get_parse_name())
             && (event_type == Gio::FILE_MONITOR_EVENT_CREATED || event_type == Gio::FILE_MONITOR_EVENT_DELETED || event_type == Gio::FILE_MONITOR_EVENT_CHANGED)) {
+        CacheManager::forgetFile (file->get_parse_name ());
+
         if (!internal) {
             GThreadLock lock;
             reparseDirectory ();
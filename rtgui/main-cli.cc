@@ -26,14 +26,27 @@
 #include "config.h"
 #include <gtkmm.h>
 #include <giomm.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <tiffio.h>
 #include <cstring>
 #include <cstdlib>
 #include <locale.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "../rtengine/cJSON.h"
 #include "../rtengine/procparams.h"
+#include "../rtengine/imagewriter.h"
+#include "../rtengine/memoryaccounting.h"
 #include "../rtengine/profilestore.h"
 #include "../rtengine/rtengine.h"
+#include "../rtengine/tracer.h"
 #include "options.h"
 #include "soundman.h"
 #include "rtimage.h"
@@ -42,6 +55,7 @@
 #include "pathutils.h"
 
 #ifndef WIN32
+#include <unistd.h>
 #include <glibmm/fileutils.h>
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -49,6 +63,7 @@
 #else
 #include <windows.h>
 #include <shlobj.h>
+#include <io.h>
 #include <glibmm/thread.h>
 #include "conio.h"
 #endif
@@ -87,6 +102,7 @@ Glib::ustring fname_to_utf8 (const char* fname)
 }
 
 bool fast_export = false;
+Glib::ustring traceFile;
 
 }
 
@@ -215,12 +231,34 @@ int main (int argc, char **argv)
     // printing RT's version in all case, particularly useful for the 'verbose' mode, but also for the batch processing
     std::cout << "RawTherapee, version " << RTVERSION << ", command line." << std::endl;
 
+    traceFile = options.traceFile;
+
+    if (!traceFile.empty()) {
+        rtengine::Tracer::getInstance().setEnabled (true);
+    }
+
+    rtengine::MemoryAccounting::setEnabled (options.memoryAccounting);
+
     if (argc > 1) {
         ret = processLineParams (argc, argv);
     } else {
         std::cout << "Terminating without anything to do." << std::endl;
     }
 
+    if (!traceFile.empty() && rtengine::Tracer::getInstance().isEnabled()) {
+        rtengine::Tracer::getInstance().printSummary (std::cout);
+
+        if (!rtengine::Tracer::getInstance().writeChromeTrace (traceFile)) {
+            std::cerr << "Error: the trace file " << traceFile << " could not be written." << std::endl;
+        }
+    }
+
+    if (rtengine::MemoryAccounting::isEnabled()) {
+        rtengine::MemoryAccounting::getInstance().printSummary (std::cout);
+    }
+
+    rtengine::cleanup();
+
     return ret;
 }
 
@@ -236,6 +274,643 @@ void deleteProcParams (std::vector<rtengine::procparams::PartialProfile*> &ppara
 }
 
 
+namespace
+{
+
+// Settings shared by all the files of a command line batch, read-only once the arguments are parsed
+struct BatchSettings {
+    Glib::ustring outputPath;
+    bool outputDirectory;
+    bool leaveUntouched;
+    bool overwriteFiles;
+    bool sideProcParams;
+    bool copyParamsFile;
+    bool skipIfNoSidecar;
+    bool useDefault;
+    unsigned int sideCarFilePos;
+    int compression;
+    int subsampling;
+    int bits;
+    bool isFloat;
+    bool streamed;
+    std::string outputType;
+    const rtengine::procparams::PartialProfile* rawParams;
+    const rtengine::procparams::PartialProfile* imgParams;
+    const std::vector<rtengine::procparams::PartialProfile*>* processingParams;
+};
+
+// ProfileStore lazily parses the profiles and the dynamic rules, so the workers have to take turns
+std::mutex dynamicProfileMutex;
+// Serializes the per-file log dumps of the parallel workers
+std::mutex consoleMutex;
+
+Glib::ustring getOutputFile (const Glib::ustring& inputFile, const BatchSettings& s)
+{
+    if ( s.outputPath.empty() ) {
+        Glib::ustring str = inputFile;
+        Glib::ustring::size_type ext = str.find_last_of ('.');
+        return str.substr (0, ext) + "." + s.outputType;
+    } else if ( s.outputDirectory ) {
+        Glib::ustring str = Glib::path_get_basename ( inputFile );
+        Glib::ustring::size_type ext = str.find_last_of ('.');
+        return Glib::build_filename (s.outputPath, str.substr (0, ext) + "." + s.outputType);
+    } else if (s.leaveUntouched) {
+        return s.outputPath;
+    } else {
+        Glib::ustring str = s.outputPath;
+        Glib::ustring::size_type ext = str.find_last_of ('.');
+        return str.substr (0, ext) + "." + s.outputType;
+    }
+}
+
+/* Converts a single file, writing the messages to out and err. The result is handed over to writer,
+ * which increments writeErrors if the output file can't be written.
+ * Returns false if an error occurred, true if the file has been processed or skipped */
+bool processFile (const Glib::ustring& inputFile, const BatchSettings& s, rtengine::ImageWriter& writer, std::atomic<unsigned>& writeErrors, std::ostream& out, std::ostream& err)
+{
+    // Has to be reinstanciated at each profile to have a ProcParams object with default values
+    rtengine::procparams::ProcParams currentParams;
+
+    out << "Output is " << s.bits << "-bit " << (s.isFloat ? "floating-point" : "integer") << "." << std::endl;
+    out << "Processing: " << inputFile << std::endl;
+
+    rtengine::InitialImage* ii = nullptr;
+    rtengine::ProcessingJob* job = nullptr;
+    int errorCode;
+    bool isRaw = false;
+
+    const Glib::ustring outputFile = getOutputFile (inputFile, s);
+
+    if ( inputFile == outputFile) {
+        err << "Cannot overwrite: " << inputFile << std::endl;
+        return true;
+    }
+
+    if ( !s.overwriteFiles && Glib::file_test ( outputFile, Glib::FILE_TEST_EXISTS ) ) {
+        err << outputFile  << " already exists: use -Y option to overwrite. This image has been skipped." << std::endl;
+        return true;
+    }
+
+    // Load the image
+    isRaw = true;
+    Glib::ustring ext = getExtension (inputFile);
+
+    if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
+        isRaw = false;
+    }
+
+    ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
+
+    if (!ii) {
+        err << "Error loading file: " << inputFile << std::endl;
+        return false;
+    }
+
+    if (s.useDefault) {
+        const bool dynamic = isRaw ? options.defProfRaw == DEFPROFILE_DYNAMIC : options.defProfImg == DEFPROFILE_DYNAMIC;
+
+        if (dynamic) {
+            rtengine::procparams::PartialProfile* dynamicParams;
+            {
+                std::lock_guard<std::mutex> lock (dynamicProfileMutex);
+                dynamicParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+            }
+            out << "  Merging default " << (isRaw ? "raw" : "non-raw") << " processing profile." << std::endl;
+            dynamicParams->applyTo (&currentParams);
+            dynamicParams->deleteInstance();
+            delete dynamicParams;
+        } else if (isRaw) {
+            out << "  Merging default raw processing profile." << std::endl;
+            s.rawParams->applyTo (&currentParams);
+        } else {
+            out << "  Merging default non-raw processing profile." << std::endl;
+            s.imgParams->applyTo (&currentParams);
+        }
+    }
+
+    bool sideCarFound = false;
+    unsigned int i = 0;
+
+    // Iterate the procparams file list in order to build the final ProcParams
+    do {
+        if (s.sideProcParams && i == s.sideCarFilePos) {
+            // using the sidecar file
+            Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
+
+            // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
+            if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || currentParams.load ( sideProcessingParams )) {
+                err << "Warning: sidecar file requested but not found for: " << sideProcessingParams << std::endl;
+            } else {
+                sideCarFound = true;
+                out << "  Merging sidecar procparams." << std::endl;
+            }
+        }
+
+        if ( s.processingParams->size() > i  ) {
+            out << "  Merging procparams #" << i << std::endl;
+            (*s.processingParams)[i]->applyTo (&currentParams);
+        }
+
+        i++;
+    } while (i < s.processingParams->size() + (s.sideProcParams ? 1 : 0));
+
+    if ( s.sideProcParams && !sideCarFound && s.skipIfNoSidecar ) {
+        delete ii;
+        err << "Error: no sidecar procparams found for: " << inputFile << std::endl;
+        return false;
+    }
+
+    job = rtengine::ProcessingJob::create (ii, currentParams, fast_export);
+
+    if ( !job ) {
+        err << "Error creating processing for: " << inputFile << std::endl;
+        ii->decreaseRef();
+        return false;
+    }
+
+    if (s.streamed && s.outputType == "tif") {
+        // The rows are written while being processed, there's no result image to hand over to the writer
+        const int saveError = rtengine::processImageToTIFF (job, errorCode, outputFile, s.bits, s.isFloat, s.compression == 0);
+
+        if (errorCode) {
+            err << "Error processing: " << inputFile << std::endl;
+        } else if (saveError) {
+            err << "Error saving to: " << outputFile << std::endl;
+        } else if ( s.copyParamsFile ) {
+            Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
+            currentParams.save ( outputProcessingParams );
+        }
+
+        ii->decreaseRef();
+
+        return !errorCode && !saveError;
+    }
+
+    // Process image
+    rtengine::IImagefloat* resultImage = rtengine::processImage (job, errorCode, nullptr);
+
+    if ( !resultImage ) {
+        err << "Error processing: " << inputFile << std::endl;
+        rtengine::ProcessingJob::destroy ( job );
+        return false;
+    }
+
+    // The encoding runs on the writer thread, which owns resultImage from now on,
+    // so that the next file can already be loaded and processed meanwhile
+    const bool copyParamsFile = s.copyParamsFile;
+
+    writer.enqueue (
+        resultImage,
+        outputFile,
+        [&s, outputFile] (const rtengine::IImagefloat* img) -> int
+        {
+            if ( s.outputType == "jpg" ) {
+                return img->saveAsJPEG ( outputFile, s.compression, s.subsampling );
+            } else if ( s.outputType == "tif" ) {
+                return img->saveAsTIFF ( outputFile, s.bits, s.isFloat, s.compression == 0  );
+            } else if ( s.outputType == "png" ) {
+                return img->saveAsPNG ( outputFile, s.bits );
+            } else {
+                return img->saveToFile (outputFile);
+            }
+        },
+        [&writeErrors, outputFile, copyParamsFile, currentParams] (int errorCode) mutable
+        {
+            if (errorCode) {
+                writeErrors++;
+                std::lock_guard<std::mutex> lock (consoleMutex);
+                std::cerr << "Error saving to: " << outputFile << std::endl;
+            } else if ( copyParamsFile ) {
+                Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
+                currentParams.save ( outputProcessingParams );
+            }
+        }
+    );
+
+    ii->decreaseRef();
+
+    return true;
+}
+
+/* Converts the input files with up to 'jobs' files in flight. The OpenMP thread budget is split
+ * between the workers, so that one file can be decoded while another one is processed or encoded.
+ * Returns the number of files which failed */
+unsigned processFiles (const std::vector<Glib::ustring>& inputFiles, const BatchSettings& s, unsigned int jobs)
+{
+    std::atomic<unsigned> errors (0);
+
+    if (jobs <= 1 || inputFiles.size() <= 1) {
+        rtengine::ImageWriter writer;
+
+        for (const auto& inputFile : inputFiles) {
+            if (!processFile (inputFile, s, writer, errors, std::cout, std::cerr)) {
+                errors++;
+            }
+        }
+
+        writer.flush();
+        return errors;
+    }
+
+    jobs = static_cast<unsigned int> (std::min<std::size_t> (jobs, inputFiles.size()));
+
+#ifdef _OPENMP
+    const int threadsPerJob = std::max (1, omp_get_max_threads() / static_cast<int> (jobs));
+#endif
+
+    std::atomic<std::size_t> nextFile (0);
+
+    const auto worker =
+        [&]()
+        {
+#ifdef _OPENMP
+            // only affects the OpenMP regions started from this thread
+            omp_set_num_threads (threadsPerJob);
+#endif
+            // one writer per worker, each worker has at most one image in processing and one in encoding
+            rtengine::ImageWriter writer;
+
+            for (std::size_t iFile = nextFile++; iFile < inputFiles.size(); iFile = nextFile++) {
+                std::ostringstream out;
+                std::ostringstream err;
+
+                if (!processFile (inputFiles[iFile], s, writer, errors, out, err)) {
+                    errors++;
+                }
+
+                std::lock_guard<std::mutex> lock (consoleMutex);
+                std::cout << out.str() << std::flush;
+                std::cerr << err.str() << std::flush;
+            }
+
+            writer.flush();
+        };
+
+    std::vector<std::thread> workers;
+    workers.reserve (jobs);
+
+    for (unsigned int i = 0; i < jobs; ++i) {
+        workers.emplace_back (worker);
+    }
+
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    return errors;
+}
+
+double elapsedMs (const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now() - start).count();
+}
+
+/* Runs one job of the server mode. The job is a JSON object whose members override the batch
+ * settings given on the command line, see the usage text. Returns the JSON reply, without the
+ * trailing newline. Sets failed if the job failed and quit if it asks the server to stop */
+std::string serveJob (const std::string& line, const BatchSettings& defaults, rtengine::ImageWriter& writer, bool& failed, bool& quit)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    cJSON* const reply = cJSON_CreateObject();
+    cJSON* const job = cJSON_Parse (line.c_str());
+    std::vector<rtengine::procparams::PartialProfile*> processingParams;
+    std::ostringstream out;
+    std::ostringstream err;
+    const char* status = "error";
+
+    const auto getMember =
+        [job] (const char* name) -> const cJSON*
+        {
+            return cJSON_GetObjectItemCaseSensitive (job, name);
+        };
+
+    do {
+        if (!job || !cJSON_IsObject (job)) {
+            err << "Error: the job is not a JSON object." << std::endl;
+            break;
+        }
+
+        if (getMember ("id")) {
+            cJSON_AddItemToObject (reply, "id", cJSON_Duplicate (getMember ("id"), true));
+        }
+
+        const cJSON* const command = getMember ("command");
+
+        if (cJSON_IsString (command) && !strcmp (command->valuestring, "quit")) {
+            quit = true;
+            status = "ok";
+            break;
+        }
+
+        const cJSON* const input = getMember ("input");
+
+        if (!cJSON_IsString (input) || !*input->valuestring) {
+            err << "Error: the job has no input file." << std::endl;
+            break;
+        }
+
+        const Glib::ustring inputFile (input->valuestring);
+        cJSON_AddStringToObject (reply, "input", inputFile.c_str());
+
+        if (!Glib::file_test (inputFile, Glib::FILE_TEST_IS_REGULAR)) {
+            err << "Error: \"" << inputFile << "\" is not a regular file." << std::endl;
+            break;
+        }
+
+        BatchSettings s = defaults;
+
+        const cJSON* const output = getMember ("output");
+
+        if (cJSON_IsString (output)) {
+            s.outputPath = output->valuestring;
+            s.outputDirectory = Glib::file_test (s.outputPath, Glib::FILE_TEST_IS_DIR);
+            s.leaveUntouched = false;
+        }
+
+        const cJSON* const format = getMember ("format");
+
+        if (cJSON_IsString (format)) {
+            s.outputType = format->valuestring;
+
+            if (s.outputType != "jpg" && s.outputType != "tif" && s.outputType != "png") {
+                err << "Error: the format has to be \"jpg\", \"tif\" or \"png\"." << std::endl;
+                break;
+            }
+
+            s.bits = s.outputType == "tif" ? 16 : 8;
+            s.isFloat = false;
+            s.compression = s.outputType == "jpg" ? 92 : s.outputType == "tif" ? 0 : -1;
+        }
+
+        const cJSON* const quality = getMember ("quality");
+
+        if (cJSON_IsNumber (quality) && s.outputType == "jpg") {
+            if (quality->valueint < 0 || quality->valueint > 100) {
+                err << "Error: the quality has to be in the [0-100] range." << std::endl;
+                break;
+            }
+
+            s.compression = quality->valueint;
+        }
+
+        const cJSON* const subsampling = getMember ("subsampling");
+
+        if (cJSON_IsNumber (subsampling)) {
+            if (subsampling->valueint < 1 || subsampling->valueint > 3) {
+                err << "Error: the subsampling has to be in the [1-3] range." << std::endl;
+                break;
+            }
+
+            s.subsampling = subsampling->valueint;
+        }
+
+        const cJSON* const deflate = getMember ("deflate");
+
+        if (cJSON_IsBool (deflate) && s.outputType == "tif") {
+            s.compression = cJSON_IsTrue (deflate) ? 1 : 0;
+        }
+
+        const cJSON* const bits = getMember ("bits");
+
+        if (cJSON_IsNumber (bits)) {
+            if (bits->valueint != 8 && bits->valueint != 16 && bits->valueint != 32) {
+                err << "Error: the bits have to be 8, 16 or 32." << std::endl;
+                break;
+            }
+
+            s.bits = bits->valueint;
+            s.isFloat = s.bits == 32 || (s.bits == 16 && cJSON_IsTrue (getMember ("float")));
+        }
+
+        const auto setFlag =
+            [&getMember] (const char* name, bool& flag)
+            {
+                const cJSON* const member = getMember (name);
+
+                if (cJSON_IsBool (member)) {
+                    flag = cJSON_IsTrue (member);
+                }
+            };
+
+        setFlag ("default", s.useDefault);
+        setFlag ("overwrite", s.overwriteFiles);
+        setFlag ("copyProfile", s.copyParamsFile);
+        setFlag ("streamed", s.streamed);
+
+        if (s.useDefault && (!s.rawParams || !s.imgParams)) {
+            err << "Error: the default processing profiles could not be loaded." << std::endl;
+            break;
+        }
+
+        const cJSON* const profiles = getMember ("profiles");
+
+        if (cJSON_IsArray (profiles)) {
+            bool loaded = true;
+            const cJSON* profile;
+
+            cJSON_ArrayForEach (profile, profiles) {
+                rtengine::procparams::PartialProfile* const currentParams = new rtengine::procparams::PartialProfile (true);
+                processingParams.push_back (currentParams);
+
+                if (!cJSON_IsString (profile) || currentParams->load (profile->valuestring)) {
+                    err << "Error: \"" << (cJSON_IsString (profile) ? profile->valuestring : "") << "\" not found." << std::endl;
+                    loaded = false;
+                    break;
+                }
+            }
+
+            if (!loaded) {
+                break;
+            }
+
+            s.processingParams = &processingParams;
+            s.sideCarFilePos = processingParams.size();
+        }
+
+        const cJSON* const sidecar = getMember ("sidecar");
+
+        if (cJSON_IsString (sidecar)) {
+            s.sideProcParams = strcmp (sidecar->valuestring, "ignore") != 0;
+            s.skipIfNoSidecar = !strcmp (sidecar->valuestring, "require");
+            s.sideCarFilePos = s.processingParams->size();
+        }
+
+        const Glib::ustring outputFile = getOutputFile (inputFile, s);
+        cJSON_AddStringToObject (reply, "output", outputFile.c_str());
+
+        std::atomic<unsigned> writeErrors (0);
+        const bool processed = processFile (inputFile, s, writer, writeErrors, out, err);
+        const double processTime = elapsedMs (start);
+
+        // the reply is only sent once the file is written
+        writer.flush();
+
+        cJSON* const timings = cJSON_AddObjectToObject (reply, "timings");
+        cJSON_AddNumberToObject (timings, "process", processTime);
+        cJSON_AddNumberToObject (timings, "write", elapsedMs (start) - processTime);
+
+        if (!processed || writeErrors > 0) {
+            if (writeErrors > 0) {
+                err << "Error saving to: " << outputFile << std::endl;
+            }
+        } else {
+            // files skipped because of the output settings are reported with their warnings
+            status = err.str().empty() ? "ok" : "warning";
+        }
+    } while (false);
+
+    deleteProcParams (processingParams);
+
+    failed = !strcmp (status, "error");
+    cJSON_AddStringToObject (reply, "status", status);
+    cJSON_AddStringToObject (reply, "log", out.str().c_str());
+    cJSON_AddStringToObject (reply, "messages", err.str().c_str());
+    cJSON_AddNumberToObject (reply, "total", elapsedMs (start));
+
+    char* const json = cJSON_PrintUnformatted (reply);
+    const std::string result (json);
+
+    cJSON_free (json);
+    cJSON_Delete (reply);
+    cJSON_Delete (job);
+
+    return result;
+}
+
+/* Keeps the engine resident and runs the jobs read as JSON lines, one at a time, from the
+ * standard input or, if socketPath isn't empty, from the clients connecting to that Unix socket.
+ * A reply line is written for each job. Returns the number of jobs which failed */
+unsigned serveJobs (const BatchSettings& defaults, const Glib::ustring& socketPath)
+{
+    rtengine::ImageWriter writer;
+    unsigned errors = 0;
+    bool quit = false;
+
+    const auto serve =
+        [&] (const std::string& line) -> std::string
+        {
+            bool failed;
+            const std::string reply = serveJob (line, defaults, writer, failed, quit);
+
+            if (failed) {
+                errors++;
+            }
+
+            return reply + '\n';
+        };
+
+    if (socketPath.empty()) {
+        // The standard output is reserved to the replies, the messages printed by the engine
+        // while processing go to the standard error
+        std::cout.flush();
+        fflush (stdout);
+        const int replyFd = dup (fileno (stdout));
+        FILE* const replies = replyFd >= 0 ? fdopen (replyFd, "w") : nullptr;
+
+        if (!replies || dup2 (fileno (stderr), fileno (stdout)) < 0) {
+            std::cerr << "Error: could not reserve the standard output to the replies." << std::endl;
+
+            if (replies) {
+                fclose (replies);
+            }
+
+            return 1;
+        }
+
+        const auto reply =
+            [replies] (const std::string& line)
+            {
+                fputs (line.c_str(), replies);
+                fflush (replies);
+            };
+
+        // lets the clients wait for the end of the startup messages
+        reply ("{\"status\":\"ready\"}\n");
+
+        for (std::string line; !quit && std::getline (std::cin, line);) {
+            if (!line.empty()) {
+                const std::string res = serve (line);
+                std::cout.flush();
+                fflush (stdout);
+                reply (res);
+            }
+        }
+
+        std::cout.flush();
+        fflush (stdout);
+        dup2 (fileno (replies), fileno (stdout));
+        fclose (replies);
+
+        return errors;
+    }
+
+#ifdef WIN32
+    std::cerr << "Error: Unix sockets are not supported on this platform, use the standard input." << std::endl;
+    return 1;
+#else
+
+    try {
+        GStatBuf st;
+
+        if (g_lstat (socketPath.c_str(), &st) == 0 && S_ISSOCK (st.st_mode)) {
+            bool alive = true;
+
+            try {
+                Gio::SocketClient::create()->connect (Gio::UnixSocketAddress::create (socketPath))->close();
+            } catch (Glib::Error&) {
+                alive = false;
+            }
+
+            if (alive) {
+                std::cerr << "Error: another server is listening on " << socketPath << std::endl;
+                return 1;
+            }
+
+            // a socket left over by a server which didn't exit cleanly
+            g_unlink (socketPath.c_str());
+        }
+
+        const Glib::RefPtr<Gio::SocketListener> listener = Gio::SocketListener::create();
+        Glib::RefPtr<Gio::SocketAddress> address;
+        listener->add_address (Gio::UnixSocketAddress::create (socketPath), Gio::SOCKET_TYPE_STREAM, Gio::SOCKET_PROTOCOL_DEFAULT, address);
+
+        std::cout << "Listening on " << socketPath << std::endl;
+
+        while (!quit) {
+            const Glib::RefPtr<Gio::SocketConnection> connection = listener->accept();
+
+            try {
+                const Glib::RefPtr<Gio::DataInputStream> input = Gio::DataInputStream::create (connection->get_input_stream());
+                const Glib::RefPtr<Gio::OutputStream> output = connection->get_output_stream();
+
+                for (std::string line; !quit && input->read_line (line);) {
+                    if (!line.empty()) {
+                        gsize written;
+                        output->write_all (serve (line), written);
+                    }
+                }
+            } catch (Glib::Error& e) {
+                // the client went away, wait for the next one
+                std::cerr << "Connection closed: " << e.what() << std::endl;
+            }
+
+            connection->close();
+        }
+
+        listener->close();
+        g_unlink (socketPath.c_str());
+    } catch (Glib::Error& e) {
+        std::cerr << "Error: could not listen on " << socketPath << ": " << e.what() << std::endl;
+        return errors + 1;
+    }
+
+    return errors;
+#endif
+}
+
+}
+
 bool dontLoadCache ( int argc, char **argv )
 {
     for (int iArg = 1; iArg < argc; iArg++) {
@@ -270,7 +945,11 @@ int processLineParams ( int argc, char **argv )
     int subsampling = 3;
     int bits = -1;
     bool isFloat = false;
+    bool streamed = false;
     std::string outputType;
+    unsigned int jobs = 1;
+    bool serverMode = false;
+    Glib::ustring socketPath;
     unsigned errors = 0;
 
     for ( int iArg = 1; iArg < argc; iArg++) {
@@ -395,6 +1074,27 @@ int processLineParams ( int argc, char **argv )
 
                     break;
 
+                case 'J':
+                    if (currParam.length() == 2) {
+                        std::cerr << "Error: the -J switch requires a mandatory value!" << std::endl;
+                        deleteProcParams (processingParams);
+                        return -3;
+                    }
+
+                    {
+                        const int value = atoi (currParam.substr (2).c_str());
+
+                        if (value < 1) {
+                            std::cerr << "Error: the value accompanying the -J switch has to be greater than 0!" << std::endl;
+                            deleteProcParams (processingParams);
+                            return -3;
+                        }
+
+                        jobs = value;
+                    }
+
+                    break;
+
                 case 'b':
                     bits = atoi (currParam.substr (2).c_str());
 
@@ -423,6 +1123,10 @@ int processLineParams ( int argc, char **argv )
                     compression = ((currParam.size() < 3 || currParam.at (2) != 'z') ? 0 : 1);
                     break;
 
+                case 'm':
+                    streamed = true;
+                    break;
+
                 case 'n':
                     outputType = "png";
                     compression = -1;
@@ -432,6 +1136,34 @@ int processLineParams ( int argc, char **argv )
                     fast_export = true;
                     break;
 
+                case 'M':
+                    rtengine::MemoryAccounting::setEnabled (true);
+                    break;
+
+                case 'D':
+                    serverMode = true;
+
+                    // the socket is optional, -D takes the place of -c
+                    if (iArg + 1 < argc && argv[iArg + 1][0] != '-') {
+                        iArg++;
+                        socketPath = Glib::ustring (fname_to_utf8 (argv[iArg]));
+                    }
+
+                    break;
+
+                case 'T':
+                    if (iArg + 1 < argc) {
+                        iArg++;
+                        traceFile = Glib::ustring (fname_to_utf8 (argv[iArg]));
+                        rtengine::Tracer::getInstance().setEnabled (true);
+                    } else {
+                        std::cerr << "Error: filename missing next to the -T switch." << std::endl;
+                        deleteProcParams (processingParams);
+                        return -3;
+                    }
+
+                    break;
+
                 case 'c': // MUST be last option
                     while (iArg + 1 < argc) {
                         iArg++;
@@ -536,9 +1268,10 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "Usage:" << std::endl;
                     std::cout << "  " << Glib::path_get_basename (argv[0]) << " -c <dir>|<files>   Convert files in batch with default parameters." << std::endl;
                     std::cout << "  " << Glib::path_get_basename (argv[0]) << " <other options> -c <dir>|<files>   Convert files in batch with your own settings." << std::endl;
+                    std::cout << "  " << Glib::path_get_basename (argv[0]) << " <other options> -D [<socket>]   Stay resident and convert the files of the jobs received." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Options:" << std::endl;
-                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> | -n -b<8|16> ] [-Y] [-f] -c <input>" << std::endl;
+                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> [-m] | -n -b<8|16> ] [-Y] [-f] [-J<n>] [-T <trace.json>] [-M] -c <input>|-D [<socket>]" << std::endl;
                     std::cout << std::endl;
                     std::cout << "  -c <files>       Specify one or more input files or folders." << std::endl;
                     std::cout << "                   When specifying folders, Rawtherapee will look for image file types which comply" << std::endl;
@@ -576,10 +1309,32 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "                   32  = 32-bit float.   Applies to TIFF." << std::endl;
                     std::cout << "  -t[z]            Specify output to be TIFF." << std::endl;
                     std::cout << "                   Uncompressed by default, or deflate compression with 'z'." << std::endl;
+                    std::cout << "  -m               Low-memory TIFF output: when the enabled tools allow it, the end of the" << std::endl;
+                    std::cout << "                   pipeline runs over horizontal bands written to the file as they are ready." << std::endl;
                     std::cout << "  -n               Specify output to be compressed PNG." << std::endl;
                     std::cout << "                   Compression is hard-coded to PNG_FILTER_PAETH, Z_RLE." << std::endl;
                     std::cout << "  -Y               Overwrite output if present." << std::endl;
                     std::cout << "  -f               Use the custom fast-export processing pipeline." << std::endl;
+                    std::cout << "  -J<n>            Convert up to n files concurrently (default: 1)." << std::endl;
+                    std::cout << "                   The processing threads are shared between the files in flight." << std::endl;
+                    std::cout << "  -T <file>        Trace the processing stages: print a summary of their timings and write" << std::endl;
+                    std::cout << "                   the Chrome trace events (chrome://tracing, Perfetto) to <file>." << std::endl;
+                    std::cout << "  -M               Print the current and peak memory of the image buffers of each processing stage." << std::endl;
+                    std::cout << "  -D [<socket>]    Server mode, replaces -c: keep the engine and its caches loaded and run the jobs" << std::endl;
+                    std::cout << "                   read from the standard input, or from the clients of the Unix socket <socket>," << std::endl;
+                    std::cout << "                   one JSON object per line. A JSON reply line giving the status, the messages" << std::endl;
+                    std::cout << "                   and the timings in milliseconds is written for each job. On the standard output," << std::endl;
+                    std::cout << "                   {\"status\":\"ready\"} is written first. The other options are the defaults of the jobs," << std::endl;
+                    std::cout << "                   whose members override them:" << std::endl;
+                    std::cout << "                     \"input\": \"<file>\"            the file to convert, mandatory" << std::endl;
+                    std::cout << "                     \"output\": \"<file>|<dir>\"     like -o" << std::endl;
+                    std::cout << "                     \"profiles\": [\"<file.pp3>\"]   like -p, replaces the -p options" << std::endl;
+                    std::cout << "                     \"sidecar\": \"ignore|use|require\"   neither -s nor -S, -s or -S" << std::endl;
+                    std::cout << "                     \"default\", \"overwrite\", \"copyProfile\", \"streamed\": true|false   like -d, -Y, -O, -m" << std::endl;
+                    std::cout << "                     \"format\": \"jpg|tif|png\", \"quality\": 0-100, \"subsampling\": 1-3," << std::endl;
+                    std::cout << "                     \"deflate\": true|false, \"bits\": 8|16|32, \"float\": true|false   like -j, -js, -t, -n, -b" << std::endl;
+                    std::cout << "                     \"id\": <any>                   copied to the reply" << std::endl;
+                    std::cout << "                   The job {\"command\": \"quit\"} stops the server." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Your " << pparamsExt << " files can be incomplete, RawTherapee will build the final values as follows:" << std::endl;
                     std::cout << "  1- A new processing profile is created using neutral values," << std::endl;
@@ -642,197 +1397,78 @@ int processLineParams ( int argc, char **argv )
         return 1;
     }
 
-    if ( inputFiles.empty() ) {
+    if ( inputFiles.empty() && !serverMode ) {
         return 2;
     }
 
-    if (useDefault) {
-        rawParams = new rtengine::procparams::PartialProfile (true, true);
-        Glib::ustring profPath = options.findProfilePath (options.defProfRaw);
-
-        if (options.is_defProfRawMissing() || profPath.empty() || (profPath != DEFPROFILE_DYNAMIC && rawParams->load (profPath == DEFPROFILE_INTERNAL ? DEFPROFILE_INTERNAL : Glib::build_filename (profPath, Glib::path_get_basename (options.defProfRaw) + paramFileExtension)))) {
-            std::cerr << "Error: default raw processing profile not found." << std::endl;
-            rawParams->deleteInstance();
-            delete rawParams;
-            deleteProcParams (processingParams);
-            return -3;
-        }
-
-        imgParams = new rtengine::procparams::PartialProfile (true);
-        profPath = options.findProfilePath (options.defProfImg);
-
-        if (options.is_defProfImgMissing() || profPath.empty() || (profPath != DEFPROFILE_DYNAMIC && imgParams->load (profPath == DEFPROFILE_INTERNAL ? DEFPROFILE_INTERNAL : Glib::build_filename (profPath, Glib::path_get_basename (options.defProfImg) + paramFileExtension)))) {
-            std::cerr << "Error: default non-raw processing profile not found." << std::endl;
-            imgParams->deleteInstance();
-            delete imgParams;
-            rawParams->deleteInstance();
-            delete rawParams;
-            deleteProcParams (processingParams);
-            return -3;
-        }
-    }
-
-    for ( size_t iFile = 0; iFile < inputFiles.size(); iFile++) {
-
-        // Has to be reinstanciated at each profile to have a ProcParams object with default values
-        rtengine::procparams::ProcParams currentParams;
-
-        Glib::ustring inputFile = inputFiles[iFile];
-        std::cout << "Output is " << bits << "-bit " << (isFloat ? "floating-point" : "integer") << "." << std::endl;
-        std::cout << "Processing: " << inputFile << std::endl;
-
-        rtengine::InitialImage* ii = nullptr;
-        rtengine::ProcessingJob* job = nullptr;
-        int errorCode;
-        bool isRaw = false;
-
-        Glib::ustring outputFile;
-
-        if ( outputType.empty() ) {
-            outputType = "jpg";
-        }
-
-        if ( outputPath.empty() ) {
-            Glib::ustring s = inputFile;
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = s.substr (0, ext) + "." + outputType;
-        } else if ( outputDirectory ) {
-            Glib::ustring s = Glib::path_get_basename ( inputFile );
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = Glib::build_filename (outputPath, s.substr (0, ext) + "." + outputType);
-        } else {
-            if (leaveUntouched) {
-                outputFile = outputPath;
-            } else {
-                Glib::ustring s = outputPath;
-                Glib::ustring::size_type ext = s.find_last_of ('.');
-                outputFile = s.substr (0, ext) + "." + outputType;
-            }
-        }
-
-        if ( inputFile == outputFile) {
-            std::cerr << "Cannot overwrite: " << inputFile << std::endl;
-            continue;
-        }
-
-        if ( !overwriteFiles && Glib::file_test ( outputFile, Glib::FILE_TEST_EXISTS ) ) {
-            std::cerr << outputFile  << " already exists: use -Y option to overwrite. This image has been skipped." << std::endl;
-            continue;
-        }
-
-        // Load the image
-        isRaw = true;
-        Glib::ustring ext = getExtension (inputFile);
-
-        if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
-            isRaw = false;
-        }
-
-        ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
-
-        if (!ii) {
-            errors++;
-            std::cerr << "Error loading file: " << inputFile << std::endl;
-            continue;
-        }
-
-        if (useDefault) {
-            if (isRaw) {
-                if (options.defProfRaw == DEFPROFILE_DYNAMIC) {
-                    rawParams->deleteInstance();
-                    delete rawParams;
-                    rawParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+    if (useDefault || serverMode) {
+        // Returns nullptr if the profile can't be loaded
+        const auto loadDefaultProfile =
+            [](const Glib::ustring& defProf, bool defProfMissing, bool isRaw) -> rtengine::procparams::PartialProfile*
+            {
+                rtengine::procparams::PartialProfile* const params = new rtengine::procparams::PartialProfile (true, isRaw);
+                const Glib::ustring profPath = options.findProfilePath (defProf);
+
+                if (defProfMissing || profPath.empty() || (profPath != DEFPROFILE_DYNAMIC && params->load (profPath == DEFPROFILE_INTERNAL ? DEFPROFILE_INTERNAL : Glib::build_filename (profPath, Glib::path_get_basename (defProf) + paramFileExtension)))) {
+                    params->deleteInstance();
+                    delete params;
+                    return nullptr;
                 }
 
-                std::cout << "  Merging default raw processing profile." << std::endl;
-                rawParams->applyTo (&currentParams);
-            } else {
-                if (options.defProfImg == DEFPROFILE_DYNAMIC) {
-                    imgParams->deleteInstance();
-                    delete imgParams;
-                    imgParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
-                }
-
-                std::cout << "  Merging default non-raw processing profile." << std::endl;
-                imgParams->applyTo (&currentParams);
-            }
-        }
+                return params;
+            };
 
-        bool sideCarFound = false;
-        unsigned int i = 0;
+        rawParams = loadDefaultProfile (options.defProfRaw, options.is_defProfRawMissing(), true);
+        imgParams = loadDefaultProfile (options.defProfImg, options.is_defProfImgMissing(), false);
 
-        // Iterate the procparams file list in order to build the final ProcParams
-        do {
-            if (sideProcParams && i == sideCarFilePos) {
-                // using the sidecar file
-                Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
+        // In server mode, only the jobs asking for the default profiles fail, see serveJob()
+        if (!serverMode && (!rawParams || !imgParams)) {
+            std::cerr << (rawParams ? "Error: default non-raw processing profile not found." : "Error: default raw processing profile not found.") << std::endl;
 
-                // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
-                if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || currentParams.load ( sideProcessingParams )) {
-                    std::cerr << "Warning: sidecar file requested but not found for: " << sideProcessingParams << std::endl;
-                } else {
-                    sideCarFound = true;
-                    std::cout << "  Merging sidecar procparams." << std::endl;
-                }
+            if (imgParams) {
+                imgParams->deleteInstance();
+                delete imgParams;
             }
 
-            if ( processingParams.size() > i  ) {
-                std::cout << "  Merging procparams #" << i << std::endl;
-                processingParams[i]->applyTo (&currentParams);
+            if (rawParams) {
+                rawParams->deleteInstance();
+                delete rawParams;
             }
 
-            i++;
-        } while (i < processingParams.size() + (sideProcParams ? 1 : 0));
-
-        if ( sideProcParams && !sideCarFound && skipIfNoSidecar ) {
-            delete ii;
-            errors++;
-            std::cerr << "Error: no sidecar procparams found for: " << inputFile << std::endl;
-            continue;
-        }
-
-        job = rtengine::ProcessingJob::create (ii, currentParams, fast_export);
-
-        if ( !job ) {
-            errors++;
-            std::cerr << "Error creating processing for: " << inputFile << std::endl;
-            ii->decreaseRef();
-            continue;
-        }
-
-        // Process image
-        rtengine::IImagefloat* resultImage = rtengine::processImage (job, errorCode, nullptr);
-
-        if ( !resultImage ) {
-            errors++;
-            std::cerr << "Error processing: " << inputFile << std::endl;
-            rtengine::ProcessingJob::destroy ( job );
-            continue;
-        }
-
-        // save image to disk
-        if ( outputType == "jpg" ) {
-            errorCode = resultImage->saveAsJPEG ( outputFile, compression, subsampling );
-        } else if ( outputType == "tif" ) {
-            errorCode = resultImage->saveAsTIFF ( outputFile, bits, isFloat, compression == 0  );
-        } else if ( outputType == "png" ) {
-            errorCode = resultImage->saveAsPNG ( outputFile, bits );
-        } else {
-            errorCode = resultImage->saveToFile (outputFile);
+            deleteProcParams (processingParams);
+            return -3;
         }
+    }
 
-        if (errorCode) {
-            errors++;
-            std::cerr << "Error saving to: " << outputFile << std::endl;
-        } else {
-            if ( copyParamsFile ) {
-                Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
-                currentParams.save ( outputProcessingParams );
-            }
-        }
+    BatchSettings settings;
+    settings.outputPath = outputPath;
+    settings.outputDirectory = outputDirectory;
+    settings.leaveUntouched = leaveUntouched;
+    settings.overwriteFiles = overwriteFiles;
+    settings.sideProcParams = sideProcParams;
+    settings.copyParamsFile = copyParamsFile;
+    settings.skipIfNoSidecar = skipIfNoSidecar;
+    settings.useDefault = useDefault;
+    settings.sideCarFilePos = sideCarFilePos;
+    settings.compression = compression;
+    settings.subsampling = subsampling;
+    settings.bits = bits;
+    settings.isFloat = isFloat;
+    settings.streamed = streamed;
+    settings.outputType = outputType.empty() ? "jpg" : outputType;
+    settings.rawParams = rawParams;
+    settings.imgParams = imgParams;
+    settings.processingParams = &processingParams;
+
+    if (jobs > 1 && !outputPath.empty() && !outputDirectory && !leaveUntouched && inputFiles.size() > 1) {
+        std::cout << "All the files are written to the same output file, -J is ignored." << std::endl;
+        jobs = 1;
+    }
 
-        ii->decreaseRef();
-        delete resultImage;
+    if (serverMode) {
+        errors += serveJobs (settings, socketPath);
+    } else {
+        errors += processFiles (inputFiles, settings, jobs);
     }
 
     if (imgParams) {
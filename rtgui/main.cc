@@ -44,6 +44,8 @@
 #include "extprog.h"
 #include "../rtengine/dynamicprofile.h"
 #include "../rtengine/procparams.h"
+#include "../rtengine/memoryaccounting.h"
+#include "../rtengine/tracer.h"
 
 #ifndef WIN32
 #include <glibmm/fileutils.h>
@@ -225,6 +227,12 @@ bool init_rt()
     extProgStore->init();
     SoundManager::init();
 
+    if (!options.traceFile.empty()) {
+        rtengine::Tracer::getInstance().setEnabled(true);
+    }
+
+    rtengine::MemoryAccounting::setEnabled(options.memoryAccounting);
+
     if (!rtengine::settings->verbose) {
         TIFFSetWarningHandler (nullptr);   // avoid annoying message boxes
     }
@@ -244,6 +252,20 @@ bool init_rt()
 
 void cleanup_rt()
 {
+    if (rtengine::Tracer::getInstance().isEnabled()) {
+        if (!rtengine::Tracer::getInstance().writeChromeTrace(options.traceFile)) {
+            std::cerr << "Could not write the trace file " << options.traceFile << std::endl;
+        }
+
+        if (rtengine::settings->verbose) {
+            rtengine::Tracer::getInstance().printSummary(std::cout);
+        }
+    }
+
+    if (rtengine::MemoryAccounting::isEnabled()) {
+        rtengine::MemoryAccounting::getInstance().printSummary(std::cout);
+    }
+
     rtengine::cleanup();
 }
 
@@ -465,6 +465,12 @@ void Options::setDefaults()
 #else
     clutCacheSize = 1;
 #endif
+    demosaicCacheSize = 0;
+    planePoolSize = 256;
+    stageCacheSize = 256;
+    traceFile = "";
+    memoryAccounting = false;
+    progressivePreviewLatency = 150;
     filledProfile = false;
     maxInspectorBuffers = 2; //  a rather conservative value for low specced systems...
     inspectorDelay = 0;
@@ -1142,6 +1148,30 @@ void Options::readFromFile(Glib::ustring fname)
                     clutCacheSize = keyFile.get_integer("Performance", "ClutCacheSize");
                 }
 
+                if (keyFile.has_key("Performance", "DemosaicCacheSize")) {
+                    demosaicCacheSize = std::max(0, keyFile.get_integer("Performance", "DemosaicCacheSize"));
+                }
+
+                if (keyFile.has_key("Performance", "PlanePoolSize")) {
+                    planePoolSize = std::max(0, keyFile.get_integer("Performance", "PlanePoolSize"));
+                }
+
+                if (keyFile.has_key("Performance", "StageCacheSize")) {
+                    stageCacheSize = std::max(0, keyFile.get_integer("Performance", "StageCacheSize"));
+                }
+
+                if (keyFile.has_key("Performance", "TraceFile")) {
+                    traceFile = keyFile.get_string("Performance", "TraceFile");
+                }
+
+                if (keyFile.has_key("Performance", "MemoryAccounting")) {
+                    memoryAccounting = keyFile.get_boolean("Performance", "MemoryAccounting");
+                }
+
+                if (keyFile.has_key("Performance", "ProgressivePreviewLatency")) {
+                    progressivePreviewLatency = std::max(0, keyFile.get_integer("Performance", "ProgressivePreviewLatency"));
+                }
+
                 if (keyFile.has_key("Performance", "MaxInspectorBuffers")) {
                     maxInspectorBuffers = keyFile.get_integer("Performance", "MaxInspectorBuffers");
                 }
@@ -2170,6 +2200,12 @@ void Options::saveToFile(Glib::ustring fname)
 
         keyFile.set_integer("Performance", "RgbDenoiseThreadLimit", rgbDenoiseThreadLimit);
         keyFile.set_integer("Performance", "ClutCacheSize", clutCacheSize);
+        keyFile.set_integer("Performance", "DemosaicCacheSize", demosaicCacheSize);
+        keyFile.set_integer("Performance", "PlanePoolSize", planePoolSize);
+        keyFile.set_integer("Performance", "StageCacheSize", stageCacheSize);
+        keyFile.set_string("Performance", "TraceFile", traceFile);
+        keyFile.set_boolean("Performance", "MemoryAccounting", memoryAccounting);
+        keyFile.set_integer("Performance", "ProgressivePreviewLatency", progressivePreviewLatency);
         keyFile.set_integer("Performance", "MaxInspectorBuffers", maxInspectorBuffers);
         keyFile.set_integer("Performance", "InspectorDelay", inspectorDelay);
         keyFile.set_integer("Performance", "PreviewDemosaicFromSidecar", prevdemo);
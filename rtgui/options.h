@@ -347,6 +347,12 @@ public:
     int maxInspectorBuffers;   // maximum number of buffers (i.e. images) for the Inspector feature
     int inspectorDelay;
     int clutCacheSize;
+    int demosaicCacheSize;     // size limit of the on-disk demosaic cache in MiB ; 0 = disabled
+    int planePoolSize;         // size limit of the pool of freed image planes kept for reuse in MiB ; 0 = disabled
+    int stageCacheSize;        // size limit of the cached outputs of the editor's L*a*b* stages in MiB ; 0 = disabled
+    Glib::ustring traceFile;   // Chrome trace event file written at exit with the timings of the processing stages ; empty = tracing disabled
+    bool memoryAccounting;     // Account the memory of the image buffers per processing stage and print it at exit
+    int progressivePreviewLatency; // editor updates of the crops slower than this in ms are first shown at half resolution ; 0 = disabled
     bool filledProfile;  // Used as reminder for the ProfilePanel "mode"
     prevdemo_t prevdemo; // Demosaicing method used for the <100% preview
     bool serializeTiffRead;
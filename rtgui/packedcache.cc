@@ -0,0 +1,632 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glibmm/miscutils.h>
+
+#include "packedcache.h"
+
+#include "../rtengine/settings.h"
+
+namespace
+{
+
+constexpr char RECORD_MAGIC[4] = {'R', 'T', 'P', 'C'};
+constexpr std::uint32_t MAX_KEY_LENGTH = 4096;
+constexpr std::uint64_t INCOMPLETE = UINT64_MAX;
+
+// Compacting small shards is not worth it
+constexpr std::uint64_t MIN_DEAD_BYTES_TO_COMPACT = 16 * 1024 * 1024;
+
+enum class RecordType : std::uint32_t {
+    ITEM,
+    TOMBSTONE,
+    ABORTED // not written anymore, read in the shards of older versions
+};
+
+struct RecordHeader {
+    char magic[4];
+    std::uint32_t keyLength;
+    std::uint64_t payloadLength; // INCOMPLETE while the payload is being written
+    std::int64_t time;
+    RecordType type;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(RecordHeader) == 32, "RecordHeader must not be padded");
+
+// Shards may grow beyond 2 GiB, where ftell() and fseek() fail on some platforms
+std::int64_t tell64(FILE* f)
+{
+#ifdef WIN32
+    return _ftelli64(f);
+#else
+    return ftello(f);
+#endif
+}
+
+bool seek64(FILE* f, std::int64_t offset, int whence)
+{
+#ifdef WIN32
+    return _fseeki64(f, offset, whence) == 0;
+#else
+    return fseeko(f, offset, whence) == 0;
+#endif
+}
+
+bool truncate64(FILE* f, std::int64_t length)
+{
+    fflush(f);
+#ifdef WIN32
+    return _chsize_s(_fileno(f), length) == 0;
+#else
+    return ftruncate(fileno(f), length) == 0;
+#endif
+}
+
+bool endsWith(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool copyBytes(FILE* src, FILE* dst, std::uint64_t length)
+{
+    char buffer[65536];
+
+    while (length > 0) {
+        const std::size_t chunk = std::min<std::uint64_t>(length, sizeof(buffer));
+
+        if (fread(buffer, 1, chunk, src) != chunk || fwrite(buffer, 1, chunk, dst) != chunk) {
+            return false;
+        }
+
+        length -= chunk;
+    }
+
+    return true;
+}
+
+}
+
+class PackedCache::Shard final :
+    public rtengine::NonCopyable
+{
+public:
+    explicit Shard(const Glib::ustring& fname) :
+        fname(fname),
+        file(nullptr),
+        opened(false),
+        liveBytes(0),
+        deadBytes(0)
+    {
+    }
+
+    ~Shard()
+    {
+        close();
+    }
+
+    bool put(const std::string& key, const Writer& writer)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (!open()) {
+            return false;
+        }
+
+        Record record;
+
+        if (!append(key, RecordType::ITEM, writer, record)) {
+            return false;
+        }
+
+        release(key);
+        index[key] = record;
+        liveBytes += record.size();
+
+        compactIfNeeded();
+        return true;
+    }
+
+    bool get(const std::string& key, const Reader& reader)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (!open()) {
+            return false;
+        }
+
+        const auto it = index.find(key);
+
+        if (it == index.end() || !seek64(file, it->second.payloadOffset(), SEEK_SET)) {
+            return false;
+        }
+
+        return reader(file, it->second.payloadLength);
+    }
+
+    bool contains(const std::string& key)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        return open() && index.count(key);
+    }
+
+    void remove(const std::string& key)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (!open() || !index.count(key)) {
+            return;
+        }
+
+        Record tombstone;
+
+        if (append(key, RecordType::TOMBSTONE, nullptr, tombstone)) {
+            release(key);
+            deadBytes += tombstone.size();
+            compactIfNeeded();
+        }
+    }
+
+    void collect(const std::string& suffix, std::vector<std::pair<std::int64_t, std::string>>& keys)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (!open()) {
+            return;
+        }
+
+        for (const auto& entry : index) {
+            if (endsWith(entry.first, suffix)) {
+                keys.emplace_back(entry.second.time, entry.first);
+            }
+        }
+    }
+
+    std::size_t count(const std::string& suffix)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (!open()) {
+            return 0;
+        }
+
+        std::size_t res = 0;
+
+        for (const auto& entry : index) {
+            if (endsWith(entry.first, suffix)) {
+                ++res;
+            }
+        }
+
+        return res;
+    }
+
+    // Locks and closes the shard, which stays closed until unlock()
+    void lockClosed()
+    {
+        mutex.lock();
+        close();
+    }
+
+    void unlock()
+    {
+        mutex.unlock();
+    }
+
+    // To be called between lockClosed() and unlock()
+    void removeFile()
+    {
+        g_remove(fname.c_str());
+    }
+
+private:
+    struct Record {
+        std::int64_t offset; // of the header
+        std::uint32_t keyLength;
+        std::uint64_t payloadLength;
+        std::int64_t time;
+
+        std::int64_t payloadOffset() const
+        {
+            return offset + sizeof(RecordHeader) + keyLength;
+        }
+
+        std::uint64_t size() const
+        {
+            return sizeof(RecordHeader) + keyLength + payloadLength;
+        }
+    };
+
+    void close()
+    {
+        if (file) {
+            fclose(file);
+            file = nullptr;
+        }
+
+        opened = false;
+        index.clear();
+        liveBytes = 0;
+        deadBytes = 0;
+    }
+
+    // Opens the shard file and builds the index on first use
+    bool open()
+    {
+        if (opened) {
+            return file;
+        }
+
+        opened = true;
+        file = g_fopen(fname.c_str(), "r+b");
+
+        if (!file) {
+            file = g_fopen(fname.c_str(), "w+b");
+            return file;
+        }
+
+        if (!seek64(file, 0, SEEK_END)) {
+            close();
+            return false;
+        }
+
+        const std::int64_t fileSize = tell64(file);
+        std::int64_t offset = 0;
+        std::string key;
+
+        seek64(file, 0, SEEK_SET);
+
+        while (offset < fileSize) {
+            RecordHeader header;
+
+            if (
+                fread(&header, sizeof(header), 1, file) != 1
+                || memcmp(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC))
+                || header.keyLength == 0
+                || header.keyLength > MAX_KEY_LENGTH
+                || header.type > RecordType::ABORTED
+                || header.payloadLength == INCOMPLETE
+                || offset + sizeof(header) + header.keyLength + header.payloadLength > static_cast<std::uint64_t>(fileSize)
+            ) {
+                break;
+            }
+
+            key.resize(header.keyLength);
+
+            if (fread(&key[0], 1, header.keyLength, file) != header.keyLength) {
+                break;
+            }
+
+            const Record record = {offset, header.keyLength, header.payloadLength, header.time};
+
+            if (header.type == RecordType::ITEM) {
+                release(key);
+                index[key] = record;
+                liveBytes += record.size();
+            } else {
+                if (header.type == RecordType::TOMBSTONE) {
+                    release(key);
+                }
+
+                deadBytes += record.size();
+            }
+
+            offset += record.size();
+
+            if (!seek64(file, offset, SEEK_SET)) {
+                break;
+            }
+        }
+
+        if (offset < fileSize) {
+            // Interrupted write or corruption, keep the records read so far
+            if (rtengine::settings->verbose) {
+                std::cerr << "Repairing the cache file " << fname << " at offset " << offset << std::endl;
+            }
+
+            deadBytes += fileSize - offset;
+            compact();
+        }
+
+        return file;
+    }
+
+    // Marks the record of key, if any, as dead
+    void release(const std::string& key)
+    {
+        const auto it = index.find(key);
+
+        if (it != index.end()) {
+            liveBytes -= it->second.size();
+            deadBytes += it->second.size();
+            index.erase(it);
+        }
+    }
+
+    bool append(const std::string& key, RecordType type, const Writer& writer, Record& record)
+    {
+        if (key.empty() || key.size() > MAX_KEY_LENGTH || !seek64(file, 0, SEEK_END)) {
+            return false;
+        }
+
+        RecordHeader header;
+        memcpy(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+        header.keyLength = key.size();
+        header.payloadLength = INCOMPLETE;
+        header.time = g_get_real_time();
+        header.type = type;
+        header.reserved = 0;
+
+        record.offset = tell64(file);
+        record.keyLength = header.keyLength;
+        record.time = header.time;
+
+        if (record.offset < 0) {
+            return false;
+        }
+
+        bool success =
+            fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(key.data(), 1, key.size(), file) == key.size()
+            && (!writer || writer(file))
+            && fflush(file) == 0;
+
+        if (success) {
+            const std::int64_t end = tell64(file);
+            header.payloadLength = end - record.payloadOffset();
+
+            // Complete the header, until then the record is ignored when the shard is read
+            success =
+                end >= 0
+                && seek64(file, record.offset, SEEK_SET)
+                && fwrite(&header, sizeof(header), 1, file) == 1;
+        }
+
+        success = fflush(file) == 0 && success;
+
+        if (!success) {
+            // An incomplete record would end the scan of the shard, hiding the records appended after it
+            discardFrom(record.offset);
+            return false;
+        }
+
+        record.payloadLength = header.payloadLength;
+
+        return true;
+    }
+
+    // Removes the end of the file from offset on
+    void discardFrom(std::int64_t offset)
+    {
+        // The error indicator of the stream would otherwise fail the next appends as well
+        clearerr(file);
+
+        if (!truncate64(file, offset)) {
+            compact();
+        }
+    }
+
+    void compactIfNeeded()
+    {
+        if (deadBytes > MIN_DEAD_BYTES_TO_COMPACT && deadBytes > liveBytes) {
+            compact();
+        }
+    }
+
+    // Rewrites the live records in a new file, in the order they were written
+    void compact()
+    {
+        const Glib::ustring tmpName = fname + ".tmp";
+        FILE* const tmp = g_fopen(tmpName.c_str(), "w+b");
+
+        if (!tmp) {
+            return;
+        }
+
+        std::vector<std::pair<std::string, Record>> records(index.begin(), index.end());
+        std::sort(
+            records.begin(),
+            records.end(),
+            [](const std::pair<std::string, Record>& lhs, const std::pair<std::string, Record>& rhs) -> bool
+            {
+                return lhs.second.offset < rhs.second.offset;
+            }
+        );
+
+        bool success = true;
+        std::int64_t offset = 0;
+
+        for (auto& entry : records) {
+            Record& record = entry.second;
+
+            if (!seek64(file, record.offset, SEEK_SET) || !copyBytes(file, tmp, record.size())) {
+                success = false;
+                break;
+            }
+
+            record.offset = offset;
+            offset += record.size();
+        }
+
+        success = fclose(tmp) == 0 && success;
+        fclose(file);
+        file = nullptr;
+
+        if (success) {
+            g_remove(fname.c_str()); // g_rename() does not replace files on Windows
+            success = g_rename(tmpName.c_str(), fname.c_str()) == 0;
+        } else {
+            g_remove(tmpName.c_str());
+        }
+
+        file = g_fopen(fname.c_str(), "r+b");
+
+        if (!success || !file) {
+            // The old file could not be replaced, it is read again on next use
+            close();
+            return;
+        }
+
+        index.clear();
+        index.insert(records.begin(), records.end());
+        deadBytes = 0;
+    }
+
+    const Glib::ustring fname;
+    MyMutex mutex;
+    FILE* file;
+    bool opened;
+    std::map<std::string, Record> index;
+    std::uint64_t liveBytes;
+    std::uint64_t deadBytes;
+};
+
+constexpr unsigned int PackedCache::SHARD_COUNT;
+
+PackedCache::PackedCache() = default;
+
+PackedCache::~PackedCache() = default;
+
+void PackedCache::init(const Glib::ustring& dir)
+{
+    this->dir = dir;
+
+    for (unsigned int i = 0; i < SHARD_COUNT; ++i) {
+        shards[i].reset(new Shard(Glib::build_filename(dir, Glib::ustring::compose("shard%1.pack", i))));
+    }
+}
+
+bool PackedCache::put(const std::string& key, const Writer& writer)
+{
+    return getShard(key).put(key, writer);
+}
+
+bool PackedCache::get(const std::string& key, const Reader& reader) const
+{
+    return getShard(key).get(key, reader);
+}
+
+bool PackedCache::contains(const std::string& key) const
+{
+    return getShard(key).contains(key);
+}
+
+void PackedCache::remove(const std::string& key)
+{
+    getShard(key).remove(key);
+}
+
+void PackedCache::rename(const std::string& oldKey, const std::string& newKey)
+{
+    std::vector<char> payload;
+
+    const bool found = get(
+        oldKey,
+        [&payload](FILE* file, std::size_t length) -> bool
+        {
+            payload.resize(length);
+            return fread(payload.data(), 1, length, file) == length;
+        }
+    );
+
+    if (found) {
+        put(
+            newKey,
+            [&payload](FILE* file) -> bool
+            {
+                return fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+            }
+        );
+    }
+
+    remove(oldKey);
+}
+
+std::size_t PackedCache::count(const std::string& suffix) const
+{
+    std::size_t res = 0;
+
+    for (const auto& shard : shards) {
+        res += shard->count(suffix);
+    }
+
+    return res;
+}
+
+std::vector<std::string> PackedCache::getKeys(const std::string& suffix) const
+{
+    std::vector<std::pair<std::int64_t, std::string>> keys;
+
+    for (const auto& shard : shards) {
+        shard->collect(suffix, keys);
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<std::string> res;
+    res.reserve(keys.size());
+
+    for (auto& key : keys) {
+        res.push_back(std::move(key.second));
+    }
+
+    return res;
+}
+
+void PackedCache::clear(const std::function<void ()>& removeFiles)
+{
+    // The shards stay locked until the files are gone, so that no put() creates them again meanwhile
+    for (const auto& shard : shards) {
+        shard->lockClosed();
+    }
+
+    if (removeFiles) {
+        removeFiles();
+    } else {
+        for (const auto& shard : shards) {
+            shard->removeFile();
+        }
+    }
+
+    for (const auto& shard : shards) {
+        shard->unlock();
+    }
+}
+
+PackedCache::Shard& PackedCache::getShard(const std::string& key) const
+{
+    // FNV-1a, stable across runs and platforms unlike std::hash
+    std::uint32_t hash = 2166136261u;
+
+    for (const char c : key) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+
+    return *shards[hash % SHARD_COUNT];
+}
@@ -0,0 +1,89 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glibmm/ustring.h>
+
+#include "threadutils.h"
+
+#include "../rtengine/noncopyable.h"
+
+/**
+ * Store of many small cache files packed in a few shard files.
+ *
+ * Keeping one file per cached item thrashes the file system once the cache holds hundreds of
+ * thousands of items, and so does listing and sorting them to evict the oldest ones. Here the
+ * items are records appended to one of SHARD_COUNT files, chosen by a hash of their key. Each
+ * shard is scanned once when first used to build its index, which maps the keys to the position
+ * of their record. Replacing or removing an item appends a new record (a tombstone for removals)
+ * and leaves a dead record behind, and a shard is compacted when its dead records outweigh the
+ * live ones. As records are appended in write order, the oldest items are the first ones of each
+ * shard, which makes eviction cheap.
+ *
+ * All methods are thread safe, each shard having its own lock.
+ */
+class PackedCache final :
+    public rtengine::NonCopyable
+{
+public:
+    /** Writes the payload at the current position of the file, returns false on failure. */
+    using Writer = std::function<bool (FILE* file)>;
+    /** Reads the payload of the given length at the current position of the file, returns false on failure. */
+    using Reader = std::function<bool (FILE* file, std::size_t length)>;
+
+    static constexpr unsigned int SHARD_COUNT = 16;
+
+    PackedCache();
+    ~PackedCache();
+
+    /** Sets the folder of the shard files, closing the shards of the previous one. */
+    void init(const Glib::ustring& dir);
+
+    bool put(const std::string& key, const Writer& writer);
+    bool get(const std::string& key, const Reader& reader) const;
+    bool contains(const std::string& key) const;
+    void remove(const std::string& key);
+    void rename(const std::string& oldKey, const std::string& newKey);
+
+    /** Number of items whose key ends with suffix. */
+    std::size_t count(const std::string& suffix) const;
+    /** Keys ending with suffix, oldest first across all shards. */
+    std::vector<std::string> getKeys(const std::string& suffix) const;
+
+    /**
+     * Removes all items and deletes the shard files. If set, removeFiles is called to delete them instead,
+     * while all the shards are closed and locked.
+     */
+    void clear(const std::function<void ()>& removeFiles = nullptr);
+
+private:
+    class Shard;
+
+    Shard& getShard(const std::string& key) const;
+
+    Glib::ustring dir;
+    std::array<std::unique_ptr<Shard>, SHARD_COUNT> shards;
+};
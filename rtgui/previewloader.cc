@@ -75,10 +75,12 @@ public:
 
     Impl(): nConcurrentThreads(0)
     {
+        // The jobs mostly wait for the file system when the folder is on a network share,
+        // keep twice as many in flight as there are cores to hide that latency
 #ifdef _OPENMP
-        int threadCount = omp_get_num_procs();
+        int threadCount = 2 * omp_get_num_procs();
 #else
-        int threadCount = 2;
+        int threadCount = 4;
 #endif
 
         threadPool_ = new Glib::ThreadPool(threadCount, 0);
@@ -0,0 +1,744 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * rtbench: reproducible benchmark of the processing stages.
+ *
+ * Synthetic Bayer and X-Trans raw files (uncompressed DNG) are generated in a temporary folder, so
+ * no download is needed and the input is the same on every machine. Each stage is timed by
+ * processing the raw file with a profile enabling only that stage, on top of a baseline profile
+ * using the fastest demosaic method. The results are written as JSON.
+ *
+ * Build with "make rtbench", run "rtbench -h" for the options.
+ */
+
+#ifdef __GNUC__
+#if defined(__FAST_MATH__)
+#error Using the -ffast-math CFLAG is known to lead to problems. Disable it to compile RawTherapee.
+#endif
+#endif
+
+#include "config.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <locale.h>
+#include <giomm.h>
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <tiffio.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "../rtengine/cJSON.h"
+#include "../rtengine/procparams.h"
+#include "../rtengine/rtengine.h"
+#include "options.h"
+#include "version.h"
+
+// stores path to data files
+Glib::ustring argv0;
+Glib::ustring argv1;
+
+namespace
+{
+
+using rtengine::procparams::ProcParams;
+using rtengine::procparams::RAWParams;
+
+enum class Sensor {
+    BAYER,
+    XTRANS
+};
+
+struct Stage {
+    const char* name;
+    bool bayer;
+    bool xtrans;
+    std::function<void (ProcParams&)> setup;
+};
+
+struct Timing {
+    double min;
+    double median;
+};
+
+// Minimal little endian TIFF writer, just enough for an uncompressed single strip DNG
+class DngWriter
+{
+public:
+    enum Type {
+        BYTE = 1,
+        ASCII = 2,
+        SHORT = 3,
+        LONG = 4,
+        RATIONAL = 5,
+        SRATIONAL = 10
+    };
+
+    void addShort (uint16_t tag, const std::vector<uint16_t>& values)
+    {
+        std::vector<uint8_t> data;
+
+        for (auto v : values) {
+            put16 (data, v);
+        }
+
+        add (tag, SHORT, values.size(), data);
+    }
+
+    void addLong (uint16_t tag, uint32_t value)
+    {
+        std::vector<uint8_t> data;
+        put32 (data, value);
+        add (tag, LONG, 1, data);
+    }
+
+    void addBytes (uint16_t tag, const std::vector<uint8_t>& values)
+    {
+        add (tag, BYTE, values.size(), values);
+    }
+
+    void addAscii (uint16_t tag, const std::string& value)
+    {
+        std::vector<uint8_t> data (value.begin(), value.end());
+        data.push_back (0);
+        add (tag, ASCII, data.size(), data);
+    }
+
+    void addRational (uint16_t tag, Type type, const std::vector<double>& values)
+    {
+        std::vector<uint8_t> data;
+
+        for (auto v : values) {
+            put32 (data, static_cast<uint32_t> (static_cast<int32_t> (std::round (v * 10000.0))));
+            put32 (data, 10000);
+        }
+
+        add (tag, type, values.size(), data);
+    }
+
+    bool write (const Glib::ustring& fname, const std::vector<uint16_t>& pixels)
+    {
+        // the strip offset depends on the layout, so it is patched once the layout is known
+        std::sort (entries.begin(), entries.end(), [] (const Entry& a, const Entry& b) {
+            return a.tag < b.tag;
+        });
+
+        const uint32_t ifdSize = 2 + entries.size() * 12 + 4;
+        uint32_t extraOffset = 8 + ifdSize;
+
+        for (const auto& e : entries) {
+            if (e.data.size() > 4) {
+                extraOffset += (e.data.size() + 1) & ~1u;
+            }
+        }
+
+        const uint32_t stripOffset = extraOffset;
+
+        for (auto& e : entries) {
+            if (e.tag == TIFFTAG_STRIPOFFSETS) {
+                e.data.clear();
+                put32 (e.data, stripOffset);
+            }
+        }
+
+        std::vector<uint8_t> out {'I', 'I', 42, 0};
+        put32 (out, 8);
+        put16 (out, entries.size());
+
+        uint32_t dataOffset = 8 + ifdSize;
+        std::vector<uint8_t> extra;
+
+        for (const auto& e : entries) {
+            put16 (out, e.tag);
+            put16 (out, e.type);
+            put32 (out, e.count);
+
+            if (e.data.size() > 4) {
+                put32 (out, dataOffset + extra.size());
+                extra.insert (extra.end(), e.data.begin(), e.data.end());
+
+                if (extra.size() & 1) {
+                    extra.push_back (0);
+                }
+            } else {
+                std::vector<uint8_t> inlined (e.data);
+                inlined.resize (4, 0);
+                out.insert (out.end(), inlined.begin(), inlined.end());
+            }
+        }
+
+        put32 (out, 0);
+        out.insert (out.end(), extra.begin(), extra.end());
+        out.reserve (out.size() + pixels.size() * 2);
+
+        for (auto p : pixels) {
+            put16 (out, p);
+        }
+
+        FILE* const f = g_fopen (fname.c_str(), "wb");
+
+        if (!f) {
+            return false;
+        }
+
+        const bool ok = fwrite (out.data(), 1, out.size(), f) == out.size();
+        return fclose (f) == 0 && ok;
+    }
+
+private:
+    struct Entry {
+        uint16_t tag;
+        uint16_t type;
+        uint32_t count;
+        std::vector<uint8_t> data;
+    };
+
+    static void put16 (std::vector<uint8_t>& data, uint16_t v)
+    {
+        data.push_back (v & 0xff);
+        data.push_back (v >> 8);
+    }
+
+    static void put32 (std::vector<uint8_t>& data, uint32_t v)
+    {
+        put16 (data, v & 0xffff);
+        put16 (data, v >> 16);
+    }
+
+    void add (uint16_t tag, Type type, uint32_t count, const std::vector<uint8_t>& data)
+    {
+        entries.push_back ({tag, static_cast<uint16_t> (type), count, data});
+    }
+
+    std::vector<Entry> entries;
+};
+
+constexpr uint16_t BLACK_LEVEL = 512;
+constexpr uint16_t WHITE_LEVEL = 16383;
+
+/* Writes a synthetic raw file: smooth gradients for the tone and colour stages, a zone plate for
+ * the demosaicers and resamplers, and deterministic noise for the denoisers. */
+bool writeSyntheticRaw (const Glib::ustring& fname, Sensor sensor, int width, int height)
+{
+    static const uint8_t xtrans[36] = {
+        1, 1, 0, 1, 1, 2,
+        1, 1, 2, 1, 1, 0,
+        2, 0, 1, 0, 2, 1,
+        1, 1, 2, 1, 1, 0,
+        1, 1, 0, 1, 1, 2,
+        0, 2, 1, 2, 0, 1
+    };
+    static const uint8_t bayer[4] = {0, 1, 1, 2};
+    const double neutral[3] = {0.5, 1.0, 0.65};
+
+    std::vector<uint16_t> pixels (static_cast<size_t> (width) * height);
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const int c = sensor == Sensor::BAYER ? bayer[(y & 1) * 2 + (x & 1)] : xtrans[(y % 6) * 6 + x % 6];
+            const double fx = static_cast<double> (x) / width;
+            const double fy = static_cast<double> (y) / height;
+            const double dx = fx - 0.5;
+            const double dy = fy - 0.5;
+            const double zone = 0.5 + 0.5 * std::cos (400.0 * (dx * dx + dy * dy));
+            const double scene[3] = {
+                0.6 * fx + 0.2 * zone,
+                0.3 + 0.4 * fy * zone,
+                0.8 * (1.0 - fx) * fy + 0.1 * zone
+            };
+            uint32_t hash = (static_cast<uint32_t> (y) * 73856093u) ^ (static_cast<uint32_t> (x) * 19349663u);
+            hash ^= hash >> 13;
+            hash *= 0x5bd1e995u;
+            hash ^= hash >> 15;
+            const double noise = (static_cast<double> (hash & 0xffff) / 65535.0 - 0.5) * 60.0;
+            const double value = BLACK_LEVEL + (WHITE_LEVEL - BLACK_LEVEL) * scene[c] * neutral[c] + noise;
+            pixels[static_cast<size_t> (y) * width + x] = static_cast<uint16_t> (std::max (0.0, std::min (static_cast<double> (WHITE_LEVEL), value)));
+        }
+    }
+
+    DngWriter dng;
+    dng.addLong (TIFFTAG_SUBFILETYPE, 0);
+    dng.addLong (TIFFTAG_IMAGEWIDTH, width);
+    dng.addLong (TIFFTAG_IMAGELENGTH, height);
+    dng.addShort (TIFFTAG_BITSPERSAMPLE, {16});
+    dng.addShort (TIFFTAG_COMPRESSION, {COMPRESSION_NONE});
+    dng.addShort (TIFFTAG_PHOTOMETRIC, {32803}); // CFA
+    dng.addAscii (TIFFTAG_MAKE, "RawTherapee");
+    dng.addAscii (TIFFTAG_MODEL, sensor == Sensor::BAYER ? "rtbench Bayer" : "rtbench X-Trans");
+    dng.addLong (TIFFTAG_STRIPOFFSETS, 0);
+    dng.addShort (TIFFTAG_ORIENTATION, {ORIENTATION_TOPLEFT});
+    dng.addShort (TIFFTAG_SAMPLESPERPIXEL, {1});
+    dng.addLong (TIFFTAG_ROWSPERSTRIP, height);
+    dng.addLong (TIFFTAG_STRIPBYTECOUNTS, width * height * 2);
+    dng.addShort (TIFFTAG_PLANARCONFIG, {PLANARCONFIG_CONTIG});
+
+    if (sensor == Sensor::BAYER) {
+        dng.addShort (33421, {2, 2}); // CFARepeatPatternDim
+        dng.addBytes (33422, std::vector<uint8_t> (bayer, bayer + 4)); // CFAPattern
+    } else {
+        dng.addShort (33421, {6, 6});
+        dng.addBytes (33422, std::vector<uint8_t> (xtrans, xtrans + 36));
+    }
+
+    dng.addBytes (50706, {1, 4, 0, 0}); // DNGVersion
+    dng.addAscii (50708, sensor == Sensor::BAYER ? "RawTherapee rtbench Bayer" : "RawTherapee rtbench X-Trans"); // UniqueCameraModel
+    dng.addShort (50714, {BLACK_LEVEL}); // BlackLevel
+    dng.addShort (50717, {WHITE_LEVEL}); // WhiteLevel
+    // ColorMatrix1: XYZ to linear sRGB, i.e. the camera has sRGB primaries
+    dng.addRational (50721, DngWriter::SRATIONAL, {3.2406, -1.5372, -0.4986, -0.9689, 1.8758, 0.0415, 0.0557, -0.2040, 1.0570});
+    dng.addRational (50728, DngWriter::RATIONAL, {neutral[0], neutral[1], neutral[2]}); // AsShotNeutral
+    dng.addShort (50778, {21}); // CalibrationIlluminant1 = D65
+
+    return dng.write (fname, pixels);
+}
+
+std::vector<Stage> getStages()
+{
+    using BayerMethod = RAWParams::BayerSensor::Method;
+    using XTransMethod = RAWParams::XTransSensor::Method;
+
+    const auto bayerDemosaic = [] (BayerMethod method) {
+        return [method] (ProcParams & p) {
+            p.raw.bayersensor.method = RAWParams::BayerSensor::getMethodString (method);
+        };
+    };
+    const auto xtransDemosaic = [] (XTransMethod method) {
+        return [method] (ProcParams & p) {
+            p.raw.xtranssensor.method = RAWParams::XTransSensor::getMethodString (method);
+        };
+    };
+
+    return {
+        {"demosaic_amaze", true, false, bayerDemosaic (BayerMethod::AMAZE)},
+        {"demosaic_rcd", true, false, bayerDemosaic (BayerMethod::RCD)},
+        {"demosaic_dcb", true, false, bayerDemosaic (BayerMethod::DCB)},
+        {"demosaic_lmmse", true, false, bayerDemosaic (BayerMethod::LMMSE)},
+        {"demosaic_vng4", true, false, bayerDemosaic (BayerMethod::VNG4)},
+        {"demosaic_amazevng4", true, false, bayerDemosaic (BayerMethod::AMAZEVNG4)},
+        {"demosaic_xtrans_3pass", false, true, xtransDemosaic (XTransMethod::THREE_PASS)},
+        {"demosaic_xtrans_1pass", false, true, xtransDemosaic (XTransMethod::ONE_PASS)},
+        {
+            "RGB_denoise", true, true, [] (ProcParams & p) {
+                p.dirpyrDenoise.enabled = true;
+            }
+        },
+        {
+            "ip_wavelet", true, true, [] (ProcParams & p) {
+                p.wavelet.enabled = true;
+            }
+        },
+        {
+            "Locallab", true, true, [] (ProcParams & p) {
+                rtengine::procparams::LocallabParams::LocallabSpot spot;
+                spot.name = "rtbench";
+                spot.visiexpose = true;
+                spot.expexpose = true;
+                spot.expcomp = 0.5;
+                p.locallab.enabled = true;
+                p.locallab.selspot = 0;
+                p.locallab.spots.push_back (spot);
+            }
+        },
+        {
+            "ToneMapFattal02", true, true, [] (ProcParams & p) {
+                p.fattal.enabled = true;
+            }
+        },
+        {
+            "Lanczos", true, true, [] (ProcParams & p) {
+                p.resize.enabled = true;
+                p.resize.method = "Lanczos";
+                p.resize.appliesTo = "Full image";
+                p.resize.dataspec = 0;
+                p.resize.scale = 0.5;
+            }
+        },
+        {
+            "transformGeneral", true, true, [] (ProcParams & p) {
+                p.rotate.degree = 2.0;
+            }
+        }
+    };
+}
+
+double now()
+{
+    return std::chrono::duration<double> (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Timing getTiming (std::vector<double> seconds)
+{
+    std::sort (seconds.begin(), seconds.end());
+    const size_t n = seconds.size();
+    return {seconds.front(), n % 2 ? seconds[n / 2] : (seconds[n / 2 - 1] + seconds[n / 2]) / 2.0};
+}
+
+void addResult (cJSON* results, Sensor sensor, int width, int height, int threads, const char* stage, const Timing& timing, const Timing* baseline)
+{
+    cJSON* const result = cJSON_CreateObject();
+    cJSON_AddStringToObject (result, "sensor", sensor == Sensor::BAYER ? "bayer" : "xtrans");
+    cJSON_AddNumberToObject (result, "width", width);
+    cJSON_AddNumberToObject (result, "height", height);
+    cJSON_AddNumberToObject (result, "threads", threads);
+    cJSON_AddStringToObject (result, "stage", stage);
+    cJSON_AddNumberToObject (result, "min", timing.min);
+    cJSON_AddNumberToObject (result, "median", timing.median);
+
+    if (baseline) {
+        // time spent in the stage itself, the baseline pipeline being subtracted
+        cJSON_AddNumberToObject (result, "delta", std::max (0.0, timing.min - baseline->min));
+    }
+
+    cJSON_AddItemToArray (results, result);
+}
+
+std::vector<int> parseList (const std::string& s, char separator = ',')
+{
+    std::vector<int> values;
+    size_t start = 0;
+
+    while (start < s.size()) {
+        const size_t end = std::min (s.find (separator, start), s.size());
+        values.push_back (atoi (s.substr (start, end - start).c_str()));
+        start = end + 1;
+    }
+
+    return values;
+}
+
+void printHelp (const char* name)
+{
+    std::cout << "Usage: " << name << " [-s <W>x<H>[,<W>x<H>...]] [-t <n>[,<n>...]] [-r <n>] [-f <stage>[,<stage>...]] [-o <file>] [-l]" << std::endl
+              << "  -s  image sizes (default: 3000x2000,6000x4000)" << std::endl
+              << "  -t  thread counts (default: 1 and the number of cpus)" << std::endl
+              << "  -r  runs per measurement, the minimum and the median are reported (default: 3)" << std::endl
+              << "  -f  only run the given stages (the baseline, decoding and encoding always run)" << std::endl
+              << "  -o  write the JSON results to <file> instead of the standard output" << std::endl
+              << "  -l  list the stages and exit" << std::endl;
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+    setlocale (LC_NUMERIC, "C"); // to set decimal point to "."
+
+    Gio::init ();
+
+#ifdef BUILD_BUNDLE
+    char exname[512] = {0};
+#ifdef WIN32
+    WCHAR exnameU[512] = {0};
+    GetModuleFileNameW (NULL, exnameU, 511);
+    WideCharToMultiByte (CP_UTF8, 0, exnameU, -1, exname, 511, 0, 0 );
+#else
+
+    if (readlink ("/proc/self/exe", exname, 511) < 0) {
+        strncpy (exname, argv[0], 511);
+    }
+
+#endif
+    const Glib::ustring exePath = Glib::path_get_dirname (exname);
+    argv0 = Glib::path_is_absolute (DATA_SEARCH_PATH) ? Glib::ustring (DATA_SEARCH_PATH) : Glib::ustring (Glib::build_filename (exePath, DATA_SEARCH_PATH));
+#else
+    argv0 = DATA_SEARCH_PATH;
+#endif
+    options.rtSettings.lensfunDbDirectory = LENSFUN_DB_PATH;
+
+    std::vector<std::pair<int, int>> sizes {{3000, 2000}, {6000, 4000}};
+#ifdef _OPENMP
+    const int maxThreads = omp_get_max_threads();
+#else
+    const int maxThreads = 1;
+#endif
+    std::vector<int> threadCounts {1};
+    int repeats = 3;
+    std::vector<std::string> filter;
+    Glib::ustring outputFile;
+
+    if (maxThreads > 1) {
+        threadCounts.push_back (maxThreads);
+    }
+
+    const std::vector<Stage> stages = getStages();
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "-s" && hasValue) {
+            sizes.clear();
+
+            for (const auto& size : Glib::Regex::split_simple (",", argv[++i])) {
+                const std::vector<int> wh = parseList (size, 'x');
+
+                if (wh.size() == 2 && wh[0] > 16 && wh[1] > 16) {
+                    sizes.emplace_back (wh[0], wh[1]);
+                }
+            }
+        } else if (arg == "-t" && hasValue) {
+            threadCounts = parseList (argv[++i]);
+            threadCounts.erase (std::remove_if (threadCounts.begin(), threadCounts.end(), [] (int n) {
+                return n < 1;
+            }), threadCounts.end());
+        } else if (arg == "-r" && hasValue) {
+            repeats = std::max (1, atoi (argv[++i]));
+        } else if (arg == "-f" && hasValue) {
+            for (const auto& stage : Glib::Regex::split_simple (",", argv[++i])) {
+                filter.push_back (stage);
+            }
+        } else if (arg == "-o" && hasValue) {
+            outputFile = argv[++i];
+        } else if (arg == "-l") {
+            for (const auto& stage : stages) {
+                std::cout << stage.name << std::endl;
+            }
+
+            return 0;
+        } else {
+            printHelp (argv[0]);
+            return arg == "-h" ? 0 : -1;
+        }
+    }
+
+    if (sizes.empty() || threadCounts.empty()) {
+        printHelp (argv[0]);
+        return -1;
+    }
+
+    try {
+        Options::load (true);
+    } catch (Options::Error &e) {
+        std::cerr << "FATAL ERROR:" << std::endl << e.get_msg() << std::endl;
+        return -2;
+    }
+
+    TIFFSetWarningHandler (nullptr);
+
+    // Caches would turn repeated runs into cache hits
+    options.demosaicCacheSize = 0;
+
+    gchar* const tmpDir = g_dir_make_tmp ("rtbench-XXXXXX", nullptr);
+
+    if (!tmpDir) {
+        std::cerr << "Could not create a temporary folder" << std::endl;
+        return -2;
+    }
+
+    const Glib::ustring workDir = tmpDir;
+    g_free (tmpDir);
+
+    cJSON* const root = cJSON_CreateObject();
+    cJSON_AddStringToObject (root, "version", RTVERSION);
+    cJSON_AddNumberToObject (root, "cpus", maxThreads);
+    cJSON_AddNumberToObject (root, "repeats", repeats);
+    cJSON* const results = cJSON_AddArrayToObject (root, "results");
+    int failures = 0;
+
+    for (const Sensor sensor : {Sensor::BAYER, Sensor::XTRANS}) {
+        for (const auto& size : sizes) {
+            const int width = size.first;
+            const int height = size.second;
+            const Glib::ustring rawFile = Glib::build_filename (workDir, Glib::ustring::compose ("%1_%2x%3.dng", sensor == Sensor::BAYER ? "bayer" : "xtrans", width, height));
+
+            if (!writeSyntheticRaw (rawFile, sensor, width, height)) {
+                std::cerr << "Could not write " << rawFile << std::endl;
+                ++failures;
+                continue;
+            }
+
+            for (const int threads : threadCounts) {
+#ifdef _OPENMP
+                omp_set_num_threads (threads);
+#endif
+                std::cerr << (sensor == Sensor::BAYER ? "bayer " : "xtrans ") << width << "x" << height << ", " << threads << " thread(s)" << std::endl;
+
+                // Decoding
+                rtengine::InitialImage* ii = nullptr;
+                std::vector<double> seconds;
+
+                for (int r = 0; r < repeats; ++r) {
+                    if (ii) {
+                        ii->decreaseRef();
+                    }
+
+                    int errorCode = 0;
+                    const double start = now();
+                    ii = rtengine::InitialImage::load (rawFile, true, &errorCode, nullptr);
+                    seconds.push_back (now() - start);
+
+                    if (!ii) {
+                        break;
+                    }
+                }
+
+                if (!ii) {
+                    std::cerr << "Could not decode " << rawFile << std::endl;
+                    ++failures;
+                    continue;
+                }
+
+                addResult (results, sensor, width, height, threads, "decode", getTiming (seconds), nullptr);
+
+                // Runs the pipeline repeats times, the last result image is returned in result if not null
+                const auto process = [&] (const ProcParams & params, rtengine::IImagefloat** result) -> bool {
+                    seconds.clear();
+
+                    for (int r = 0; r < repeats; ++r) {
+                        int errorCode = 0;
+                        const double start = now();
+                        rtengine::ProcessingJob* const job = rtengine::ProcessingJob::create (ii, params);
+                        rtengine::IImagefloat* const img = rtengine::processImage (job, errorCode, nullptr);
+                        seconds.push_back (now() - start);
+
+                        if (!img) {
+                            return false;
+                        }
+
+                        if (result && r == repeats - 1) {
+                            *result = img;
+                        } else {
+                            delete img;
+                        }
+                    }
+
+                    return true;
+                };
+
+                // The baseline uses the fastest demosaicer, so the demosaic stages measure the cost of their method
+                ProcParams baselineParams;
+                baselineParams.raw.bayersensor.method = RAWParams::BayerSensor::getMethodString (RAWParams::BayerSensor::Method::FAST);
+                baselineParams.raw.xtranssensor.method = RAWParams::XTransSensor::getMethodString (RAWParams::XTransSensor::Method::FAST);
+
+                rtengine::IImagefloat* baselineImage = nullptr;
+
+                if (!process (baselineParams, &baselineImage)) {
+                    std::cerr << "Baseline processing failed" << std::endl;
+                    ++failures;
+                    ii->decreaseRef();
+                    continue;
+                }
+
+                const Timing baseline = getTiming (seconds);
+                addResult (results, sensor, width, height, threads, "baseline", baseline, nullptr);
+
+                for (const auto& stage : stages) {
+                    if (!(sensor == Sensor::BAYER ? stage.bayer : stage.xtrans)) {
+                        continue;
+                    }
+
+                    if (!filter.empty() && std::find (filter.begin(), filter.end(), stage.name) == filter.end()) {
+                        continue;
+                    }
+
+                    ProcParams params = baselineParams;
+                    stage.setup (params);
+
+                    if (process (params, nullptr)) {
+                        addResult (results, sensor, width, height, threads, stage.name, getTiming (seconds), &baseline);
+                    } else {
+                        std::cerr << "Processing failed for stage " << stage.name << std::endl;
+                        ++failures;
+                    }
+                }
+
+                // Encoding of the baseline result
+                const Glib::ustring outputBase = Glib::build_filename (workDir, "output");
+                const std::vector<std::pair<const char*, std::function<int ()>>> encoders {
+                    {"jpeg_encode", [&]() { return baselineImage->saveAsJPEG (outputBase + ".jpg", 92, 3); }},
+                    {"tiff_encode", [&]() { return baselineImage->saveAsTIFF (outputBase + ".tif", 16, false, true); }},
+                    {"tiff_encode_deflate", [&]() { return baselineImage->saveAsTIFF (outputBase + "_z.tif", 16, false, false); }}
+                };
+
+                for (const auto& encoder : encoders) {
+                    seconds.clear();
+                    bool ok = true;
+
+                    for (int r = 0; r < repeats && ok; ++r) {
+                        const double start = now();
+                        ok = !encoder.second();
+                        seconds.push_back (now() - start);
+                    }
+
+                    if (ok) {
+                        addResult (results, sensor, width, height, threads, encoder.first, getTiming (seconds), nullptr);
+                    } else {
+                        std::cerr << "Encoding failed for stage " << encoder.first << std::endl;
+                        ++failures;
+                    }
+                }
+
+                g_remove ((outputBase + ".jpg").c_str());
+                g_remove ((outputBase + ".tif").c_str());
+                g_remove ((outputBase + "_z.tif").c_str());
+                delete baselineImage;
+                ii->decreaseRef();
+            }
+
+            g_remove (rawFile.c_str());
+        }
+    }
+
+    g_rmdir (workDir.c_str());
+
+    char* const json = cJSON_Print (root);
+
+    if (outputFile.empty()) {
+        std::cout << json << std::endl;
+    } else {
+        FILE* const f = g_fopen (outputFile.c_str(), "wb");
+        bool ok = false;
+
+        if (f) {
+            ok = fputs (json, f) >= 0;
+            ok = fclose (f) == 0 && ok;
+        }
+
+        if (!ok) {
+            std::cerr << "Could not write " << outputFile << std::endl;
+            ++failures;
+        }
+    }
+
+    cJSON_free (json);
+    cJSON_Delete (root);
+
+    rtengine::cleanup();
+
+    return failures ? -2 : 0;
+}
@@ -28,6 +28,7 @@
 #include <cstdlib>
 #include "../rtengine/colortemp.h"
 #include "../rtengine/imagedata.h"
+#include "../rtengine/metadataprobe.h"
 #include "../rtengine/procparams.h"
 #include "../rtengine/rtthumbnail.h"
 #include <glib/gstdio.h>
@@ -39,7 +40,6 @@
 #include "guiutils.h"
 #include "batchqueue.h"
 #include "extprog.h"
-#include "md5helper.h"
 #include "pathutils.h"
 #include "paramsedited.h"
 #include "procparamchangers.h"
@@ -258,16 +258,26 @@ rtengine::procparams::ProcParams* Thumbnail::createProcParamsForUpdate(bool retu
 
     if (!run_cpb) {
         if (defProf == DEFPROFILE_DYNAMIC && create && cfs && cfs->exifValid) {
-            rtengine::FramesMetaData* imageMetaData;
-            if (getType() == FT_Raw) {
-                // Should we ask all frame's MetaData ?
-                imageMetaData = rtengine::FramesMetaData::fromFile (fname, std::unique_ptr<rtengine::RawMetaDataLocation>(new rtengine::RawMetaDataLocation(rtengine::Thumbnail::loadMetaDataFromRaw(fname))), true);
-            } else {
-                // Should we ask all frame's MetaData ?
-                imageMetaData = rtengine::FramesMetaData::fromFile (fname, nullptr, true);
+            PartialProfile *pp = nullptr;
+            rtengine::ProbedMetaData probedMetaData;
+
+            // Reading the few tags the rules need is a lot cheaper than the raw identification and the full EXIF parsing
+            if (rtengine::probeMetaData(fname, probedMetaData)) {
+                pp = ProfileStore::getInstance()->loadDynamicProfile(probedMetaData);
+            }
+
+            if (!pp) {
+                rtengine::FramesMetaData* imageMetaData;
+                if (getType() == FT_Raw) {
+                    // Should we ask all frame's MetaData ?
+                    imageMetaData = rtengine::FramesMetaData::fromFile (fname, std::unique_ptr<rtengine::RawMetaDataLocation>(new rtengine::RawMetaDataLocation(rtengine::Thumbnail::loadMetaDataFromRaw(fname))), true);
+                } else {
+                    // Should we ask all frame's MetaData ?
+                    imageMetaData = rtengine::FramesMetaData::fromFile (fname, nullptr, true);
+                }
+                pp = ProfileStore::getInstance()->loadDynamicProfile(imageMetaData);
+                delete imageMetaData;
             }
-            PartialProfile *pp = ProfileStore::getInstance()->loadDynamicProfile(imageMetaData);
-            delete imageMetaData;
             int err = pp->pparams->save(outFName);
             pp->deleteInstance();
             delete pp;
@@ -879,7 +889,15 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
     }
 
     // thumbnail image
-    succ = succ && tpp->readImage (getCacheFileName ("images", ""));
+    succ = succ && cachemgr->getItem (
+        fname,
+        cfs.md5,
+        ".rtti",
+        [this](FILE* f, std::size_t) -> bool
+        {
+            return tpp->readImage (f);
+        }
+    );
 
     if (!succ && firstTrial) {
         _generateThumbnailImage ();
@@ -899,7 +917,15 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
 
     if ( cfs.thumbImgType == CacheImageData::FULL_THUMBNAIL ) {
         // load embedded profile
-        tpp->readEmbProfile (getCacheFileName ("embprofiles", ".icc"));
+        cachemgr->getItem (
+            fname,
+            cfs.md5,
+            ".icc",
+            [this](FILE* f, std::size_t length) -> bool
+            {
+                return tpp->readEmbProfile (f, length);
+            }
+        );
 
         tpp->init ();
     }
@@ -938,13 +964,31 @@ void Thumbnail::_saveThumbnail ()
         return;
     }
 
-    g_remove (getCacheFileName ("images", ".rtti").c_str ());
-
     // save thumbnail image
-    tpp->writeImage (getCacheFileName ("images", ""));
+    cachemgr->putItem (
+        fname,
+        cfs.md5,
+        ".rtti",
+        [this](FILE* f) -> bool
+        {
+            return tpp->writeImage (f);
+        }
+    );
 
     // save embedded profile
-    tpp->writeEmbProfile (getCacheFileName ("embprofiles", ".icc"));
+    if (tpp->hasEmbProfile ()) {
+        cachemgr->putItem (
+            fname,
+            cfs.md5,
+            ".icc",
+            [this](FILE* f) -> bool
+            {
+                return tpp->writeEmbProfile (f);
+            }
+        );
+    } else {
+        cachemgr->removeItem (fname, cfs.md5, ".icc");
+    }
 
     // save supplementary data
     tpp->writeData (getCacheFileName ("data", ".txt"));
@@ -1004,7 +1048,7 @@ void Thumbnail::setFileName (const Glib::ustring &fn)
 {
 
     fname = fn;
-    cfs.md5 = ::getMD5 (fname);
+    cfs.md5 = CacheManager::getMD5 (fname);
 }
 
 int Thumbnail::getRank  () const